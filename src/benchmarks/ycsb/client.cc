@@ -42,7 +42,7 @@ void client::run_build_records(std::uint8_t thread_count) {
 	// Insertions 	- Initialization of the index
 	for(std::uint32_t t = 0; t < thread_count; t++) {
 		threads[t] = std::thread(do_insertions_concurrent, std::ref(hash_index), std::ref(wl), thread_record_count);
-		utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+		utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 	}
 	for(std::uint32_t t = 0; t < thread_count; t++) {
 		threads[t].join();
@@ -57,7 +57,7 @@ std::uint32_t client::run_transactions(std::uint8_t thread_count) {
 	// Transactions - Running the designed workload.
 	for(std::uint32_t t = 0; t < thread_count; t++) {
 		threads[t] = std::thread(do_transactions_concurrent_timed, std::ref(hash_index), std::ref(wl), thread_operation_count, std::ref(timings[t]));
-		utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+		utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 	}
 	for(std::uint32_t t = 0; t < thread_count; t++) {
 		threads[t].join();
@@ -88,7 +88,7 @@ std::uint32_t client::run_workload() {
 	// Insertions 	- Initialization of the index
 	for(std::uint32_t t = 0; t < thread_count; t++) {
 		threads[t] = std::thread(do_insertions_concurrent_timed, std::ref(hash_index), std::ref(wl), thread_record_count, std::ref(timings[t]));
-		utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+		utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 	}
 	for(std::uint32_t t = 0; t < thread_count; t++) {
 		threads[t].join();
@@ -97,7 +97,7 @@ std::uint32_t client::run_workload() {
 	// Transactions - Running the designed workload.
 	for(std::uint32_t t = 0; t < thread_count; t++) {
 		threads[t] = std::thread(do_transactions_concurrent_timed, std::ref(hash_index), std::ref(wl), thread_operation_count, std::ref(timings[t]));
-		utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+		utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 	}
 	for(std::uint32_t t = 0; t < thread_count; t++) {
 		threads[t].join();
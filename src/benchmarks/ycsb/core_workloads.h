@@ -104,17 +104,25 @@ static const workload_properties workload_read = {
     0, 100
 };
 
+static const workload_properties workload_read_uniform = {
+    100000, 100000,
+    1, 0, 0, 0, 0, 
+    distribution_type::UNIFORM, distribution_type::UNUSED, 
+    0, 100
+};
+
 static const workload_properties workload_update = {
     100000, 100000,
     0, 1, 0, 0, 0, 
     distribution_type::ZIPFIAN, distribution_type::UNUSED, 
     0, 100
 };
+// Scan lengths as in workload_e, few enough operations for the full scans of the hash indexes
 static const workload_properties workload_scan = {
-    10000, 100000,
+    10000, 1000,
     0, 0, 1, 0, 0, 
-    distribution_type::ZIPFIAN, distribution_type::UNUSED, 
-    0, 100
+    distribution_type::ZIPFIAN, distribution_type::UNIFORM, 
+    100, 100
 };
 static const workload_properties workload_insert = {
     100000, 100000,
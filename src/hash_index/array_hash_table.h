@@ -1,6 +1,8 @@
 #ifndef array_hash_table_h
 #define array_hash_table_h
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <functional>
 #include <queue>
@@ -11,63 +13,254 @@
 
 #include "../abstract_index.h"
 #include "../push_ops.h"
+#include "../util/epoch_manager.h"
+#include "../util/rw_spinlock.h"
 
 typedef std::uint32_t hash_value_t;
 
 namespace dbindex {
 
-	template<std::uint32_t directory_size>
+	/**
+	 * Hash table with a bucket per slot of its directory, whose size starts
+	 * at initial_capacity and doubles whenever there are more than
+	 * max_load_factor entries per bucket. The buckets are moved to the new
+	 * directory incrementally by the writers, while operations continue.
+	 *
+	 * bucket_lock_type guards the buckets, anything Lockable and
+	 * SharedLockable such as utils::rw_spinlock or boost::shared_mutex.
+	 */
+	template<typename bucket_lock_type = utils::rw_spinlock>
 	class array_hash_table : public abstract_index {
 	private:
 		abstract_hash<hash_value_t>& hash;
 			
 		struct alignas(CACHE_LINE_SIZE) hash_bucket {
 
+			// Hash value of each key, compared before the key itself
+			std::vector<hash_value_t> hash_values;
 			std::vector<std::string> keys;
 			std::vector<std::string> values;
 
-			hash_bucket(const std::string& key, const std::string& value) {
-				keys   = std::vector<std::string>(1, key);
-				values = std::vector<std::string>(1, value);
+			hash_bucket(hash_value_t hash_value, const std::string& key, const std::string& value) {
+				hash_values = std::vector<hash_value_t>(1, hash_value);
+				keys        = std::vector<std::string>(1, key);
+				values      = std::vector<std::string>(1, value);
 			}
 
 			~hash_bucket() {
 			}
 
-			void insert_next(const std::string& new_key, const std::string& new_value) {
+			// Index of key in the bucket, keys.size() if not present
+			std::uint32_t find(hash_value_t hash_value, const std::string& key) const {
+				for (std::uint32_t i = 0; i < keys.size(); i++) {
+					if (hash_values[i] == hash_value && keys[i] == key) {
+						return i;
+					}
+				}
+				return keys.size();
+			}
+
+			void insert_next(hash_value_t new_hash_value, const std::string& new_key, const std::string& new_value) {
+				hash_values.push_back(new_hash_value);
 				keys.push_back(new_key);
 				values.push_back(new_value);
 			}
 
 			void move_last_to(std::uint32_t i) {
+				hash_values[i] = hash_values[hash_values.size()-1];
 				keys  [i] = keys[keys.size()-1];
 				values[i] = values[values.size()-1];
+				hash_values.pop_back();
 				keys.pop_back();
 				values.pop_back();
 			}
 		};
 
-		std::vector<hash_bucket*> directory{directory_size};
-		std::vector<boost::shared_mutex> bucket_mutexes{directory_size};
+		/**
+		 * Fixed size array of buckets. When the table grows, a twice as large
+		 * array replaces it and bucket i of the old array is split into
+		 * buckets i and i+directory_size of the new one, a few at a time by
+		 * the writers. Until bucket i is marked as migrated, it stays the
+		 * home of its keys.
+		 */
+		struct bucket_array {
+			const std::uint32_t directory_size;
+			std::vector<hash_bucket*> directory;
+			std::vector<std::uint8_t> migrated; // Guarded by the bucket lock
+
+			std::atomic<bucket_array*> previous; // Array still being migrated into this one
+			std::atomic<bucket_array*> next{nullptr}; // Array this one is migrated into
+			std::atomic<std::uint64_t> migrate_cursor{0};
+			std::atomic<std::uint32_t> migrated_count{0};
+
+			bucket_array(std::uint32_t _directory_size, bucket_array* _previous) :
+				directory_size(_directory_size), directory(_directory_size, NULL),
+				migrated(_directory_size, 0), previous(_previous) {}
+
+			~bucket_array() {
+				for (std::uint32_t b = 0; b < directory_size; b++) {
+					if (directory[b]) {
+						delete directory[b];
+					}
+				}
+			}
+		};
+
+		// Grow once there are more than max_load_factor entries per bucket
+		static const std::uint32_t max_load_factor = 4;
+		// Buckets migrated by a writer per operation while the table grows
+		static const std::uint32_t migrate_buckets = 16;
 
-	public:
-		array_hash_table(abstract_hash<hash_value_t>& _hash) : hash(_hash) {
-			for (std::uint32_t b = 0; b < directory_size; b++) {
-				directory[b] = NULL;
+		std::atomic<bucket_array*> current;
+		std::atomic<size_t> entry_count{0};
+		boost::mutex grow_mutex;
+
+		// One lock per bucket of the initial directory. Bucket b of any array
+		// is guarded by lock b mod the lock count, so a bucket and the two
+		// buckets it is split into share their lock.
+		std::vector<bucket_lock_type> bucket_mutexes;
+
+		static std::uint32_t round_up_power_of_two(std::uint32_t capacity) {
+			std::uint32_t directory_size = 1;
+			while (directory_size < capacity) {
+				directory_size <<= 1;
 			}
+			return directory_size;
 		}
-		array_hash_table( array_hash_table&& ) = default; // Move constructor
-			
-		~array_hash_table() {
-			for (std::uint32_t b = 0; b < directory_size; b++) {
-				if (directory[b]) {
-					// Deallocate the memory
-					delete directory[b];
-					// void actual pointer
-					directory[b] = NULL;
+
+		bucket_lock_type& bucket_mutex(std::uint32_t bucket_number) {
+			return bucket_mutexes[bucket_number & (bucket_mutexes.size()-1)];
+		}
+
+		/**
+		 * Locks the bucket that holds hash_value and returns its array. The
+		 * bucket of the previous array is the home until it has been
+		 * migrated, after which the bucket of the current array is. Neither
+		 * can change while the lock is held. Requires an epoch guard.
+		 */
+		template<typename lock_type>
+		bucket_array* lock_bucket(hash_value_t hash_value, std::uint32_t& bucket_number, lock_type& lock) {
+			lock = lock_type(bucket_mutex(hash_value));
+			bucket_array* buckets  = current.load();
+			bucket_array* previous = buckets->previous.load();
+			if (previous) {
+				bucket_number = hash_value & (previous->directory_size-1);
+				if (!previous->migrated[bucket_number]) {
+					return previous;
+				}
+			}
+			bucket_number = hash_value & (buckets->directory_size-1);
+			return buckets;
+		}
+
+		// Splits bucket i of previous into buckets i and i+previous->directory_size of buckets
+		void migrate_bucket(bucket_array* buckets, bucket_array* previous, std::uint32_t i) {
+			boost::unique_lock<bucket_lock_type> local_exclusive_lock(bucket_mutex(i));
+
+			hash_bucket* bucket = previous->directory[i];
+			if (bucket) {
+				for (std::uint32_t e = 0; e < bucket->keys.size(); e++) {
+					std::uint32_t b = i | (bucket->hash_values[e] & previous->directory_size);
+					if (buckets->directory[b]) {
+						buckets->directory[b]->insert_next(bucket->hash_values[e], bucket->keys[e], bucket->values[e]);
+					} else {
+						buckets->directory[b] = new hash_bucket(bucket->hash_values[e], bucket->keys[e], bucket->values[e]);
+					}
+				}
+				delete bucket;
+				previous->directory[i] = NULL;
+			}
+			previous->migrated[i] = 1;
+		}
+
+		// Migrates some buckets of the previous array, if any. Requires an epoch guard.
+		void help_migrate() {
+			bucket_array* buckets  = current.load();
+			bucket_array* previous = buckets->previous.load();
+			if (!previous) {
+				return;
+			}
+			for (std::uint32_t m = 0; m < migrate_buckets; m++) {
+				std::uint64_t i = previous->migrate_cursor.fetch_add(1);
+				if (i >= previous->directory_size) {
+					return;
+				}
+				migrate_bucket(buckets, previous, i);
+				if (previous->migrated_count.fetch_add(1) + 1 == previous->directory_size) {
+					// Last bucket, nobody will look up keys in previous anymore
+					buckets->previous.store(nullptr);
+					utils::epoch_manager::instance().retire(previous);
+					return;
+				}
+			}
+		}
+
+		// Installs a twice as large array once the load factor is exceeded
+		// and the previous growth has been completed.
+		void grow_if_needed() {
+			bucket_array* buckets = current.load();
+			if (entry_count.load() <= (size_t)max_load_factor * buckets->directory_size || buckets->previous.load()) {
+				return;
+			}
+			boost::unique_lock<boost::mutex> grow_lock(grow_mutex, boost::try_to_lock);
+			if (!grow_lock.owns_lock() || current.load() != buckets) {
+				return; // Another writer grows the table
+			}
+			bucket_array* new_buckets = new bucket_array(buckets->directory_size*2, buckets);
+			buckets->next.store(new_buckets);
+			current.store(new_buckets);
+		}
+
+		void collect(bucket_array* buckets, std::uint32_t i, const std::string& start_key, const std::string* end_key,
+		             std::vector<hash_entry>& entries) {
+			boost::shared_lock<bucket_lock_type> local_shared_lock(bucket_mutex(i));
+			if (buckets->migrated[i]) {
+				local_shared_lock.unlock();
+				bucket_array* next = buckets->next.load();
+				collect(next, i, start_key, end_key, entries);
+				collect(next, i + buckets->directory_size, start_key, end_key, entries);
+				return;
+			}
+			hash_bucket* bucket = buckets->directory[i];
+			if (bucket) {
+				for (std::uint32_t j = 0; j < bucket->keys.size(); j++) {
+					if (bucket->keys[j] >= start_key && (!end_key || bucket->keys[j] <= *end_key)) {
+						entries.emplace_back(bucket->keys[j], bucket->values[j]);
+					}
+				}
+			}
+		}
+
+		template<typename cmp>
+		void scan_internal(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) {
+			std::vector<hash_entry> run;
+			sorted_run<cmp>(start_key, end_key, run);
+
+			// Apply push op
+			for (const hash_entry& entry : run) {
+				const std::string& key = std::get<0>(entry);
+				if (!apo.invoke(key.c_str(), key.size(), std::get<1>(entry))) {
+					return;
 				}
 			}
 		}
+
+	public:
+		array_hash_table(abstract_hash<hash_value_t>& _hash, std::uint32_t initial_capacity = 1024) : hash(_hash),
+			current(new bucket_array(round_up_power_of_two(initial_capacity), nullptr)),
+			bucket_mutexes(round_up_power_of_two(initial_capacity)) {}
+
+		array_hash_table(array_hash_table&& other) : hash(other.hash), // Move constructor
+			current(other.current.exchange(nullptr)), entry_count(other.entry_count.load()),
+			bucket_mutexes(other.bucket_mutexes.size()) {}
+
+		~array_hash_table() {
+			bucket_array* buckets = current.load();
+			if (buckets) {
+				delete buckets->previous.load();
+				delete buckets;
+			}
+		}
 		std::string align_int_1000(std::uint32_t input) { 
 			return (input < 10 ? "   " : (input < 100 ? "  " : (input < 1000 ? " " : ""))) + std::to_string(input);
 		}
@@ -77,6 +270,9 @@ namespace dbindex {
 		}
 
 		void print_array_hash_table() {
+			bucket_array* buckets = current.load();
+			std::uint32_t directory_size = buckets->directory_size;
+			std::vector<hash_bucket*>& directory = buckets->directory;
 			std::string text;
 			std::cout << std::string(7*(directory_size+1), '_') << std::endl; // Print first horizontal line
 			bool keep_printing = true;
@@ -84,7 +280,7 @@ namespace dbindex {
 			while (keep_printing) { // As long as at least one bucket has more to print.
 				keep_printing = false; // Assume everyone is done.
 				text = " " + align_int_1000(c) + " | ";
-				for (std::uint8_t i = 0; i < directory_size; i++) {
+				for (std::uint32_t i = 0; i < directory_size; i++) {
 					if (directory[i] && directory[i]->keys.size() > c) { // Print if there is more in the current bucket
 						text += align_str_1000(directory[i]->keys[c]) + " | ";
 						if (directory[i]->keys.size() > c+1) // Check if the bucket is done
@@ -100,17 +296,26 @@ namespace dbindex {
 		}
 
 		bool get(const std::string& key, std::string& value) override {
-			hash_value_t hash_value = hash.get_hash(key);
-			std::uint32_t bucket_number = hash_value & (directory_size-1);
-
-			boost::shared_lock<boost::shared_mutex> local_shared_lock(bucket_mutexes[bucket_number]);
-			if (directory[bucket_number]) {
-				for (uint32_t i = 0; i < directory[bucket_number]->keys.size(); i++) {
-					if (directory[bucket_number]->keys[i] == key) {
-						value = directory[bucket_number]->values[i];
-						local_shared_lock.unlock();
-						return true;
-					}
+			return get(key, hash.get_hash(key), value);
+		}
+
+		/*
+		 * The operations with the hash of key already computed by the caller,
+		 * e.g. a partitioned index that routed the key on it.
+		 */
+		bool get(const std::string& key, hash_value_t hash_value, std::string& value) {
+			std::uint32_t bucket_number;
+
+			utils::epoch_manager::guard epoch_guard;
+			boost::shared_lock<bucket_lock_type> local_shared_lock;
+			bucket_array* buckets = lock_bucket(hash_value, bucket_number, local_shared_lock);
+			hash_bucket* bucket = buckets->directory[bucket_number];
+			if (bucket) {
+				std::uint32_t i = bucket->find(hash_value, key);
+				if (i < bucket->keys.size()) {
+					value = bucket->values[i];
+					local_shared_lock.unlock();
+					return true;
 				}
 			}
 			local_shared_lock.unlock();
@@ -118,47 +323,65 @@ namespace dbindex {
 		}
 
 		void insert(const std::string& key, const std::string& new_value) override {
-			hash_value_t hash_value = hash.get_hash(key);
-			std::uint32_t bucket_number = hash_value & (directory_size-1);
+			insert(key, hash.get_hash(key), new_value);
+		}
+
+		void insert(const std::string& key, hash_value_t hash_value, const std::string& new_value) {
+			std::uint32_t bucket_number;
 
-			boost::unique_lock<boost::shared_mutex> local_exclusive_lock(bucket_mutexes[bucket_number]);
-			if (directory[bucket_number]) {
-				directory[bucket_number]->insert_next(key, new_value);
+			utils::epoch_manager::guard epoch_guard;
+			help_migrate();
+			boost::unique_lock<bucket_lock_type> local_exclusive_lock;
+			bucket_array* buckets = lock_bucket(hash_value, bucket_number, local_exclusive_lock);
+			if (buckets->directory[bucket_number]) {
+				buckets->directory[bucket_number]->insert_next(hash_value, key, new_value);
 			} else {
-				hash_bucket* bucket = new hash_bucket(key, new_value);
-				directory[bucket_number] = bucket;
+				hash_bucket* bucket = new hash_bucket(hash_value, key, new_value);
+				buckets->directory[bucket_number] = bucket;
 			}
 			local_exclusive_lock.unlock();
-
+			entry_count++;
+			grow_if_needed();
 		}
 
 		void update(const std::string& key, const std::string& new_value) override {
-			hash_value_t hash_value = hash.get_hash(key);
-			std::uint32_t bucket_number = hash_value & (directory_size-1);
-			
-			boost::unique_lock<boost::shared_mutex> local_exclusive_lock(bucket_mutexes[bucket_number]);
-			if (directory[bucket_number]) {
-				for (uint32_t i = 0; i < directory[bucket_number]->keys.size(); i++) {
-					if (directory[bucket_number]->keys[i] == key) {
-						directory[bucket_number]->values[i] = new_value;
-						break;
-					}
+			update(key, hash.get_hash(key), new_value);
+		}
+
+		void update(const std::string& key, hash_value_t hash_value, const std::string& new_value) {
+			std::uint32_t bucket_number;
+
+			utils::epoch_manager::guard epoch_guard;
+			help_migrate();
+			boost::unique_lock<bucket_lock_type> local_exclusive_lock;
+			bucket_array* buckets = lock_bucket(hash_value, bucket_number, local_exclusive_lock);
+			hash_bucket* bucket = buckets->directory[bucket_number];
+			if (bucket) {
+				std::uint32_t i = bucket->find(hash_value, key);
+				if (i < bucket->keys.size()) {
+					bucket->values[i] = new_value;
 				}
 			}
 			local_exclusive_lock.unlock();
 		}
 
-		// Returns deleted value, if found, -1 otherwise
 		void remove(const std::string& key) override {
-			hash_value_t hash_value = hash.get_hash(key);
-			std::uint32_t bucket_number = hash_value & (directory_size-1);
-			boost::unique_lock<boost::shared_mutex> local_exclusive_lock(bucket_mutexes[bucket_number]);
-			if (directory[bucket_number]) {
-				for (uint32_t i = 0; i < directory[bucket_number]->keys.size(); i++) {
-					if (directory[bucket_number]->keys[i] == key) { // Entry to be removed found
-						directory[bucket_number]->move_last_to(i);
-						break;
-					}
+			remove(key, hash.get_hash(key));
+		}
+
+		void remove(const std::string& key, hash_value_t hash_value) {
+			std::uint32_t bucket_number;
+
+			utils::epoch_manager::guard epoch_guard;
+			help_migrate();
+			boost::unique_lock<bucket_lock_type> local_exclusive_lock;
+			bucket_array* buckets = lock_bucket(hash_value, bucket_number, local_exclusive_lock);
+			hash_bucket* bucket = buckets->directory[bucket_number];
+			if (bucket) {
+				std::uint32_t i = bucket->find(hash_value, key);
+				if (i < bucket->keys.size()) { // Entry to be removed found
+					bucket->move_last_to(i);
+					entry_count--;
 				}
 			}
 			local_exclusive_lock.unlock();
@@ -166,105 +389,48 @@ namespace dbindex {
 
 		void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override{
 			if (end_key) assert(*end_key > start_key);
-			
-			// std::cout << "i1" << std::endl;
-			typedef std::tuple<std::string, std::string> hash_entry;
-
-			// std::cout << "i2" << std::endl;
-			std::priority_queue<hash_entry, std::vector<hash_entry>, less_than_hash_entry> pri_queue;
-
-			// std::cout << "i3" << std::endl;
-			// FULL SCAN
-			for (std::uint32_t i = 0; i < directory_size; i++) {			
-				// std::cout << "i31" << std::endl;
-				boost::shared_lock<boost::shared_mutex> local_shared_lock(bucket_mutexes[i]);
-				// std::cout << "i32" << std::endl;
-				// std::cout << directory.size() << std::endl;
-				// std::cout << i << std::endl;
-				if (directory[i]) {
-					for (std::uint32_t j = 0; j < directory[i]->keys.size(); j++) {
-						// std::cout << "i33" << std::endl;
-						if (directory[i]->keys[j] >= start_key && (!end_key || directory[i]->keys[j] <= *end_key)) {
-							// std::cout << "i34" << std::endl;
-							pri_queue.push(std::make_tuple(directory[i]->keys[j], directory[i]->values[j]));
-							// std::cout << "i35" << std::endl;
-						}
-						// std::cout << "i36" << std::endl;
-					}
-				}
-				local_shared_lock.unlock();
-			}
-			// std::cout << "i4" << std::endl;
-			// Apply push op
-			while(!pri_queue.empty()) {
-				hash_entry current = pri_queue.top();
-				std::string key   = std::get<0>(current);
-				std::string value = std::get<1>(current);
-				const char* keyp = key.c_str();
-				if (!apo.invoke(keyp, key.size(), value)) {
-					return;
-				}
-				pri_queue.pop();
-			}
-			// std::cout << "i5" << std::endl;
+			scan_internal<less_than_hash_entry>(start_key, end_key, apo);
 		}
 
 		void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override{
 			if (end_key) assert(*end_key > start_key);
-			// std::cout << "i1" << std::endl;
-			typedef std::tuple<std::string, std::string> hash_entry;
-
-			// std::cout << "i2" << std::endl;
-			std::priority_queue<hash_entry, std::vector<hash_entry>, greater_than_hash_entry> pri_queue;
-
-			// std::cout << "i3" << std::endl;
-			// FULL SCAN
-			for (std::uint32_t i = 0; i < directory_size; i++) {			
-				// std::cout << "i31" << std::endl;
-				boost::shared_lock<boost::shared_mutex> local_shared_lock(bucket_mutexes[i]);
-				// std::cout << "i32" << std::endl;
-				// std::cout << directory.size() << std::endl;
-				// std::cout << i << std::endl;
-				if (directory[i]) {
-					for (std::uint32_t j = 0; j < directory[i]->keys.size(); j++) {
-						// std::cout << "i33" << std::endl;
-						if (directory[i]->keys[j] >= start_key && (!end_key || directory[i]->keys[j] <= *end_key)) {
-							// std::cout << "i34" << std::endl;
-							pri_queue.push(std::make_tuple(directory[i]->keys[j], directory[i]->values[j]));
-							// std::cout << "i35" << std::endl;
-						}
-						// std::cout << "i36" << std::endl;
-					}
+			scan_internal<greater_than_hash_entry>(start_key, end_key, apo);
+		}
+
+		/*
+		 * Appends the entries in [start_key, end_key] to run, in the order a
+		 * scan with cmp pushes them: ascending for less_than_hash_entry,
+		 * descending for greater_than_hash_entry. For callers that merge the
+		 * runs of several tables.
+		 */
+		template<typename cmp>
+		void sorted_run(const std::string& start_key, const std::string* end_key, std::vector<hash_entry>& run) {
+			size_t first = run.size();
+			// FULL SCAN, starting from the oldest array that still holds keys
+			{
+				utils::epoch_manager::guard epoch_guard;
+				bucket_array* buckets  = current.load();
+				bucket_array* previous = buckets->previous.load();
+				if (previous) {
+					buckets = previous;
 				}
-				local_shared_lock.unlock();
-			}
-			// std::cout << "i4" << std::endl;
-			// Apply push op
-			while(!pri_queue.empty()) {
-				hash_entry current = pri_queue.top();
-				std::string key   = std::get<0>(current);
-				std::string value = std::get<1>(current);
-				const char* keyp = key.c_str();
-				if (!apo.invoke(keyp, key.size(), value)) {
-					return;
+				for (std::uint32_t i = 0; i < buckets->directory_size; i++) {
+					collect(buckets, i, start_key, end_key, run);
 				}
-				pri_queue.pop();
 			}
-			// std::cout << "i5" << std::endl;
+			// cmp orders a priority queue, whose top is the entry it ranks last
+			std::sort(run.begin() + first, run.end(), [](const hash_entry& lhs, const hash_entry& rhs) {
+				return cmp()(rhs, lhs);
+			});
 		}
 
+		// Number of buckets of the current array, including a growth in progress
 		std::uint32_t get_directory_size() {
-			return directory_size;
+			return current.load()->directory_size;
 		}
 
 		size_t size() {
-			size_t total_entry_count = 0;
-			for (std::uint32_t i = 0; i < directory_size; i++) {
-				if (directory[i]) {
-					total_entry_count += directory[i]->keys.size();
-				}
-			}
-			return total_entry_count;
+			return entry_count.load();
 		}
 
         std::string to_string() override {
@@ -0,0 +1,70 @@
+#ifndef bucket_entry_h
+#define bucket_entry_h
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+typedef std::uint32_t hash_value_t;
+
+namespace dbindex {
+    /**
+     * Key and value of a hash index entry in a single allocation, the key
+     * and value bytes follow the header, so a hit touches one record
+     * instead of three. The hash value of the key is kept so that an index
+     * never rehashes an entry it moves and most mismatching keys are
+     * skipped without a string compare.
+     *
+     * Entries are immutable. An update replaces the entry and retires the
+     * old one, so optimistic readers never see a key or value being
+     * modified.
+     */
+    struct bucket_entry {
+        const hash_value_t hash_value;
+        const std::uint32_t key_length;
+        const std::uint32_t value_length;
+
+        static bucket_entry* create(hash_value_t hash_value, const std::string& key, const std::string& value) {
+            void* memory = ::operator new(sizeof(bucket_entry) + key.size() + value.size());
+            bucket_entry* new_entry = new (memory) bucket_entry(hash_value, key.size(), value.size());
+            std::memcpy(new_entry->data(), key.data(), key.size());
+            std::memcpy(new_entry->data() + key.size(), value.data(), value.size());
+            return new_entry;
+        }
+        static void operator delete(void* p) {
+            ::operator delete(p);
+        }
+
+        bool matches(hash_value_t other_hash_value, const std::string& other_key) const {
+            return hash_value == other_hash_value && key_length == other_key.size() &&
+                   std::memcmp(data(), other_key.data(), key_length) == 0;
+        }
+        const char* key_data() const {
+            return data();
+        }
+        std::string key() const {
+            return std::string(data(), key_length);
+        }
+        std::string value() const {
+            return std::string(data() + key_length, value_length);
+        }
+        // Reuses the buffer of out
+        void read_value(std::string& out) const {
+            out.assign(data() + key_length, value_length);
+        }
+
+    private:
+        bucket_entry(hash_value_t _hash_value, std::uint32_t _key_length, std::uint32_t _value_length) :
+            hash_value(_hash_value), key_length(_key_length), value_length(_value_length) {}
+
+        char* data() {
+            return reinterpret_cast<char*>(this + 1);
+        }
+        const char* data() const {
+            return reinterpret_cast<const char*>(this + 1);
+        }
+    };
+}
+
+#endif
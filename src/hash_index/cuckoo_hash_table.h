@@ -0,0 +1,576 @@
+#ifndef cuckoo_hash_table_h
+#define cuckoo_hash_table_h
+
+#include <iostream>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "../macros.h"
+
+#include "../abstract_index.h"
+#include "../push_ops.h"
+#include "../util/cache_aligned.h"
+#include "../util/epoch_manager.h"
+#include "bucket_entry.h"
+
+typedef std::uint32_t hash_value_t;
+
+namespace dbindex {
+    /**
+     * Bucketized cuckoo hash table. Every key has two candidate buckets of
+     * four slots each, so a lookup reads at most two cache lines. Each slot
+     * has an 8 bit tag of the hash value of its key, and only keys whose tag
+     * matches are compared. The second bucket is derived from the first and
+     * the tag, so an entry can be moved to its other bucket without hashing
+     * its key again.
+     *
+     * When both buckets are full, a breadth first search finds the shortest
+     * path of entries that can each move to their other bucket, ending in a
+     * free slot, and the path is carried out backwards, one move at a time.
+     * The table doubles when no path is found, which happens at load factors
+     * above 90%.
+     *
+     * Buckets are guarded by lock_count striped locks, each with a version
+     * that is odd while a writer changes a bucket of the stripe. get never
+     * takes a lock. It reads both buckets and validates them against the
+     * versions of their stripes, retrying if a writer got in between.
+     *
+     * Keys that cannot be placed while the table is less than half full, as
+     * with a hash function that maps many keys to the same value, go to a
+     * stash searched after both buckets.
+     */
+    template<std::uint32_t initial_bucket_count = 1<<14, std::uint32_t lock_count = 1024>
+    class cuckoo_hash_table : public abstract_index {
+    private:
+        abstract_hash<hash_value_t>& hash;
+
+        static const std::uint8_t  slots_per_bucket = 4;
+        static const std::uint8_t  max_path_length = 5;
+        static const std::uint32_t max_search_buckets = 512;
+        static const std::uint32_t max_cuckoo_attempts = 4;
+        static const std::uint32_t min_grow_load_percent = 50;
+        static const std::uint32_t read_retries_before_yield = 64;
+
+        static_assert(initial_bucket_count > 1 && (initial_bucket_count & (initial_bucket_count-1)) == 0,
+                      "bucket count must be a power of two");
+        static_assert(lock_count > 0 && (lock_count & (lock_count-1)) == 0, "lock count must be a power of two");
+
+        // Tags and entry pointers, 36 bytes, fill one cache line, which
+        // the bucket arrays are allocated on. Tag 0 marks a free slot.
+        struct alignas(CACHE_LINE_SIZE) hash_bucket : public utils::cache_aligned {
+            std::atomic<std::uint8_t>  tags[slots_per_bucket];
+            std::atomic<bucket_entry*> entries[slots_per_bucket];
+
+            hash_bucket() {
+                for (std::uint8_t s = 0; s < slots_per_bucket; s++) {
+                    tags[s] = 0;
+                    entries[s] = nullptr;
+                }
+            }
+
+            void set_entry(std::uint8_t s, bucket_entry* new_entry) {
+                tags[s].store(new_entry ? tag(new_entry->hash_value) : 0, std::memory_order_relaxed);
+                entries[s].store(new_entry, std::memory_order_release);
+            }
+
+            // Slot of key, slots_per_bucket if not present
+            std::uint8_t find(hash_value_t hash_value, const std::string& key) const {
+                const std::uint8_t t = tag(hash_value);
+                for (std::uint8_t s = 0; s < slots_per_bucket; s++) {
+                    if (tags[s].load(std::memory_order_relaxed) == t) {
+                        bucket_entry* e = entries[s].load(std::memory_order_acquire);
+                        if (e && e->matches(hash_value, key)) {
+                            return s;
+                        }
+                    }
+                }
+                return slots_per_bucket;
+            }
+
+            std::uint8_t find_free() const {
+                for (std::uint8_t s = 0; s < slots_per_bucket; s++) {
+                    if (!entries[s].load(std::memory_order_relaxed)) {
+                        return s;
+                    }
+                }
+                return slots_per_bucket;
+            }
+        };
+
+        // The buckets are replaced as a whole when the table grows, the old
+        // array is retired through the epoch manager. It does not own the
+        // entries, they are moved to the new array.
+        struct bucket_array {
+            const size_t bucket_count;
+            hash_bucket* const buckets;
+
+            bucket_array(size_t _bucket_count) : bucket_count(_bucket_count), buckets(new hash_bucket[_bucket_count]) {}
+            ~bucket_array() {
+                delete[] buckets;
+            }
+        };
+
+        struct alignas(CACHE_LINE_SIZE) bucket_lock {
+            std::atomic<std::uint64_t> version{0}; // Odd while a writer modifies a bucket of the stripe
+            boost::mutex mutex;
+
+            void begin_write() {
+                version.fetch_add(1, std::memory_order_acq_rel);
+            }
+            void end_write() {
+                version.fetch_add(1, std::memory_order_release);
+            }
+        };
+
+        // Step of a cuckoo path. The entry in slot of the parent bucket can
+        // move to bucket.
+        struct path_node {
+            size_t bucket;
+            std::int32_t parent;
+            std::uint8_t slot;
+            std::uint8_t depth;
+        };
+
+        std::atomic<bucket_array*> current;
+        std::vector<bucket_lock, utils::cache_aligned_allocator<bucket_lock>> locks{lock_count};
+        std::atomic<size_t> entry_count{0};
+
+        std::vector<bucket_entry*> stash;
+        std::atomic<size_t> stash_size{0};
+        boost::mutex stash_mutex;
+
+        static std::uint8_t tag(hash_value_t hash_value) {
+            std::uint8_t t = hash_value >> (8 * sizeof(hash_value_t) - 8);
+            return t ? t : 1;
+        }
+        static size_t first_bucket(const bucket_array* array, hash_value_t hash_value) {
+            return hash_value & (array->bucket_count - 1);
+        }
+        // The other bucket of an entry with tag t in bucket b, an involution
+        static size_t alternate_bucket(const bucket_array* array, size_t b, std::uint8_t t) {
+            return (b ^ ((size_t)t * 0x5bd1e995)) & (array->bucket_count - 1);
+        }
+        static std::uint32_t lock_of(size_t bucket) {
+            return bucket & (lock_count - 1);
+        }
+
+        // Locks the stripes of b1 and b2 in stripe order
+        void lock_pair(size_t b1, size_t b2) {
+            std::uint32_t l1 = lock_of(b1), l2 = lock_of(b2);
+            if (l1 > l2) std::swap(l1, l2);
+            locks[l1].mutex.lock();
+            if (l2 != l1) locks[l2].mutex.lock();
+        }
+        void unlock_pair(size_t b1, size_t b2) {
+            std::uint32_t l1 = lock_of(b1), l2 = lock_of(b2);
+            if (l2 != l1) locks[l2].mutex.unlock();
+            locks[l1].mutex.unlock();
+        }
+        void begin_write_pair(size_t b1, size_t b2) {
+            locks[lock_of(b1)].begin_write();
+            if (lock_of(b2) != lock_of(b1)) locks[lock_of(b2)].begin_write();
+        }
+        void end_write_pair(size_t b1, size_t b2) {
+            if (lock_of(b2) != lock_of(b1)) locks[lock_of(b2)].end_write();
+            locks[lock_of(b1)].end_write();
+        }
+
+        /**
+         * Locks both buckets of hash_value in the current array and returns
+         * it. A resize holds every lock, so the array cannot change while
+         * they are held. Requires an epoch guard.
+         */
+        bucket_array* lock_buckets(hash_value_t hash_value, size_t& b1, size_t& b2) {
+            while (true) {
+                bucket_array* array = current.load();
+                b1 = first_bucket(array, hash_value);
+                b2 = alternate_bucket(array, b1, tag(hash_value));
+                lock_pair(b1, b2);
+                if (current.load() == array) {
+                    return array;
+                }
+                unlock_pair(b1, b2); // Resized while waiting for the locks
+            }
+        }
+
+        // Stash index of key, stash.size() if not present. Requires the stash lock.
+        size_t find_in_stash(hash_value_t hash_value, const std::string& key) {
+            for (size_t i = 0; i < stash.size(); i++) {
+                if (stash[i]->matches(hash_value, key)) {
+                    return i;
+                }
+            }
+            return stash.size();
+        }
+
+        /**
+         * Searches for the shortest path from b1 or b2 to a free slot, without
+         * locks. Returns the index of the last node in path, -1 if there is
+         * none within max_path_length moves.
+         */
+        static std::int32_t search_cuckoo_path(bucket_array* array, size_t b1, size_t b2, std::vector<path_node>& path, std::uint8_t& free_slot) {
+            path.clear();
+            path.push_back(path_node{b1, -1, 0, 0});
+            path.push_back(path_node{b2, -1, 0, 0});
+            for (size_t n = 0; n < path.size(); n++) {
+                hash_bucket& bucket = array->buckets[path[n].bucket];
+                for (std::uint8_t s = 0; s < slots_per_bucket; s++) {
+                    bucket_entry* e = bucket.entries[s].load(std::memory_order_acquire);
+                    if (!e) {
+                        free_slot = s;
+                        return n;
+                    }
+                    if (path[n].depth < max_path_length && path.size() < max_search_buckets) {
+                        size_t alt = alternate_bucket(array, path[n].bucket, tag(e->hash_value));
+                        path.push_back(path_node{alt, (std::int32_t)n, s, (std::uint8_t)(path[n].depth + 1)});
+                    }
+                }
+            }
+            return -1;
+        }
+
+        /**
+         * Carries out a path found by search_cuckoo_path from its free end,
+         * moving one entry at a time under the locks of both its buckets.
+         * Returns false if a concurrent writer changed the path.
+         */
+        bool execute_cuckoo_path(bucket_array* array, std::vector<path_node>& path, std::int32_t n, std::uint8_t free_slot) {
+            while (path[n].parent >= 0) {
+                size_t from = path[path[n].parent].bucket;
+                size_t to   = path[n].bucket;
+                std::uint8_t from_slot = path[n].slot;
+
+                lock_pair(from, to);
+                bool valid = current.load() == array;
+                bucket_entry* e = valid ? array->buckets[from].entries[from_slot].load() : nullptr;
+                valid = e && !array->buckets[to].entries[free_slot].load() &&
+                        alternate_bucket(array, from, tag(e->hash_value)) == to;
+                if (valid) {
+                    begin_write_pair(from, to);
+                    array->buckets[to].set_entry(free_slot, e);
+                    array->buckets[from].set_entry(from_slot, nullptr);
+                    end_write_pair(from, to);
+                }
+                unlock_pair(from, to);
+                if (!valid) {
+                    return false;
+                }
+                free_slot = from_slot;
+                n = path[n].parent;
+            }
+            return true;
+        }
+
+        // Places e in the new array while every lock is held, moving other
+        // entries out of the way if needed, and in the stash if that fails.
+        static void place(bucket_array* array, bucket_entry* e, std::vector<path_node>& path, std::vector<bucket_entry*>& new_stash) {
+            size_t b1 = first_bucket(array, e->hash_value);
+            size_t b2 = alternate_bucket(array, b1, tag(e->hash_value));
+            std::uint8_t free_slot;
+            std::int32_t n = search_cuckoo_path(array, b1, b2, path, free_slot);
+            if (n < 0) {
+                new_stash.push_back(e);
+                return;
+            }
+            for (; path[n].parent >= 0; n = path[n].parent) {
+                hash_bucket& from = array->buckets[path[path[n].parent].bucket];
+                array->buckets[path[n].bucket].set_entry(free_slot, from.entries[path[n].slot].load());
+                free_slot = path[n].slot;
+            }
+            array->buckets[path[n].bucket].set_entry(free_slot, e);
+        }
+
+        // Doubles the table, unless another writer already replaced array
+        void grow(bucket_array* array) {
+            for (bucket_lock& l : locks) {
+                l.mutex.lock();
+            }
+            if (current.load() == array) {
+                for (bucket_lock& l : locks) {
+                    l.begin_write();
+                }
+                boost::lock_guard<boost::mutex> stash_lock(stash_mutex);
+                bucket_array* new_array = new bucket_array(array->bucket_count * 2);
+                std::vector<bucket_entry*> new_stash;
+                std::vector<path_node> path;
+                for (size_t b = 0; b < array->bucket_count; b++) {
+                    for (std::uint8_t s = 0; s < slots_per_bucket; s++) {
+                        bucket_entry* e = array->buckets[b].entries[s].load();
+                        if (e) {
+                            place(new_array, e, path, new_stash);
+                        }
+                    }
+                }
+                for (bucket_entry* e : stash) {
+                    place(new_array, e, path, new_stash);
+                }
+                stash.swap(new_stash);
+                stash_size.store(stash.size());
+                current.store(new_array);
+                for (bucket_lock& l : locks) {
+                    l.end_write();
+                }
+                utils::epoch_manager::instance().retire(array);
+            }
+            for (bucket_lock& l : locks) {
+                l.mutex.unlock();
+            }
+        }
+
+        template<typename cmp>
+        void scan_internal(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) {
+            std::priority_queue<hash_entry, std::vector<hash_entry>, cmp> pri_queue;
+
+            // FULL SCAN, with every writer locked out so that no entry moves
+            {
+                utils::epoch_manager::guard epoch_guard;
+                for (bucket_lock& l : locks) {
+                    l.mutex.lock();
+                }
+                auto visit = [&](bucket_entry* e) {
+                    std::string key = e->key();
+                    if (key >= start_key && (!end_key || key <= *end_key)) {
+                        pri_queue.push(std::make_tuple(key, e->value()));
+                    }
+                };
+                bucket_array* array = current.load();
+                for (size_t b = 0; b < array->bucket_count; b++) {
+                    for (std::uint8_t s = 0; s < slots_per_bucket; s++) {
+                        bucket_entry* e = array->buckets[b].entries[s].load();
+                        if (e) {
+                            visit(e);
+                        }
+                    }
+                }
+                {
+                    boost::lock_guard<boost::mutex> stash_lock(stash_mutex);
+                    for (bucket_entry* e : stash) {
+                        visit(e);
+                    }
+                }
+                for (bucket_lock& l : locks) {
+                    l.mutex.unlock();
+                }
+            }
+
+            // Apply push op
+            while(!pri_queue.empty()) {
+                hash_entry entry = pri_queue.top();
+                std::string key   = std::get<0>(entry);
+                std::string value = std::get<1>(entry);
+                const char* keyp = key.c_str();
+                if (!apo.invoke(keyp, key.size(), value)) {
+                    return;
+                }
+                pri_queue.pop();
+            }
+        }
+
+    public:
+        cuckoo_hash_table(abstract_hash<hash_value_t>& _hash) : hash(_hash), current(new bucket_array(initial_bucket_count)) {}
+
+        ~cuckoo_hash_table() {
+            bucket_array* array = current.load();
+            for (size_t b = 0; b < array->bucket_count; b++) {
+                for (std::uint8_t s = 0; s < slots_per_bucket; s++) {
+                    delete array->buckets[b].entries[s].load();
+                }
+            }
+            for (bucket_entry* e : stash) {
+                delete e;
+            }
+            delete array;
+        }
+
+        bool get(const std::string& key, std::string& value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+
+            utils::epoch_manager::guard epoch_guard;
+            for (std::uint32_t attempt = 1; ; attempt++) {
+                if (attempt % read_retries_before_yield == 0) {
+                    std::this_thread::yield(); // The writer may have been descheduled
+                }
+                bucket_array* array = current.load(std::memory_order_acquire);
+                size_t b1 = first_bucket(array, hash_value);
+                size_t b2 = alternate_bucket(array, b1, tag(hash_value));
+                bucket_lock& l1 = locks[lock_of(b1)];
+                bucket_lock& l2 = locks[lock_of(b2)];
+
+                std::uint64_t v1 = l1.version.load(std::memory_order_acquire);
+                std::uint64_t v2 = l2.version.load(std::memory_order_acquire);
+                if ((v1 & 1) || (v2 & 1)) {
+                    continue; // Writer active
+                }
+
+                bucket_entry* found = nullptr;
+                std::uint8_t s = array->buckets[b1].find(hash_value, key);
+                if (s < slots_per_bucket) {
+                    found = array->buckets[b1].entries[s].load(std::memory_order_acquire);
+                } else if ((s = array->buckets[b2].find(hash_value, key)) < slots_per_bucket) {
+                    found = array->buckets[b2].entries[s].load(std::memory_order_acquire);
+                } else if (stash_size.load(std::memory_order_acquire) > 0) {
+                    boost::lock_guard<boost::mutex> stash_lock(stash_mutex);
+                    size_t i = find_in_stash(hash_value, key);
+                    if (i < stash.size()) {
+                        found = stash[i];
+                    }
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (l1.version.load(std::memory_order_relaxed) == v1 && l2.version.load(std::memory_order_relaxed) == v2 &&
+                    current.load(std::memory_order_relaxed) == array) { // Not resized before the versions were read
+                    if (found) {
+                        found->read_value(value);
+                    }
+                    return found != nullptr;
+                }
+            }
+        }
+
+        // Like the other hash tables, does not check whether the key is present
+        void insert(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            bucket_entry* new_entry = bucket_entry::create(hash_value, key, new_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            std::vector<path_node> path;
+            std::uint32_t attempts = 0;
+            while (true) {
+                size_t b1, b2;
+                bucket_array* array = lock_buckets(hash_value, b1, b2);
+                for (size_t b : {b1, b2}) {
+                    std::uint8_t s = array->buckets[b].find_free();
+                    if (s < slots_per_bucket) {
+                        begin_write_pair(b, b);
+                        array->buckets[b].set_entry(s, new_entry);
+                        end_write_pair(b, b);
+                        unlock_pair(b1, b2);
+                        entry_count++;
+                        return;
+                    }
+                }
+                if (attempts == max_cuckoo_attempts &&
+                    entry_count.load() * 100 < array->bucket_count * slots_per_bucket * min_grow_load_percent) {
+                    // Too few entries to blame the load, the keys collide
+                    boost::lock_guard<boost::mutex> stash_lock(stash_mutex);
+                    stash.push_back(new_entry);
+                    stash_size.store(stash.size());
+                    unlock_pair(b1, b2);
+                    entry_count++;
+                    return;
+                }
+                unlock_pair(b1, b2);
+
+                if (attempts == max_cuckoo_attempts) {
+                    grow(array);
+                    attempts = 0;
+                    continue;
+                }
+                attempts++;
+                std::uint8_t free_slot;
+                std::int32_t n = search_cuckoo_path(array, b1, b2, path, free_slot);
+                if (n < 0) {
+                    attempts = max_cuckoo_attempts; // No path, grow
+                    continue;
+                }
+                execute_cuckoo_path(array, path, n, free_slot);
+            }
+        }
+
+        void update(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+
+            utils::epoch_manager::guard epoch_guard;
+            size_t b1, b2;
+            bucket_array* array = lock_buckets(hash_value, b1, b2);
+            for (size_t b : {b1, b2}) {
+                std::uint8_t s = array->buckets[b].find(hash_value, key);
+                if (s < slots_per_bucket) {
+                    bucket_entry* old_entry = array->buckets[b].entries[s].load();
+                    begin_write_pair(b, b);
+                    array->buckets[b].set_entry(s, bucket_entry::create(hash_value, key, new_value));
+                    end_write_pair(b, b);
+                    unlock_pair(b1, b2);
+                    utils::epoch_manager::instance().retire(old_entry);
+                    return;
+                }
+            }
+            if (stash_size.load() > 0) {
+                boost::lock_guard<boost::mutex> stash_lock(stash_mutex);
+                size_t i = find_in_stash(hash_value, key);
+                if (i < stash.size()) {
+                    utils::epoch_manager::instance().retire(stash[i]);
+                    stash[i] = bucket_entry::create(hash_value, key, new_value);
+                }
+            }
+            unlock_pair(b1, b2);
+        }
+
+        void remove(const std::string& key) override {
+            hash_value_t hash_value = hash.get_hash(key);
+
+            utils::epoch_manager::guard epoch_guard;
+            size_t b1, b2;
+            bucket_array* array = lock_buckets(hash_value, b1, b2);
+            for (size_t b : {b1, b2}) {
+                std::uint8_t s = array->buckets[b].find(hash_value, key);
+                if (s < slots_per_bucket) {
+                    bucket_entry* old_entry = array->buckets[b].entries[s].load();
+                    begin_write_pair(b, b);
+                    array->buckets[b].set_entry(s, nullptr);
+                    end_write_pair(b, b);
+                    unlock_pair(b1, b2);
+                    entry_count--;
+                    utils::epoch_manager::instance().retire(old_entry);
+                    return;
+                }
+            }
+            if (stash_size.load() > 0) {
+                boost::lock_guard<boost::mutex> stash_lock(stash_mutex);
+                size_t i = find_in_stash(hash_value, key);
+                if (i < stash.size()) {
+                    utils::epoch_manager::instance().retire(stash[i]);
+                    stash[i] = stash.back();
+                    stash.pop_back();
+                    stash_size.store(stash.size());
+                    entry_count--;
+                }
+            }
+            unlock_pair(b1, b2);
+        }
+
+        void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<less_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<greater_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        // Number of slots, not counting the stash
+        size_t capacity() {
+            return current.load()->bucket_count * slots_per_bucket;
+        }
+
+        size_t stash_entries() {
+            return stash_size.load();
+        }
+
+        size_t size() {
+            return entry_count.load();
+        }
+
+        std::string to_string() override {
+            return "cuckoo_hash_table";
+        }
+    };
+}
+
+#endif
@@ -3,6 +3,11 @@
 
 #include <iostream>
 #include <strings.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 #include <functional>
 #include <queue>
 #include <vector>
@@ -11,69 +16,231 @@
 #include "../abstract_index.h"
 #include "../macros.h"
 #include "../push_ops.h"
+#include "../util/cache_aligned.h"
+#include "../util/distributed_rw_lock.h"
+#include "../util/epoch_manager.h"
+#include "../util/rw_spinlock.h"
+#include "bucket_entry.h"
 
 typedef std::uint32_t hash_value_t;
 
 namespace dbindex {
-    template<std::uint8_t initial_global_depth>
-    class extendible_hash_table : public abstract_index {
+    /**
+     * Number of entries that, together with the bucket header, fit in
+     * cache_lines cache lines. The header is the version, the two depths and
+     * the original index, 16 bytes, and each entry takes a fingerprint byte
+     * and a pointer.
+     */
+    constexpr std::uint8_t extendible_bucket_entries(std::uint32_t cache_lines) {
+        return (cache_lines * CACHE_LINE_SIZE - 16) / (1 + sizeof(void*));
+    }
+
+    /**
+     * With optimistic_reads, get never takes a lock. It reads the directory
+     * and the bucket without writing shared memory and validates the result
+     * against the version of the bucket, retrying if a writer got in between.
+     * Writers lock the bucket only. Growing the directory builds a new one and
+     * swaps it in, so gets and updates keep running while it happens.
+     *
+     * With migrate_slots set, a doubling does not copy the directory. The new
+     * directory starts empty and falls back to the old one, and every later
+     * insert, update and remove migrates migrate_slots slots of it.
+     *
+     * A remove that leaves a bucket and its buddy, the bucket differing in
+     * the top bit of their local depth, with at most half a bucket of
+     * entries together merges the two, and the directory halves once no
+     * bucket needs its full depth, so memory follows the live data.
+     *
+     * A bucket holds bucket_entries entries inline. Keys that no split can
+     * tell apart, or only one growing the directory by more than
+     * max_split_doublings levels, go to up to overflow_pages overflow pages
+     * of the bucket instead.
+     *
+     * bucket_lock_type guards a bucket and directory_lock_type the
+     * directory, anything Lockable and SharedLockable. The directory lock is
+     * taken shared by every split and exclusively only to replace the
+     * directory, so by default it keeps its readers apart per core, which
+     * is why the table itself is allocated on a cache line.
+     */
+    template<std::uint8_t initial_global_depth, bool optimistic_reads = true, std::uint32_t migrate_slots = 0,
+             std::uint8_t bucket_entries = 4, std::uint8_t overflow_pages = 2,
+             typename bucket_lock_type = utils::rw_spinlock, typename directory_lock_type = utils::distributed_rw_lock>
+    class extendible_hash_table : public abstract_index, public utils::cache_aligned {
     private:
         abstract_hash<hash_value_t>& hash;
-            
-        static const std::uint8_t bucket_entries = 4; //(CACHE_LINE_SIZE - sizeof(std::uint8_t))/sizeof(hash_entry);
-        struct alignas(CACHE_LINE_SIZE) hash_bucket {
-            std::uint8_t  local_depth;
-            std::uint8_t  entry_count;
+
+        static const std::uint32_t read_retries_before_yield = 64;
+        static const std::uint8_t max_split_doublings = 8;
+        static const std::uint8_t no_split = 0xFF;
+        // Half a bucket, so that a merged bucket does not split again on the next inserts
+        static const std::uint8_t merge_threshold = bucket_entries / 2;
+
+        static_assert(bucket_entries > 0 && overflow_pages > 0, "a bucket needs entries and an overflow page");
+        static_assert(bucket_entries * (1 + overflow_pages) <= 0xFF, "entry count of a bucket must fit in 8 bits");
+
+        // One byte of the hash value per entry, read before the entry itself,
+        // so that a lookup for a missing key stays within the bucket. Taken
+        // from the top bits, the bottom ones select the bucket.
+        static std::uint8_t fingerprint(hash_value_t hash_value) {
+            return hash_value >> (8 * sizeof(hash_value_t) - 8);
+        }
+
+        // Overflow pages are allocated starting on a cache line, like buckets
+        struct entry_block : public utils::cache_aligned {
+            std::atomic<std::uint8_t>  fingerprints[bucket_entries];
+            std::atomic<bucket_entry*> entries[bucket_entries];
+
+            entry_block() {
+                for (std::uint8_t e = 0; e < bucket_entries; e++) {
+                    fingerprints[e] = 0;
+                    entries[e] = nullptr;
+                }
+            }
+        };
+
+        // Entries past bucket_entries live in overflow pages. A page stays
+        // with its bucket once allocated, so readers can follow it freely.
+        //
+        // Buckets start on a cache line. Header, fingerprints and entry
+        // pointers come first and take 16 + 9 * bucket_entries bytes, see
+        // extendible_bucket_entries, the lock follows them.
+        struct alignas(CACHE_LINE_SIZE) hash_bucket : public utils::cache_aligned {
+            static const std::uint8_t capacity = bucket_entries * (1 + overflow_pages);
+
+            std::atomic<std::uint64_t> version; // Odd while a writer modifies the bucket
+            std::atomic<std::uint8_t>  local_depth;
+            std::atomic<std::uint8_t>  entry_count;
+            std::atomic<bool> merged; // Merged into its buddy, left with an odd version
             const std::uint32_t original_index;
 
-            std::vector<std::string> keys;
-            std::vector<std::string> values;
-            boost::shared_mutex local_mutex;
+            entry_block inline_entries;
+            std::atomic<entry_block*> overflow[overflow_pages];
+            bucket_lock_type local_mutex;
 
-            hash_bucket(std::uint8_t _local_depth, std::uint8_t _bucket_entries, const std::uint32_t _original_index) : local_depth(_local_depth), original_index(_original_index){
-                keys = std::vector<std::string>{_bucket_entries};
-                values = std::vector<std::string>{_bucket_entries};
-                entry_count = 0;
+            hash_bucket(std::uint8_t _local_depth, const std::uint32_t _original_index) : version(0), local_depth(_local_depth), entry_count(0), merged(false), original_index(_original_index){
+                for (std::uint8_t p = 0; p < overflow_pages; p++) {
+                    overflow[p] = nullptr;
+                }
             }
 
-            ~hash_bucket() {}
-            void clear(){
+            ~hash_bucket() {
                 for (std::uint8_t e = 0; e < entry_count; e++) {
-                    keys[e] = "";
-                    values[e] = "";
+                    delete entry(e);
+                }
+                for (std::uint8_t p = 0; p < overflow_pages; p++) {
+                    delete overflow[p].load();
                 }
-                entry_count = 0;
             }
-            void set_equal_to_copy(const hash_bucket &other){
-                local_depth  = other.local_depth;
-                entry_count  = other.entry_count;
-                if (entry_count > bucket_entries)
-                    throw ("Trying to overflow bucket: " + std::to_string(original_index));
-                std::copy(&other.keys[0], &other.keys[bucket_entries], &keys[0]);
-                std::copy(&other.values[0], &other.values[bucket_entries], &values[0]);
+
+            void begin_write() {
+                version.fetch_add(1, std::memory_order_acq_rel);
             }
-            void insert_next(std::string new_key, std::string new_value) {
-                keys  [entry_count] = new_key;
-                values[entry_count] = new_value;
-                entry_count++;
-                if (entry_count > bucket_entries)
+            void end_write() {
+                version.fetch_add(1, std::memory_order_release);
+            }
+
+            // Block holding entry i, null if it lies in an overflow page that was never allocated
+            entry_block* block(std::uint8_t i) {
+                if (i < bucket_entries) {
+                    return &inline_entries;
+                }
+                return overflow[i / bucket_entries - 1].load(std::memory_order_acquire);
+            }
+
+            // Entry i if its fingerprint matches, null otherwise
+            bucket_entry* candidate(std::uint8_t i, std::uint8_t fp) {
+                entry_block* b = block(i);
+                if (!b || b->fingerprints[i % bucket_entries].load(std::memory_order_relaxed) != fp) {
+                    return nullptr;
+                }
+                return b->entries[i % bucket_entries].load(std::memory_order_acquire);
+            }
+
+            bucket_entry* entry(std::uint8_t i) {
+                entry_block* b = block(i);
+                return b ? b->entries[i % bucket_entries].load(std::memory_order_acquire) : nullptr;
+            }
+
+            // Sets entry i, whose block must exist
+            void set_entry(std::uint8_t i, bucket_entry* new_entry) {
+                entry_block* b = block(i);
+                b->fingerprints[i % bucket_entries].store(new_entry ? fingerprint(new_entry->hash_value) : 0, std::memory_order_relaxed);
+                b->entries[i % bucket_entries].store(new_entry, std::memory_order_release);
+            }
+
+            void insert_next(bucket_entry* new_entry) {
+                if (entry_count >= capacity)
                     throw ("Trying to overflow bucket: " + std::to_string(original_index));
+                std::uint8_t i = entry_count;
+                if (!block(i)) {
+                    overflow[i / bucket_entries - 1].store(new entry_block(), std::memory_order_release);
+                }
+                set_entry(i, new_entry);
+                entry_count++;
             }
 
-            void move_last_to(std::uint32_t i) {
+            void move_last_to(std::uint8_t i) {
                 entry_count--;
-                keys  [i] = keys[entry_count];
-                values[i] = values[entry_count];
-                keys  [entry_count] = "";
-                values[entry_count] = "";
+                set_entry(i, entry(entry_count));
+                set_entry(entry_count, nullptr);
+            }
+
+            // Clears the slots past entry_count after the entries were redistributed
+            void clear_unused() {
+                for (std::uint8_t i = entry_count; i < capacity && block(i); i++) {
+                    set_entry(i, nullptr);
+                }
+            }
+        };
+
+        // The directory is replaced as a whole when it grows, so that an
+        // optimistic reader never looks at a slot array that has been freed.
+        // The old directory is retired through the epoch manager.
+        //
+        // A directory grown incrementally starts out with empty slots that
+        // fall back to the previous directory until they are migrated.
+        struct bucket_directory {
+            const std::uint8_t global_depth;
+            std::atomic<hash_bucket*>* const buckets;
+            std::atomic<bucket_directory*> previous;
+            std::atomic<std::uint64_t> migrate_cursor;
+            std::atomic<std::uint64_t> migrated;
+            std::atomic<std::uint32_t> full_depth_buckets; // Buckets at global_depth, none lets the directory halve
+
+            // calloc, as fresh pages come zeroed from the kernel and a large
+            // empty directory then costs no copy and no memset.
+            bucket_directory(std::uint8_t _global_depth, bucket_directory* _previous = nullptr) : global_depth(_global_depth),
+                    buckets(static_cast<std::atomic<hash_bucket*>*>(std::calloc((size_t)1<<_global_depth, sizeof(std::atomic<hash_bucket*>)))),
+                    previous(_previous), migrate_cursor(0), migrated(0), full_depth_buckets(0) {
+                if (!buckets)
+                    throw std::bad_alloc();
+            }
+            ~bucket_directory() {
+                std::free(buckets);
+            }
 
+            size_t size() const {
+                return (size_t)1<<global_depth;
+            }
+            hash_bucket* get(std::uint32_t i) const {
+                hash_bucket* bucket = buckets[i].load(std::memory_order_acquire);
+                if (!bucket) { // Not migrated yet
+                    bucket_directory* prev = previous.load(std::memory_order_acquire);
+                    // Without a previous directory the migration finished after the first load
+                    bucket = prev ? prev->get(i & (prev->size()-1)) : buckets[i].load(std::memory_order_acquire);
+                }
+                return bucket;
+            }
+            void set(std::uint32_t i, hash_bucket* bucket) {
+                buckets[i].store(bucket, std::memory_order_release);
             }
         };
 
-        std::uint8_t global_depth = initial_global_depth;
-        std::vector<hash_bucket*> directory{directory_size()};
+        std::atomic<bucket_directory*> directory;
 
-        boost::shared_mutex global_mutex;
+        // Taken shared by splits that only rewrite their own directory slots,
+        // exclusively by a split that replaces the directory.
+        directory_lock_type directory_mutex;
 
         std::uint32_t create_bit_mask(std::uint32_t b)
         {
@@ -83,204 +250,482 @@ namespace dbindex {
             return r;
         }
 
-        std::vector<hash_bucket*> create_split_buckets(hash_bucket* initial_bucket, std::uint32_t bucket_number, std::string new_key, std::string new_value) {
+        static hash_value_t depth_mask(std::uint8_t depth) {
+            return depth >= 32 ? ~(hash_value_t)0 : (((hash_value_t)1 << depth) - 1);
+        }
+
+        // A bucket only holds keys whose lowest local_depth bits equal its
+        // original index. Used to detect that a bucket was split or merged
+        // after it was looked up in the directory.
+        static bool bucket_owns_hash(hash_bucket* bucket, hash_value_t hash_value) {
+            return !bucket->merged.load(std::memory_order_acquire) &&
+                   (hash_value & depth_mask(bucket->local_depth)) == bucket->original_index;
+        }
+
+        bucket_directory* current_directory() {
+            return directory.load(std::memory_order_acquire);
+        }
+
+        // Locks the bucket holding hash_value, retrying if the bucket was
+        // split while waiting for its lock. Requires an epoch guard.
+        hash_bucket* lock_owning_bucket(hash_value_t hash_value, boost::unique_lock<bucket_lock_type>& local_exclusive_lock) {
+            while (true) {
+                bucket_directory* dir = current_directory();
+                hash_bucket* bucket   = dir->get(hash_value & (dir->size()-1));
+                local_exclusive_lock = boost::unique_lock<bucket_lock_type>(bucket->local_mutex);
+                if (bucket_owns_hash(bucket, hash_value)) {
+                    return bucket;
+                }
+                local_exclusive_lock.unlock();
+            }
+        }
+
+        // Splits the bucket, and the half the new entry falls in, until that
+        // half has room for it. Only called when calc_new_local_depth found
+        // a depth at which this happens.
+        std::vector<hash_bucket*> create_split_buckets(hash_bucket* initial_bucket, std::uint32_t bucket_number, bucket_entry* new_entry) {
             std::vector<hash_bucket*> buckets_to_insert;
+            hash_value_t new_hash_value = new_entry->hash_value;
 
             hash_bucket* bucket = initial_bucket;
-            // std::cout << "Starting : " << hash.get_hash(new_key) << std::endl;
+            bucket_entry* old_entries[hash_bucket::capacity];
             while (true) { // Runs until broken, i.e. when a spot is found for the new key.
+                std::uint8_t old_entry_count = bucket->entry_count;
+                for (std::uint8_t i = 0; i < old_entry_count; i++) {
+                    old_entries[i] = bucket->entry(i);
+                }
                 bucket->local_depth++;
-                // if (bucket->local_depth > 7)
-                    // print_extendible_hash_bucket(bucket, bucket_number, false);
                 bucket->entry_count = 0;
 
                 // Create image bucket //
-                std::uint32_t image_number = bucket_number + (1<<(bucket->local_depth-1));
-                hash_bucket* image_bucket = new hash_bucket(bucket->local_depth, bucket_entries, image_number);
+                std::uint32_t image_number = bucket_number + ((std::uint32_t)1<<(bucket->local_depth-1));
+                hash_bucket* image_bucket = new hash_bucket(bucket->local_depth, image_number);
                 buckets_to_insert.push_back(image_bucket);
-                
+
                 // Split entries between bucket and image bucket //
-                for (uint8_t i = 0; i < bucket_entries; i++) {
-                    if (!((hash.get_hash(bucket->keys[i]) >> (bucket->local_depth-1)) & 1)) { // Original bucket
-                        bucket->insert_next(bucket->keys[i], bucket->values[i]);
+                for (std::uint8_t i = 0; i < old_entry_count; i++) {
+                    if (!((old_entries[i]->hash_value >> (bucket->local_depth-1)) & 1)) { // Original bucket
+                        bucket->insert_next(old_entries[i]);
                     }
                     else { // Image bucket
-                        image_bucket->insert_next(bucket->keys[i], bucket->values[i]);
+                        image_bucket->insert_next(old_entries[i]);
                     }
                 }
+                bucket->clear_unused();
 
                 // Check which bucket new value should enter //
-                hash_value_t new_hash_value = hash.get_hash(new_key);
-                if (!((new_hash_value >> (bucket->local_depth-1)) & 1)) { // Should go in original bucket
-                    if (bucket->entry_count < bucket_entries) { // Insert in bucket
-                        bucket->insert_next(new_key, new_value);
-                        break;
-                    } // Else, continue (left out)
-                } // Else, it should go in the image bucket
-                else if (image_bucket->entry_count < bucket_entries) { // Insert new in image bucket
-                    image_bucket->insert_next(new_key, new_value);
+                hash_bucket* new_bucket = ((new_hash_value >> (bucket->local_depth-1)) & 1) ? image_bucket : bucket;
+                if (new_bucket->entry_count < bucket_entries) {
+                    new_bucket->insert_next(new_entry);
                     break;
-                } else { // Do another iteration
-                    bucket = image_bucket;
-                    bucket_number = image_number;
-                    // (Continue next iteration)
                 }
-                    // print_extendible_hash_bucket(bucket, bucket_number, false);
+                // Else, do another iteration on the half of the new key
+                bucket = new_bucket;
+                bucket_number = new_bucket->original_index;
             }
 
             return buckets_to_insert;
         }
 
-        std::uint8_t calc_new_local_depth(hash_bucket *bucket, const hash_value_t new_hash_value, std::uint32_t bucket_number) {
+        // Points every directory slot with the prefix of an image bucket to it.
+        void install_split_buckets(bucket_directory* dir, const std::vector<hash_bucket*>& buckets_to_insert) {
+            for (typename std::vector<hash_bucket*>::const_iterator it = buckets_to_insert.begin(); it != buckets_to_insert.end(); ++it) {
+                hash_bucket*  image_bucket   = *it;
+                std::uint32_t ptr_index      = image_bucket->original_index;
+                while (ptr_index < dir->size()) { // Update all other pointers with this prefix.
+                    dir->set(ptr_index, image_bucket);
+                    ptr_index += (1<<image_bucket->local_depth);
+                }
+            }
+        }
+
+        // Only the last split of a chain produces buckets at its final
+        // depth, the bucket and its last image.
+        static void count_full_depth_split(bucket_directory* dir, const std::vector<hash_bucket*>& buckets_to_insert) {
+            if (buckets_to_insert.back()->local_depth == dir->global_depth) {
+                dir->full_depth_buckets.fetch_add(2, std::memory_order_relaxed);
+            }
+        }
+
+        // Local depth the bucket must be split to before the new hash value
+        // falls in a half with a free inline entry, no_split if splitting
+        // cannot get there because too many keys share the full hash value.
+        std::uint8_t calc_new_local_depth(hash_bucket *bucket, const hash_value_t new_hash_value) {
             // Calculating hash values
-            hash_value_t hash_values[bucket_entries+1];
-            for (std::uint8_t e = 0; e < bucket_entries; e++) {
-                hash_values[e] = hash.get_hash(bucket->keys[e]);
+            hash_value_t hash_values[hash_bucket::capacity];
+            std::uint8_t entry_count = bucket->entry_count;
+            for (std::uint8_t e = 0; e < entry_count; e++) {
+                hash_values[e] = bucket->entry(e)->hash_value;
             }
-            hash_values[bucket_entries] = new_hash_value;
 
-            // Checking common digits
-            std::uint8_t new_local_depth = 0;
-            std::uint8_t common_digit_nums;
-            do {
+            // Following the half of the new hash value
+            std::uint8_t new_local_depth = bucket->local_depth;
+            while (entry_count >= bucket_entries) {
+                if (new_local_depth == 8 * sizeof(hash_value_t)) {
+                    return no_split;
+                }
                 new_local_depth++;
-                common_digit_nums = 0;
-                for (std::uint8_t e = 0; e < bucket_entries+1; e++) {
-                    common_digit_nums += (hash_values[e] >> (new_local_depth-1)) & 1;
+                std::uint8_t kept = 0;
+                for (std::uint8_t e = 0; e < entry_count; e++) {
+                    if (((hash_values[e] ^ new_hash_value) >> (new_local_depth-1) & 1) == 0) {
+                        hash_values[kept++] = hash_values[e];
+                    }
                 }
+                entry_count = kept;
             }
-            while (common_digit_nums == 0 || common_digit_nums == bucket_entries+1);
 
-            // Secondary calculation
-            hash_value_t max_hash_value = 0;
-            for (std::uint8_t e = 0; e < bucket_entries+1; e++) {
-                if (max_hash_value < hash_values[e]) {
-                    max_hash_value = hash_values[e];
-                    // std::cout << "New Max: " << max_hash_value << std::endl;
-                }
-            }
-            // std::cout << "Max: " << max_hash_value << std::endl;
-            hash_value_t diff_or = 0;
-            for (std::uint8_t e = 0; e < bucket_entries+1; e++) {
-                diff_or |= (max_hash_value - hash_values[e]);
-            }
             return new_local_depth;
         }
 
         void insert_internal_shared(const std::string& key, const std::string& new_value) {
-            boost::shared_lock<boost::shared_mutex> global_shared_lock(global_mutex);
+            utils::epoch_manager::guard epoch_guard;
+            help_migrate();
             hash_value_t hash_value = hash.get_hash(key);
-            std::uint32_t bucket_number = directory[hash_value & create_bit_mask(global_depth-1)]->original_index;
 
-            boost::unique_lock<boost::shared_mutex> local_exclusive_lock(directory[bucket_number]->local_mutex);
-            while (directory[hash_value & create_bit_mask(global_depth-1)]->original_index != bucket_number) { // Ensuring correct bucket number 
+            boost::unique_lock<bucket_lock_type> local_exclusive_lock;
+            hash_bucket* bucket = lock_owning_bucket(hash_value, local_exclusive_lock);
+            std::uint32_t bucket_number = bucket->original_index;
+
+            if (bucket->entry_count < bucket_entries) {
+                bucket->begin_write();
+                bucket->insert_next(bucket_entry::create(hash_value, key, new_value));
+                bucket->end_write();
                 local_exclusive_lock.unlock();
-                bucket_number = directory[hash_value & create_bit_mask(global_depth-1)]->original_index;
-                local_exclusive_lock = boost::unique_lock<boost::shared_mutex>(directory[bucket_number]->local_mutex);
+                return;
             }
 
-            if (directory[bucket_number]->entry_count < bucket_entries) {
-                directory[bucket_number]->insert_next(key, new_value);
+            // Splits that fit in the directory run concurrently, they only
+            // write the directory slots of their own bucket.
+            boost::shared_lock<directory_lock_type> directory_shared_lock(directory_mutex);
+            bucket_directory* dir = current_directory();
+            std::uint8_t new_local_depth = calc_new_local_depth(bucket, hash_value);
+            if (new_local_depth <= dir->global_depth) {
+                bucket->begin_write();
+                std::vector<hash_bucket*> buckets_to_insert = create_split_buckets(bucket, bucket_number, bucket_entry::create(hash_value, key, new_value));
+                install_split_buckets(dir, buckets_to_insert);
+                count_full_depth_split(dir, buckets_to_insert);
+                bucket->end_write();
+                directory_shared_lock.unlock();
+                local_exclusive_lock.unlock();
+                return;
+            }
+            // Low entropy hash values, rather chain than blow up the directory
+            if (new_local_depth > dir->global_depth + max_split_doublings && bucket->entry_count < hash_bucket::capacity) {
+                bucket->begin_write();
+                bucket->insert_next(bucket_entry::create(hash_value, key, new_value));
+                bucket->end_write();
+                directory_shared_lock.unlock();
                 local_exclusive_lock.unlock();
-                global_shared_lock.unlock();
                 return;
-            } 
+            }
+            if (new_local_depth == no_split) {
+                throw ("Trying to overflow bucket: " + std::to_string(bucket_number));
+            }
+            directory_shared_lock.unlock();
 
-            if (calc_new_local_depth(directory[bucket_number], hash_value, bucket_number) <= global_depth) {
-                std::vector<hash_bucket*> buckets_to_insert = create_split_buckets(directory[bucket_number], bucket_number, key, new_value);
+            // The bucket stays locked, so it is still full when the directory lock is taken exclusively.
+            insert_internal_exclusive(bucket, hash_value, key, new_value);
+            local_exclusive_lock.unlock();
+        }
 
-                for (typename std::vector<hash_bucket*>::iterator it = buckets_to_insert.begin(); it != buckets_to_insert.end(); ++it) {
-                    hash_bucket*  image_bucket   = *it;
-                    std::uint32_t ptr_index      = image_bucket->original_index;
-                    while (ptr_index < directory_size()) { // Update all other pointers with this prefix.
-                        directory[ptr_index] = image_bucket;
-                        ptr_index += (1<<image_bucket->local_depth);
-                    }
+        // Splits a full and locked bucket, growing the directory if needed.
+        // The grown directory is built next to the current one, which stays
+        // readable and updatable, and is published with a single pointer swap.
+        void insert_internal_exclusive(hash_bucket* bucket, hash_value_t hash_value, const std::string& key, const std::string& new_value) {
+            boost::unique_lock<directory_lock_type> directory_exclusive_lock(directory_mutex);
+            bucket_directory* dir = current_directory();
+
+            bucket->begin_write();
+            std::vector<hash_bucket*> buckets_to_insert = create_split_buckets(bucket, bucket->original_index, bucket_entry::create(hash_value, key, new_value));
+
+            if (buckets_to_insert.back()->local_depth <= dir->global_depth) { // Directory grew in the meantime
+                install_split_buckets(dir, buckets_to_insert);
+                count_full_depth_split(dir, buckets_to_insert);
+                bucket->end_write();
+                directory_exclusive_lock.unlock();
+                return;
+            }
+
+            // An unfinished incremental migration is completed before growing again
+            migrate_directory(dir, dir->size());
+
+            bucket_directory* new_dir;
+            if (migrate_slots == 0) {
+                new_dir = new bucket_directory(buckets_to_insert.back()->local_depth);
+                for (std::uint32_t i = 0; i < new_dir->size(); i++) {
+                    new_dir->set(i, dir->get(i & (dir->size()-1)));
                 }
-                local_exclusive_lock.unlock();
-                global_shared_lock.unlock();
+            } else {
+                new_dir = new bucket_directory(buckets_to_insert.back()->local_depth, dir);
+            }
+            install_split_buckets(new_dir, buckets_to_insert);
+            count_full_depth_split(new_dir, buckets_to_insert);
+            directory.store(new_dir, std::memory_order_release);
+            bucket->end_write();
+            directory_exclusive_lock.unlock();
+
+            if (migrate_slots == 0) {
+                // Readers and writers may still be looking at the old directory
+                utils::epoch_manager::instance().retire(dir);
+            }
+        }
+
+        // Copies up to slots not yet migrated slots from the previous
+        // directory. The thread completing the migration retires the previous
+        // directory. Requires directory_mutex.
+        void migrate_directory(bucket_directory* dir, std::uint64_t slots) {
+            bucket_directory* prev = dir->previous.load(std::memory_order_acquire);
+            if (!prev) {
+                return;
+            }
+            std::uint64_t start = dir->migrate_cursor.fetch_add(slots);
+            if (start >= dir->size()) {
                 return;
             }
+            std::uint64_t end = std::min<std::uint64_t>(start + slots, dir->size());
+            for (std::uint64_t i = start; i < end; i++) {
+                // A split may have set the slot already, that value is newer
+                hash_bucket* expected = nullptr;
+                dir->buckets[i].compare_exchange_strong(expected, prev->get(i & (prev->size()-1)));
+            }
+            if (dir->migrated.fetch_add(end - start) + (end - start) == dir->size()) {
+                dir->previous.store(nullptr, std::memory_order_release);
+                utils::epoch_manager::instance().retire(prev);
+            }
+        }
 
-            local_exclusive_lock.unlock();
-            global_shared_lock.unlock();
-            return insert_internal_exclusive(key, new_value);
+        // Writers pay for a bounded part of a pending directory migration
+        void help_migrate() {
+            if (migrate_slots == 0 || !current_directory()->previous.load(std::memory_order_acquire)) {
+                return;
+            }
+            boost::shared_lock<directory_lock_type> directory_shared_lock(directory_mutex);
+            migrate_directory(current_directory(), migrate_slots);
         }
-        void insert_internal_exclusive(const std::string& key, const std::string& new_value) {
-            boost::unique_lock<boost::shared_mutex> global_exclusive_lock(global_mutex);
 
-            // Search for free slot
-            hash_value_t hash_value = hash.get_hash(key);
-            std::uint32_t bucket_number = directory[hash_value & create_bit_mask(global_depth-1)]->original_index;
+        // Merges the bucket of hash_value into its buddy, or the buddy into
+        // it, and the result into its own buddy, as long as the buckets of a
+        // pair are at the same depth and hold at most merge_threshold
+        // entries together. Then halves the directory while no bucket needs
+        // its full depth. Requires an epoch guard and no bucket lock.
+        void merge_buckets(hash_value_t hash_value) {
+            while (merge_buddies(hash_value)) {}
+            shrink_directory();
+        }
+
+        // The bucket with the top bit of the local depth clear survives, the
+        // other one keeps an odd version, so optimistic readers retry, and
+        // is marked merged, so writers waiting for its lock retry.
+        bool merge_buddies(hash_value_t hash_value) {
+            bucket_directory* dir = current_directory();
+            hash_bucket* bucket = dir->get(hash_value & (dir->size()-1));
+            std::uint8_t local_depth = bucket->local_depth;
+            if (local_depth <= initial_global_depth) {
+                return false;
+            }
+            std::uint32_t high_bit  = (std::uint32_t)1 << (local_depth-1);
+            std::uint32_t low_index = bucket->original_index & ~high_bit;
+            hash_bucket* low  = dir->get(low_index);
+            hash_bucket* high = dir->get(low_index | high_bit);
+            if (low == high) {
+                return false;
+            }
+
+            // Buckets before the directory, lower index first, like every writer
+            boost::unique_lock<bucket_lock_type> low_lock(low->local_mutex);
+            boost::unique_lock<bucket_lock_type> high_lock(high->local_mutex);
+            // Either may have been split, merged or refilled since the directory was read
+            if (low->merged || high->merged || low->local_depth != local_depth || high->local_depth != local_depth ||
+                low->original_index != low_index || high->original_index != (low_index | high_bit) ||
+                low->entry_count + high->entry_count > merge_threshold) {
+                return false;
+            }
+            // Every slot of the buddy is set, so none falls back to a pending
+            // migration's previous directory, which still names it.
+            boost::shared_lock<directory_lock_type> directory_shared_lock(directory_mutex);
+            dir = current_directory();
+
+            low->begin_write();
+            high->begin_write();
+            for (std::uint8_t i = 0; i < high->entry_count; i++) {
+                low->insert_next(high->entry(i));
+            }
+            high->entry_count = 0;
+            high->merged = true;
+            low->local_depth = local_depth - 1;
+            for (std::uint32_t i = low_index | high_bit; i < dir->size(); i += 2*high_bit) {
+                dir->set(i, low);
+            }
+            if (local_depth == dir->global_depth) {
+                dir->full_depth_buckets.fetch_sub(2, std::memory_order_relaxed);
+            }
+            low->end_write();
+            directory_shared_lock.unlock();
+            high_lock.unlock();
+            utils::epoch_manager::instance().retire(high);
+            return true;
+        }
 
-            if (directory[bucket_number]->entry_count < bucket_entries) {
-                directory[bucket_number]->insert_next(key, new_value);
-                global_exclusive_lock.unlock();
+        // Replaces the directory by its lower half while no bucket is at the
+        // global depth, every slot of the upper half then names the same
+        // bucket as its counterpart.
+        void shrink_directory() {
+            bucket_directory* dir = current_directory();
+            if (dir->global_depth <= initial_global_depth || dir->full_depth_buckets.load(std::memory_order_relaxed) != 0) {
                 return;
-            } 
+            }
+            boost::unique_lock<directory_lock_type> directory_exclusive_lock(directory_mutex);
+            dir = current_directory();
+            migrate_directory(dir, dir->size());
+            while (dir->global_depth > initial_global_depth && dir->full_depth_buckets.load(std::memory_order_relaxed) == 0) {
+                bucket_directory* new_dir = new bucket_directory(dir->global_depth - 1);
+                std::uint32_t full_depth_buckets = 0;
+                for (std::uint32_t i = 0; i < new_dir->size(); i++) {
+                    hash_bucket* bucket = dir->get(i);
+                    new_dir->set(i, bucket);
+                    if (bucket->original_index == i && bucket->local_depth == new_dir->global_depth) {
+                        full_depth_buckets++;
+                    }
+                }
+                new_dir->full_depth_buckets = full_depth_buckets;
+                directory.store(new_dir, std::memory_order_release);
+                utils::epoch_manager::instance().retire(dir);
+                dir = new_dir;
+            }
+        }
+
+        bool get_optimistic(hash_value_t hash_value, const std::string& key, std::string& value) {
+            utils::epoch_manager::guard epoch_guard;
+            const std::uint8_t fp = fingerprint(hash_value);
+            for (std::uint32_t attempt = 1; ; attempt++) {
+                if (attempt % read_retries_before_yield == 0) {
+                    std::this_thread::yield(); // The writer may have been descheduled
+                }
+                bucket_directory* dir = current_directory();
+                hash_bucket* bucket   = dir->get(hash_value & (dir->size()-1));
+
+                std::uint64_t version = bucket->version.load(std::memory_order_acquire);
+                if ((version & 1) || !bucket_owns_hash(bucket, hash_value)) {
+                    continue; // Writer active or bucket split since the directory was read
+                }
 
-            std::vector<hash_bucket*> buckets_to_insert = create_split_buckets(directory[bucket_number], bucket_number, key, new_value);
+                bucket_entry* found = nullptr;
+                std::uint8_t entry_count = bucket->entry_count.load(std::memory_order_relaxed);
+                for (uint8_t i = 0; i < entry_count && i < hash_bucket::capacity; i++) {
+                    bucket_entry* e = bucket->candidate(i, fp);
+                    if (e && e->matches(hash_value, key)) {
+                        found = e;
+                        break;
+                    }
+                }
 
-            if (buckets_to_insert.back()->local_depth <= global_depth) {
-                for (typename std::vector<hash_bucket*>::iterator it = buckets_to_insert.begin(); it != buckets_to_insert.end(); ++it) {
-                    hash_bucket*  image_bucket   = *it;
-                    std::uint32_t ptr_index      = image_bucket->original_index;
-                    while (ptr_index < directory_size()) { // Update all other pointers with this prefix.
-                        directory[ptr_index] = image_bucket;
-                        ptr_index += (1<<image_bucket->local_depth);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (bucket->version.load(std::memory_order_relaxed) == version) {
+                    if (found) {
+                        found->read_value(value);
                     }
+                    return found != nullptr;
                 }
-                global_exclusive_lock.unlock();
-                return;
             }
+        }
 
-            std::uint8_t splits = buckets_to_insert.back()->local_depth - global_depth;
-            size_t old_size = 1 << global_depth;
-            size_t new_size = 1 << (global_depth + splits);
+        bool get_locked(hash_value_t hash_value, const std::string& key, std::string& value) {
+            utils::epoch_manager::guard epoch_guard;
+            const std::uint8_t fp = fingerprint(hash_value);
+            while (true) {
+                bucket_directory* dir = current_directory();
+                hash_bucket* bucket   = dir->get(hash_value & (dir->size()-1));
+
+                // Take local lock shared;
+                boost::shared_lock<bucket_lock_type> local_shared_lock(bucket->local_mutex);
+                if (!bucket_owns_hash(bucket, hash_value)) {
+                    continue; // Bucket was split while waiting for the lock
+                }
+                for (uint8_t i = 0; i < bucket->entry_count; i++) {
+                    bucket_entry* e = bucket->candidate(i, fp);
+                    if (e && e->matches(hash_value, key)) {
+                        e->read_value(value);
+                        local_shared_lock.unlock();
+                        return true;
+                    }
+                }
+                local_shared_lock.unlock();
+                return false;
+            }
+        }
+
+        template<typename cmp>
+        void scan_internal(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) {
+            typedef std::tuple<std::string, std::string> hash_entry;
+
+            std::priority_queue<hash_entry, std::vector<hash_entry>, cmp> pri_queue;
 
-            directory.resize(new_size);
-            for (typename std::vector<hash_bucket*>::iterator it = buckets_to_insert.begin(); it != buckets_to_insert.end(); ++it) {
-                hash_bucket* image_bucket = *it;
-                if (image_bucket->original_index > directory_size()-1) {
-                    std::copy_n(directory.begin(), old_size, directory.begin()+old_size);
-                    old_size <<= 1;
+            // FULL SCAN
+            utils::epoch_manager::guard epoch_guard;
+            bucket_directory* dir = current_directory();
+            for (std::uint32_t i = 0; i < dir->size(); i++) {
+                hash_bucket* bucket = dir->get(i);
+                if (bucket->original_index != i) {
+                    continue; // Bucket is shared with a lower slot and already visited
                 }
-                directory[image_bucket->original_index] = image_bucket;
+                boost::shared_lock<bucket_lock_type> local_shared_lock(bucket->local_mutex);
+                for (std::uint8_t j = 0; j < bucket->entry_count; j++) {
+                    bucket_entry* e = bucket->entry(j);
+                    std::string key = e->key();
+                    if (key >= start_key && (!end_key || key <= *end_key)) {
+                        pri_queue.push(std::make_tuple(key, e->value()));
+                    }
+                }
+            }
+
+            // Apply push op
+            while(!pri_queue.empty()) {
+                hash_entry current = pri_queue.top();
+                std::string key     = std::get<0>(current);
+                std::string value = std::get<1>(current);
+                const char* keyp = key.c_str();
+                if (!apo.invoke(keyp, key.length(), value)) {
+                    return;
+                }
+                pri_queue.pop();
             }
-            global_depth += splits;
-            global_exclusive_lock.unlock();
         }
 
     public:
         extendible_hash_table(abstract_hash<hash_value_t>& _hash) : hash(_hash) {
-            for (std::uint8_t b = 0; b < directory_size(); b++) {
-                hash_bucket *bucket = new hash_bucket(global_depth, bucket_entries, b);
-                directory[b] = bucket;
+            bucket_directory* dir = new bucket_directory(initial_global_depth);
+            for (std::uint32_t b = 0; b < dir->size(); b++) {
+                hash_bucket *bucket = new hash_bucket(initial_global_depth, b);
+                dir->set(b, bucket);
             }
+            dir->full_depth_buckets = dir->size();
+            directory.store(dir);
         }
         ~extendible_hash_table() {
             // print_extendible_hash_table(false);
             // std::cout << directory_size() << std::endl;
-            for (std::uint32_t b = 0; b < directory_size(); b++){
-                if (directory[b]) {
-                    if (directory[b]->original_index != b)
-                        directory[b] = NULL;
+            bucket_directory* dir = current_directory();
+            std::vector<hash_bucket*> buckets;
+            for (std::uint32_t b = 0; b < dir->size(); b++){
+                if (dir->get(b)->original_index == b) {
+                    buckets.push_back(dir->get(b));
                 }
             }
-            for (std::uint32_t b = 0; b < directory_size(); b++){
-                if (directory[b]) {
-                    delete directory[b];
-                }
+            for (hash_bucket* bucket : buckets) {
+                delete bucket;
             }
+            delete dir->previous.load();
+            delete dir;
         }
 
         void print_extendible_hash_table(bool exclusive) {
-            std::cout << (int)global_depth << std::endl;
+            bucket_directory* dir = current_directory();
+            std::cout << (int)dir->global_depth << std::endl;
             for (std::uint8_t j = 0; j < bucket_entries; j++)
                 std::cout << "_______";
             std::cout << "_______" << "_______" << "_______" << "_______" << std::endl;
-            for (std::uint32_t i = 0; i < directory_size(); i++) {
-                print_extendible_hash_bucket(directory[i], i, exclusive);
+            for (std::uint32_t i = 0; i < dir->size(); i++) {
+                print_extendible_hash_bucket(dir->get(i), i, exclusive);
             }
             for (std::uint8_t j = 0; j < bucket_entries; j++)
                 std::cout << "_______";
@@ -288,33 +733,35 @@ namespace dbindex {
         }
         void print_extendible_hash_bucket(hash_bucket* bucket, std::uint32_t i, bool exclusive) {
             std::string text;
-            text += ((bucket->original_index == i) ? "\033[1m " : "\033[0m "); 
+            std::uint8_t local_depth = bucket->local_depth;
+            std::uint8_t entry_count = bucket->entry_count;
+            text += ((bucket->original_index == i) ? "\033[1m " : "\033[0m ");
             text += (i < 10 ? "   " : (i < 100 ? "  " : (i < 1000 ? " " : ""))) + std::to_string((int)i) + " | ";
             text += "\033[0m";
-            text += ((bucket->original_index == i) ? "\033[1;31m" : "\033[0;31m"); 
+            text += ((bucket->original_index == i) ? "\033[1;31m" : "\033[0;31m");
             text += (bucket->original_index < 10 ? "   " : (bucket->original_index < 100 ? "  " : (bucket->original_index < 1000 ? " " : ""))) + std::to_string((int)bucket->original_index);
             text += "\033[0m";
             text += " | ";
-            text += ((bucket->original_index == i) ? "\033[1;32m" : "\033[0;32m"); 
-            text += (bucket->local_depth < 10 ? "   " : (bucket->local_depth < 100 ? "  " : (bucket->local_depth < 1000 ? " " : ""))) + std::to_string((int)bucket->local_depth);
+            text += ((bucket->original_index == i) ? "\033[1;32m" : "\033[0;32m");
+            text += (local_depth < 10 ? "   " : (local_depth < 100 ? "  " : "")) + std::to_string((int)local_depth);
             text += "\033[0m";
             text += " | ";
-            text += ((bucket->original_index == i) ? "\033[1;33m" : "\033[0;33m"); 
-            text += (bucket->entry_count < 10 ? "   " : (bucket->entry_count < 100 ? "  " : (bucket->entry_count < 1000 ? " " : ""))) + std::to_string((int)bucket->entry_count);
-            text += ((bucket->original_index == i) ? "\033[1;34m" : "\033[0m"); 
+            text += ((bucket->original_index == i) ? "\033[1;33m" : "\033[0;33m");
+            text += (entry_count < 10 ? "   " : (entry_count < 100 ? "  " : "")) + std::to_string((int)entry_count);
+            text += ((bucket->original_index == i) ? "\033[1;34m" : "\033[0m");
             text += " | ";
-            for (std::uint8_t j = 0; j < bucket_entries; j++)
+            for (std::uint8_t j = 0; j < std::max(bucket_entries, entry_count); j++)
             {
                 if (!exclusive || bucket->original_index == i){
-                    if (j >= bucket->entry_count) {
+                    if (j >= entry_count) {
                         text += "     | ";
                     }
                     else {
-                        hash.get_hash(bucket->keys[j]);
-                        text += ((bucket->keys[j].length() < 2 ? "   " : (bucket->keys[j].length() < 3 ? "  " : (bucket->keys[j].length() < 4 ? " " : ""))) + bucket->keys[j] + ": " + std::to_string(hash.get_hash(bucket->keys[j]))) + " | ";
+                        const std::string key = bucket->entry(j)->key();
+                        text += ((key.length() < 2 ? "   " : (key.length() < 3 ? "  " : (key.length() < 4 ? " " : ""))) + key + ": " + std::to_string(bucket->entry(j)->hash_value)) + " | ";
                     }
                 }
-                else 
+                else
                     text += "     | ";
             }
             text += "\033[0m";
@@ -323,151 +770,109 @@ namespace dbindex {
 
         bool get(const std::string& key, std::string& value) override {
             hash_value_t hash_value = hash.get_hash(key);
-            
-            // Take global lock shared;
-            boost::shared_lock<boost::shared_mutex> global_shared_lock(global_mutex);
-            std::uint32_t bucket_number = hash_value & (directory_size()-1);
-
-            // Take local lock shared;
-            boost::shared_lock<boost::shared_mutex> local_shared_lock(directory[bucket_number]->local_mutex);
-            for (uint8_t i = 0; i < bucket_entries; i++) {
-                if (directory[bucket_number]->keys[i] == key) {
-                    value = directory[bucket_number]->values[i];
-                    local_shared_lock.unlock();
-                    global_shared_lock.unlock();
-                    return true;
-                }
+            if (optimistic_reads) {
+                return get_optimistic(hash_value, key, value);
             }
-            local_shared_lock.unlock();
-            global_shared_lock.unlock();
-            return false;
+            return get_locked(hash_value, key, value);
         }
 
         void insert(const std::string& key, const std::string& new_value) override {
             insert_internal_shared(key, new_value);
         }
-        
+
         // Returns previous value, if found, -1 otherwise
         void update(const std::string& key, const std::string& new_value) override {
             hash_value_t hash_value = hash.get_hash(key);
 
-            boost::shared_lock<boost::shared_mutex> global_shared_lock(global_mutex);
-            std::uint32_t bucket_number = hash_value & (directory_size()-1);
-            
-            boost::unique_lock<boost::shared_mutex> local_exclusive_lock(directory[bucket_number]->local_mutex);
-            for (uint8_t i = 0; i < bucket_entries; i++) {
-                if (directory[bucket_number]->keys[i] == key) {
-                    directory[bucket_number]->values[i] = new_value;
+            utils::epoch_manager::guard epoch_guard;
+            help_migrate();
+            boost::unique_lock<bucket_lock_type> local_exclusive_lock;
+            hash_bucket* bucket = lock_owning_bucket(hash_value, local_exclusive_lock);
+            for (uint8_t i = 0; i < bucket->entry_count; i++) {
+                bucket_entry* old_entry = bucket->candidate(i, fingerprint(hash_value));
+                if (old_entry && old_entry->matches(hash_value, key)) {
+                    bucket->begin_write();
+                    bucket->set_entry(i, bucket_entry::create(hash_value, key, new_value));
+                    bucket->end_write();
+                    utils::epoch_manager::instance().retire(old_entry);
                     break;
                 }
             }
             local_exclusive_lock.unlock();
-            global_shared_lock.unlock();
         }
 
         void remove(const std::string& key) override {
             hash_value_t hash_value = hash.get_hash(key);
-            boost::shared_lock<boost::shared_mutex> global_shared_lock(global_mutex);
-            std::uint32_t bucket_number = hash_value & (directory_size()-1);
-            boost::unique_lock<boost::shared_mutex> local_exclusive_lock(directory[bucket_number]->local_mutex);
-            for (uint8_t i = 0; i < directory[bucket_number]->entry_count; i++) {
-                if (directory[bucket_number]->keys[i] == key) { // Entry to be updated found
-                    directory[bucket_number]->move_last_to(i);
+            utils::epoch_manager::guard epoch_guard;
+            help_migrate();
+            boost::unique_lock<bucket_lock_type> local_exclusive_lock;
+            hash_bucket* bucket = lock_owning_bucket(hash_value, local_exclusive_lock);
+            bool merge = false;
+            for (uint8_t i = 0; i < bucket->entry_count; i++) {
+                bucket_entry* old_entry = bucket->candidate(i, fingerprint(hash_value));
+                if (old_entry && old_entry->matches(hash_value, key)) { // Entry to be removed found
+                    bucket->begin_write();
+                    bucket->move_last_to(i);
+                    bucket->end_write();
+                    utils::epoch_manager::instance().retire(old_entry);
+                    merge = bucket->entry_count <= merge_threshold && bucket->local_depth > initial_global_depth;
                     break;
                 }
             }
             local_exclusive_lock.unlock();
-            global_shared_lock.unlock();
+            if (merge) {
+                merge_buckets(hash_value);
+            }
         }
 
         void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override{
             if (end_key) assert(*end_key > start_key);
-
-            typedef std::tuple<std::string, std::string> hash_entry;
-
-            auto cmp = [](hash_entry a, hash_entry b) { return std::get<0>(a) > std::get<0>(b);};
-            std::priority_queue<hash_entry, std::vector<hash_entry>, decltype(cmp)> pri_queue(cmp);
-
-            // FULL SCAN
-            boost::shared_lock<boost::shared_mutex> global_shared_lock(global_mutex);
-            for (std::uint32_t i = 0; i < directory_size(); i++) {          
-                for (std::uint8_t j = 0; j < directory[i]->entry_count; j++) {
-                    if (directory[i]->keys[j] >= start_key && (!end_key || directory[i]->keys[j] <= *end_key)) {
-                        pri_queue.push(std::make_tuple(directory[i]->keys[j], directory[i]->values[j]));
-                    }
-                }
-            }
-            // Apply push op
-            while(!pri_queue.empty()) {
-                hash_entry current = pri_queue.top();
-                std::string key     = std::get<0>(current);
-                std::string value = std::get<1>(current);
-                const char* keyp = key.c_str();
-                if (!apo.invoke(keyp, key.length(), value)) {
-                    global_shared_lock.unlock();
-                    return;
-                }
-                pri_queue.pop();
-            }
-            global_shared_lock.unlock();
+            scan_internal<less_than_hash_entry>(start_key, end_key, apo);
         }
 
         void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override{
             if (end_key) assert(*end_key > start_key);
-            
-            typedef std::tuple<std::string, std::string> hash_entry;
-
-            auto cmp = [](hash_entry a, hash_entry b) { return std::get<0>(a) < std::get<0>(b);};
-            std::priority_queue<hash_entry, std::vector<hash_entry>, decltype(cmp)> pri_queue(cmp);
-
-            // FULL SCAN
-            boost::shared_lock<boost::shared_mutex> global_shared_lock(global_mutex);
-            for (std::uint32_t i = 0; i < directory_size(); i++) {          
-                for (std::uint8_t j = 0; j < directory[i]->entry_count; j++) {
-                    if (directory[i]->keys[j] >= start_key && (!end_key || directory[i]->keys[j] <= *end_key)) {
-                        pri_queue.push(std::make_tuple(directory[i]->keys[j], directory[i]->values[j]));
-                    }
-                }
-            }
-            // Apply push op
-            while(!pri_queue.empty()) {
-                hash_entry current = pri_queue.top();
-                std::string key     = std::get<0>(current);
-                std::string value = std::get<1>(current);
-                const char* keyp = key.c_str();
-                if (!apo.invoke(keyp, key.length(), value)) {
-                    global_shared_lock.unlock();
-                    return;
-                }
-                pri_queue.pop();
-            }
-            global_shared_lock.unlock();
+            scan_internal<greater_than_hash_entry>(start_key, end_key, apo);
         }
 
         std::uint8_t get_global_depth() {
-            return global_depth;
+            return current_directory()->global_depth;
         }
         std::uint8_t get_bucket_entries() {
             return bucket_entries;
         }
+        std::uint8_t get_bucket_capacity() {
+            return hash_bucket::capacity;
+        }
 
         size_t directory_size() {
-            return (1<<global_depth);
+            return current_directory()->size();
+        }
+        size_t bucket_count() {
+            utils::epoch_manager::guard epoch_guard;
+            bucket_directory* dir = current_directory();
+            size_t count = 0;
+            for (std::uint32_t i = 0; i < dir->size(); i++) {
+                if (dir->get(i)->original_index == i) {
+                    count++;
+                }
+            }
+            return count;
         }
         size_t size() {
-            boost::shared_lock<boost::shared_mutex> global_shared_lock(global_mutex);
+            utils::epoch_manager::guard epoch_guard;
+            bucket_directory* dir = current_directory();
             size_t total_entry_count = 0;
-            for (std::uint32_t i = 0; i < directory_size(); i++) {
-                if (directory[i]->original_index == i) {
-                    total_entry_count += directory[i]->entry_count;
+            for (std::uint32_t i = 0; i < dir->size(); i++) {
+                if (dir->get(i)->original_index == i) {
+                    total_entry_count += dir->get(i)->entry_count;
                 }
             }
-            global_shared_lock.unlock();
             return total_entry_count;
         }
 
         std::string to_string() override {
-            return "extendible_hash_table";
+            return optimistic_reads ? "extendible_hash_table" : "extendible_hash_table_locked";
         }
     };
 }
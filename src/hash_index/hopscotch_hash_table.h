@@ -0,0 +1,434 @@
+#ifndef hopscotch_hash_table_h
+#define hopscotch_hash_table_h
+
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "../macros.h"
+
+#include "../abstract_index.h"
+#include "../push_ops.h"
+#include "../util/cache_aligned.h"
+#include "../util/epoch_manager.h"
+#include "bucket_entry.h"
+
+typedef std::uint32_t hash_value_t;
+
+namespace dbindex {
+    /**
+     * Open addressing hash table with hopscotch hashing. Every entry lies
+     * within neighborhood slots of its home slot, and the home slot keeps a
+     * bitmap of which of those slots hold its entries. A lookup reads the
+     * bitmap and only the slots it names, so it never walks a chain and a
+     * hot key costs the same as any other.
+     *
+     * An insert takes the first free slot after the home slot. If it lies
+     * outside the neighborhood, entries between the two are hopped into
+     * it, each staying inside its own neighborhood, until the free slot is
+     * close enough.
+     *
+     * The hash value modulo segment_count picks one of segment_count
+     * segments, the rest of it the home slot there. When an insert cannot
+     * place its entry, a segment at least half full doubles its slots.
+     * get takes no lock. Writers bump the segment version around every
+     * change, hops included, so a get that read an entry mid-hop sees the
+     * version move and reads the bitmap again.
+     *
+     * Keys that no hop can place while the segment is less than half full,
+     * as with a hash function that maps many keys to the same value, go to
+     * an overflow list of the segment, searched under its lock.
+     */
+    template<std::uint32_t initial_segment_capacity = 1024, std::uint32_t segment_count = 64>
+    class hopscotch_hash_table : public abstract_index {
+    private:
+        abstract_hash<hash_value_t>& hash;
+
+        static const std::uint32_t neighborhood = 32; // Bits of hop_info
+        // Slots searched for a free one before the segment grows
+        static const std::uint32_t max_add_range = 512;
+        static const std::uint32_t min_grow_load_percent = 50;
+        static const std::uint32_t read_retries_before_yield = 64;
+
+        static_assert(initial_segment_capacity >= neighborhood && (initial_segment_capacity & (initial_segment_capacity-1)) == 0,
+                      "segment capacity must be a power of two of at least one neighborhood");
+        static_assert(segment_count > 0 && (segment_count & (segment_count-1)) == 0, "segment count must be a power of two");
+
+        struct hash_slot {
+            std::atomic<std::uint32_t> hop_info; // Bit i: slot home+i holds an entry of this home slot
+            std::atomic<hash_value_t>  hash_value;
+            std::atomic<bucket_entry*> entry;
+        };
+
+        // Growing re-adds every entry to a new array of twice the slots,
+        // entries that find no place there go to the overflow list. Gets may
+        // still be reading the old array, so it is retired through the
+        // epoch manager, the entries are not freed with it.
+        struct slot_array {
+            const std::uint32_t capacity;
+            hash_slot* const slots;
+
+            // calloc, zeroed atomics are empty slots and bitmaps
+            slot_array(std::uint32_t _capacity) : capacity(_capacity),
+                slots(static_cast<hash_slot*>(std::calloc(_capacity, sizeof(hash_slot)))) {
+                if (!slots)
+                    throw std::bad_alloc();
+            }
+            ~slot_array() {
+                std::free(slots);
+            }
+        };
+
+        struct alignas(CACHE_LINE_SIZE) hash_segment {
+            std::atomic<std::uint64_t> version{0}; // Odd while a writer modifies the segment
+            std::atomic<slot_array*> array;
+            std::atomic<size_t> entry_count{0};
+            std::atomic<size_t> overflow_size{0};
+            std::vector<bucket_entry*> overflow;   // Guarded by segment_mutex
+            boost::mutex segment_mutex;
+
+            hash_segment() : array(new slot_array(initial_segment_capacity)) {}
+            ~hash_segment() {
+                slot_array* a = array.load();
+                for (std::uint32_t i = 0; i < a->capacity; i++) {
+                    delete a->slots[i].entry.load();
+                }
+                for (bucket_entry* e : overflow) {
+                    delete e;
+                }
+                delete a;
+            }
+
+            void begin_write() {
+                version.fetch_add(1, std::memory_order_acq_rel);
+            }
+            void end_write() {
+                version.fetch_add(1, std::memory_order_release);
+            }
+        };
+
+        std::vector<hash_segment, utils::cache_aligned_allocator<hash_segment>> segments{segment_count};
+
+        static const std::uint32_t not_found = ~(std::uint32_t)0;
+
+        hash_segment& segment_of(hash_value_t hash_value) {
+            return segments[hash_value & (segment_count-1)];
+        }
+        static std::uint32_t home_slot(const slot_array* a, hash_value_t hash_value) {
+            return (hash_value / segment_count) & (a->capacity-1);
+        }
+
+        // Slot of key, not_found if it is not in the neighborhood of its home slot
+        static std::uint32_t find(const slot_array* a, hash_value_t hash_value, const std::string& key) {
+            std::uint32_t home = home_slot(a, hash_value);
+            std::uint32_t hop_info = a->slots[home].hop_info.load(std::memory_order_acquire);
+            for (; hop_info; hop_info &= hop_info - 1) {
+                std::uint32_t i = (home + __builtin_ctz(hop_info)) & (a->capacity-1);
+                if (a->slots[i].hash_value.load(std::memory_order_relaxed) == hash_value) {
+                    bucket_entry* e = a->slots[i].entry.load(std::memory_order_acquire);
+                    if (e && e->matches(hash_value, key)) {
+                        return i;
+                    }
+                }
+            }
+            return not_found;
+        }
+
+        // Overflow index of key, overflow.size() if not present. Requires the segment lock.
+        static size_t find_in_overflow(hash_segment& segment, hash_value_t hash_value, const std::string& key) {
+            for (size_t i = 0; i < segment.overflow.size(); i++) {
+                if (segment.overflow[i]->matches(hash_value, key)) {
+                    return i;
+                }
+            }
+            return segment.overflow.size();
+        }
+
+        // Moves the entry of slot from, of home slot home, to the free slot to
+        static void hop(slot_array* a, std::uint32_t home, std::uint32_t from, std::uint32_t to) {
+            std::uint32_t mask = a->capacity - 1;
+            hash_slot& source = a->slots[from];
+            a->slots[to].hash_value.store(source.hash_value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            a->slots[to].entry.store(source.entry.load(std::memory_order_relaxed), std::memory_order_release);
+            std::uint32_t hop_info = a->slots[home].hop_info.load(std::memory_order_relaxed);
+            hop_info |= 1u << ((to - home) & mask);
+            hop_info &= ~(1u << ((from - home) & mask));
+            a->slots[home].hop_info.store(hop_info, std::memory_order_release);
+            source.entry.store(nullptr, std::memory_order_release);
+        }
+
+        /**
+         * Places e in the neighborhood of its home slot, hopping entries
+         * closer to their home slots to make room. Returns false if there
+         * is no free slot within max_add_range or no entry can hop.
+         */
+        static bool add(slot_array* a, bucket_entry* e) {
+            std::uint32_t mask = a->capacity - 1;
+            std::uint32_t home = home_slot(a, e->hash_value);
+            std::uint32_t range = std::min(max_add_range, a->capacity);
+
+            std::uint32_t distance = 0;
+            while (distance < range && a->slots[(home + distance) & mask].entry.load(std::memory_order_relaxed)) {
+                distance++;
+            }
+            if (distance == range) {
+                return false;
+            }
+            std::uint32_t free_slot = (home + distance) & mask;
+
+            while (distance >= neighborhood) {
+                // The farthest home slot, whose first entry before the free
+                // slot can hop into it
+                bool hopped = false;
+                for (std::uint32_t back = neighborhood - 1; back > 0 && !hopped; back--) {
+                    std::uint32_t candidate_home = (free_slot - back) & mask;
+                    std::uint32_t hop_info = a->slots[candidate_home].hop_info.load(std::memory_order_relaxed);
+                    std::uint32_t before_free = hop_info & ((1u << back) - 1);
+                    if (before_free) {
+                        std::uint32_t from = (candidate_home + __builtin_ctz(before_free)) & mask;
+                        hop(a, candidate_home, from, free_slot);
+                        distance -= (free_slot - from) & mask;
+                        free_slot = from;
+                        hopped = true;
+                    }
+                }
+                if (!hopped) {
+                    return false;
+                }
+            }
+
+            a->slots[free_slot].hash_value.store(e->hash_value, std::memory_order_relaxed);
+            a->slots[free_slot].entry.store(e, std::memory_order_release);
+            a->slots[home].hop_info.store(a->slots[home].hop_info.load(std::memory_order_relaxed) | (1u << distance),
+                                          std::memory_order_release);
+            return true;
+        }
+
+        // Doubles the slots of the segment. Requires the segment lock and an open write.
+        static void grow(hash_segment& segment) {
+            slot_array* a = segment.array.load(std::memory_order_relaxed);
+            slot_array* new_array = new slot_array(a->capacity * 2);
+            for (std::uint32_t i = 0; i < a->capacity; i++) {
+                bucket_entry* e = a->slots[i].entry.load(std::memory_order_relaxed);
+                if (e && !add(new_array, e)) {
+                    segment.overflow.push_back(e);
+                }
+            }
+            segment.overflow_size.store(segment.overflow.size());
+            segment.array.store(new_array, std::memory_order_release);
+            utils::epoch_manager::instance().retire(a);
+        }
+
+        bool get_locked(hash_segment& segment, hash_value_t hash_value, const std::string& key, std::string& value) {
+            boost::lock_guard<boost::mutex> segment_lock(segment.segment_mutex);
+            slot_array* a = segment.array.load(std::memory_order_relaxed);
+            std::uint32_t i = find(a, hash_value, key);
+            if (i != not_found) {
+                a->slots[i].entry.load()->read_value(value);
+                return true;
+            }
+            size_t o = find_in_overflow(segment, hash_value, key);
+            if (o < segment.overflow.size()) {
+                segment.overflow[o]->read_value(value);
+                return true;
+            }
+            return false;
+        }
+
+        template<typename cmp>
+        void scan_internal(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) {
+            std::priority_queue<hash_entry, std::vector<hash_entry>, cmp> pri_queue;
+
+            auto visit = [&](bucket_entry* e) {
+                std::string key = e->key();
+                if (key >= start_key && (!end_key || key <= *end_key)) {
+                    pri_queue.push(std::make_tuple(key, e->value()));
+                }
+            };
+            // FULL SCAN
+            for (hash_segment& segment : segments) {
+                boost::lock_guard<boost::mutex> segment_lock(segment.segment_mutex);
+                slot_array* a = segment.array.load(std::memory_order_relaxed);
+                for (std::uint32_t i = 0; i < a->capacity; i++) {
+                    bucket_entry* e = a->slots[i].entry.load(std::memory_order_relaxed);
+                    if (e) {
+                        visit(e);
+                    }
+                }
+                for (bucket_entry* e : segment.overflow) {
+                    visit(e);
+                }
+            }
+
+            // Apply push op
+            while(!pri_queue.empty()) {
+                hash_entry entry = pri_queue.top();
+                std::string key   = std::get<0>(entry);
+                std::string value = std::get<1>(entry);
+                const char* keyp = key.c_str();
+                if (!apo.invoke(keyp, key.size(), value)) {
+                    return;
+                }
+                pri_queue.pop();
+            }
+        }
+
+    public:
+        hopscotch_hash_table(abstract_hash<hash_value_t>& _hash) : hash(_hash) {}
+
+        bool get(const std::string& key, std::string& value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_segment& segment = segment_of(hash_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            for (std::uint32_t attempt = 1; ; attempt++) {
+                if (attempt % read_retries_before_yield == 0) {
+                    std::this_thread::yield(); // The writer may have been descheduled
+                }
+                std::uint64_t version = segment.version.load(std::memory_order_acquire);
+                if (version & 1) {
+                    continue; // Writer active
+                }
+                slot_array* a = segment.array.load(std::memory_order_acquire);
+                std::uint32_t i = find(a, hash_value, key);
+                bucket_entry* found = i == not_found ? nullptr : a->slots[i].entry.load(std::memory_order_acquire);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (segment.version.load(std::memory_order_relaxed) == version) {
+                    if (found) {
+                        found->read_value(value);
+                        return true;
+                    }
+                    if (segment.overflow_size.load(std::memory_order_relaxed) > 0) {
+                        return get_locked(segment, hash_value, key, value);
+                    }
+                    return false;
+                }
+            }
+        }
+
+        // Like the other hash tables, does not check whether the key is present
+        void insert(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_segment& segment = segment_of(hash_value);
+            bucket_entry* new_entry = bucket_entry::create(hash_value, key, new_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            boost::lock_guard<boost::mutex> segment_lock(segment.segment_mutex);
+            segment.begin_write();
+            if (!add(segment.array.load(std::memory_order_relaxed), new_entry)) {
+                slot_array* a = segment.array.load(std::memory_order_relaxed);
+                bool loaded = segment.entry_count.load(std::memory_order_relaxed) * 100 >= (size_t)a->capacity * min_grow_load_percent;
+                if (!loaded || (grow(segment), !add(segment.array.load(std::memory_order_relaxed), new_entry))) {
+                    // The keys collide rather than the segment being full
+                    segment.overflow.push_back(new_entry);
+                    segment.overflow_size.store(segment.overflow.size());
+                }
+            }
+            segment.entry_count.fetch_add(1, std::memory_order_relaxed);
+            segment.end_write();
+        }
+
+        void update(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_segment& segment = segment_of(hash_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            boost::lock_guard<boost::mutex> segment_lock(segment.segment_mutex);
+            slot_array* a = segment.array.load(std::memory_order_relaxed);
+            std::uint32_t i = find(a, hash_value, key);
+            if (i != not_found) {
+                // A single pointer store, readers see either entry
+                bucket_entry* old_entry = a->slots[i].entry.load(std::memory_order_relaxed);
+                a->slots[i].entry.store(bucket_entry::create(hash_value, key, new_value), std::memory_order_release);
+                utils::epoch_manager::instance().retire(old_entry);
+                return;
+            }
+            size_t o = find_in_overflow(segment, hash_value, key);
+            if (o < segment.overflow.size()) {
+                utils::epoch_manager::instance().retire(segment.overflow[o]);
+                segment.overflow[o] = bucket_entry::create(hash_value, key, new_value);
+            }
+        }
+
+        void remove(const std::string& key) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_segment& segment = segment_of(hash_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            boost::lock_guard<boost::mutex> segment_lock(segment.segment_mutex);
+            slot_array* a = segment.array.load(std::memory_order_relaxed);
+            std::uint32_t i = find(a, hash_value, key);
+            if (i != not_found) {
+                bucket_entry* old_entry = a->slots[i].entry.load(std::memory_order_relaxed);
+                std::uint32_t home = home_slot(a, hash_value);
+                segment.begin_write();
+                a->slots[home].hop_info.store(a->slots[home].hop_info.load(std::memory_order_relaxed) & ~(1u << ((i - home) & (a->capacity-1))),
+                                              std::memory_order_release);
+                a->slots[i].entry.store(nullptr, std::memory_order_release);
+                segment.entry_count.fetch_sub(1, std::memory_order_relaxed);
+                segment.end_write();
+                utils::epoch_manager::instance().retire(old_entry);
+                return;
+            }
+            size_t o = find_in_overflow(segment, hash_value, key);
+            if (o < segment.overflow.size()) {
+                utils::epoch_manager::instance().retire(segment.overflow[o]);
+                segment.overflow[o] = segment.overflow.back();
+                segment.overflow.pop_back();
+                segment.overflow_size.store(segment.overflow.size());
+                segment.entry_count.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<less_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<greater_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        size_t capacity() {
+            size_t total_capacity = 0;
+            for (hash_segment& segment : segments) {
+                boost::lock_guard<boost::mutex> segment_lock(segment.segment_mutex);
+                total_capacity += segment.array.load()->capacity;
+            }
+            return total_capacity;
+        }
+
+        size_t overflow_entries() {
+            size_t total_overflow = 0;
+            for (hash_segment& segment : segments) {
+                total_overflow += segment.overflow_size.load();
+            }
+            return total_overflow;
+        }
+
+        size_t size() {
+            size_t total_entry_count = 0;
+            for (hash_segment& segment : segments) {
+                total_entry_count += segment.entry_count.load();
+            }
+            return total_entry_count;
+        }
+
+        std::string to_string() override {
+            return "hopscotch_hash_table";
+        }
+    };
+
+    // Bound by reference in std::min, so it needs a definition
+    template<std::uint32_t initial_segment_capacity, std::uint32_t segment_count>
+    const std::uint32_t hopscotch_hash_table<initial_segment_capacity, segment_count>::max_add_range;
+}
+
+#endif
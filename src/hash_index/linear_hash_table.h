@@ -0,0 +1,451 @@
+#ifndef linear_hash_table_h
+#define linear_hash_table_h
+
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "../macros.h"
+
+#include "../abstract_index.h"
+#include "../push_ops.h"
+#include "../util/cache_aligned.h"
+#include "../util/epoch_manager.h"
+#include "bucket_entry.h"
+
+typedef std::uint32_t hash_value_t;
+
+namespace dbindex {
+    /**
+     * Hash table with linear hashing. The table grows one bucket at a time:
+     * whenever the load passes split_load_factor entries per bucket, the
+     * bucket under the split pointer is split into itself and one new bucket
+     * at the end of the table, and the split pointer moves on. With
+     * level l and split pointer p the table has
+     * n = initial_bucket_count << l buckets below p, a key goes to bucket
+     * hash mod n, or hash mod 2n if that lies below p. Once p reaches n the
+     * level increases and p starts over.
+     *
+     * Unlike in extendible_hash_table nothing ever doubles. Buckets are kept
+     * in segments of initial_bucket_count buckets, allocated when the split
+     * pointer reaches them, so both memory and the work of a single insert
+     * stay proportional to the data. Entries beyond a page of a bucket,
+     * which it can collect until its turn to split comes, go to overflow
+     * pages chained to it.
+     *
+     * get never takes a lock. It validates against the version of the
+     * bucket, odd while a writer modifies it, and against the bucket the
+     * key maps to, which changes when a split publishes a new level and
+     * split pointer. Writers lock the bucket, a split locks the bucket it
+     * splits, and a single split runs at a time.
+     */
+    template<std::uint32_t initial_bucket_count = 1024>
+    class linear_hash_table : public abstract_index {
+    private:
+        abstract_hash<hash_value_t>& hash;
+
+        static const std::uint32_t page_entries = 4;
+        static const std::uint32_t split_load_factor = 3; // Average entries per bucket before a split
+        static const std::uint32_t max_segments = 1<<16;
+        static const std::uint32_t read_retries_before_yield = 64;
+
+        static_assert(initial_bucket_count > 0 && (initial_bucket_count & (initial_bucket_count-1)) == 0,
+                      "initial bucket count must be a power of two");
+
+        // The first page is part of its bucket, the chained ones start on a cache line each
+        struct entry_page : public utils::cache_aligned {
+            std::atomic<hash_value_t>  hash_values[page_entries];
+            std::atomic<bucket_entry*> entries[page_entries];
+            std::atomic<entry_page*>   next;
+
+            entry_page() : next(nullptr) {
+                for (std::uint32_t e = 0; e < page_entries; e++) {
+                    hash_values[e] = 0;
+                    entries[e] = nullptr;
+                }
+            }
+        };
+
+        // Entries are kept dense, entry i is entry i % page_entries of page
+        // i / page_entries, counting the first page as 0. Overflow pages
+        // are retired through the epoch manager when a bucket shrinks.
+        // Each bucket of a segment starts on a cache line.
+        struct alignas(CACHE_LINE_SIZE) hash_bucket : public utils::cache_aligned {
+            std::atomic<std::uint64_t> version; // Odd while a writer modifies the bucket
+            std::atomic<std::uint32_t> entry_count;
+            entry_page first_page;
+            boost::mutex bucket_mutex;
+
+            hash_bucket() : version(0), entry_count(0) {}
+            ~hash_bucket() {
+                for (std::uint32_t i = 0; i < entry_count; i++) {
+                    delete entry(i);
+                }
+                entry_page* p = first_page.next.load();
+                while (p) {
+                    entry_page* next = p->next.load();
+                    delete p;
+                    p = next;
+                }
+            }
+
+            void begin_write() {
+                version.fetch_add(1, std::memory_order_acq_rel);
+            }
+            void end_write() {
+                version.fetch_add(1, std::memory_order_release);
+            }
+
+            entry_page* page(std::uint32_t index) {
+                entry_page* p = &first_page;
+                while (index-- && p) {
+                    p = p->next.load(std::memory_order_acquire);
+                }
+                return p;
+            }
+
+            // Null if a concurrent writer released the page of entry i
+            bucket_entry* entry(std::uint32_t i) {
+                entry_page* p = page(i / page_entries);
+                return p ? p->entries[i % page_entries].load(std::memory_order_acquire) : nullptr;
+            }
+
+            void set_entry(std::uint32_t i, hash_value_t hash_value, bucket_entry* new_entry) {
+                entry_page* p = page(i / page_entries);
+                p->hash_values[i % page_entries].store(hash_value, std::memory_order_relaxed);
+                p->entries[i % page_entries].store(new_entry, std::memory_order_release);
+            }
+
+            // Requires the bucket lock and an open write
+            void append(hash_value_t hash_value, bucket_entry* new_entry) {
+                std::uint32_t i = entry_count.load(std::memory_order_relaxed);
+                if (i > 0 && i % page_entries == 0) {
+                    entry_page* last = page(i / page_entries - 1);
+                    if (!last->next.load(std::memory_order_relaxed)) {
+                        last->next.store(new entry_page(), std::memory_order_release);
+                    }
+                }
+                set_entry(i, hash_value, new_entry);
+                entry_count.store(i + 1, std::memory_order_release);
+            }
+
+            // Requires the bucket lock and an open write
+            void move_last_to(std::uint32_t i) {
+                std::uint32_t last = entry_count.load(std::memory_order_relaxed) - 1;
+                entry_page* p = page(last / page_entries);
+                set_entry(i, p->hash_values[last % page_entries].load(std::memory_order_relaxed),
+                          p->entries[last % page_entries].load(std::memory_order_relaxed));
+                set_entry(last, 0, nullptr);
+                entry_count.store(last, std::memory_order_release);
+                release_unused_pages();
+            }
+
+            // Unlinks the overflow pages past the last entry
+            void release_unused_pages() {
+                std::uint32_t count = entry_count.load(std::memory_order_relaxed);
+                entry_page* last = page(count == 0 ? 0 : (count - 1) / page_entries);
+                entry_page* p = last->next.exchange(nullptr, std::memory_order_acq_rel);
+                while (p) {
+                    entry_page* next = p->next.load(std::memory_order_relaxed);
+                    utils::epoch_manager::instance().retire(p);
+                    p = next;
+                }
+            }
+        };
+
+        // Level in the upper half, split pointer in the lower half, so that
+        // both are read and published together.
+        std::atomic<std::uint64_t> split_state{0};
+
+        // calloc, a zeroed atomic pointer is a segment not yet allocated
+        std::atomic<hash_bucket*>* const segments;
+
+        std::atomic<size_t> entry_count{0};
+
+        // Held by the one thread splitting, and by scans, which must not
+        // see entries move past the buckets they visit.
+        boost::mutex split_mutex;
+
+        static std::uint64_t level_size(std::uint64_t state) {
+            return (std::uint64_t)initial_bucket_count << (state >> 32);
+        }
+        static std::uint64_t split_pointer(std::uint64_t state) {
+            return state & 0xFFFFFFFF;
+        }
+        static std::uint64_t bucket_count(std::uint64_t state) {
+            return level_size(state) + split_pointer(state);
+        }
+        static std::uint64_t bucket_number(hash_value_t hash_value, std::uint64_t state) {
+            std::uint64_t n = level_size(state);
+            std::uint64_t b = hash_value & (n-1);
+            if (b < split_pointer(state)) {
+                b = hash_value & (2*n-1);
+            }
+            return b;
+        }
+
+        hash_bucket* bucket_at(std::uint64_t b) {
+            return segments[b / initial_bucket_count].load(std::memory_order_acquire) + (b % initial_bucket_count);
+        }
+
+        // Locks the bucket of hash_value, retrying if it was split while
+        // waiting for its lock.
+        hash_bucket* lock_owning_bucket(hash_value_t hash_value, boost::unique_lock<boost::mutex>& bucket_lock) {
+            while (true) {
+                std::uint64_t b = bucket_number(hash_value, split_state.load(std::memory_order_acquire));
+                hash_bucket* bucket = bucket_at(b);
+                bucket_lock = boost::unique_lock<boost::mutex>(bucket->bucket_mutex);
+                if (bucket_number(hash_value, split_state.load(std::memory_order_acquire)) == b) {
+                    return bucket;
+                }
+                bucket_lock.unlock();
+            }
+        }
+
+        // Index of key in the bucket, entry_count if it is not present
+        static std::uint32_t find(hash_bucket* bucket, hash_value_t hash_value, const std::string& key) {
+            std::uint32_t count = bucket->entry_count.load(std::memory_order_acquire);
+            entry_page* p = &bucket->first_page;
+            for (std::uint32_t i = 0; i < count && p; i++) {
+                std::uint32_t e = i % page_entries;
+                if (p->hash_values[e].load(std::memory_order_relaxed) == hash_value) {
+                    bucket_entry* candidate = p->entries[e].load(std::memory_order_acquire);
+                    if (candidate && candidate->matches(hash_value, key)) {
+                        return i;
+                    }
+                }
+                if (e == page_entries - 1) {
+                    p = p->next.load(std::memory_order_acquire);
+                }
+            }
+            return count;
+        }
+
+        // Splits buckets under the split pointer until the load is below
+        // split_load_factor again. Returns at once if another thread splits.
+        void split_if_needed() {
+            boost::unique_lock<boost::mutex> split_lock(split_mutex, boost::try_to_lock);
+            if (!split_lock.owns_lock()) {
+                return;
+            }
+            std::uint64_t state = split_state.load(std::memory_order_relaxed);
+            while (entry_count.load(std::memory_order_relaxed) > split_load_factor * bucket_count(state) &&
+                   bucket_count(state) < (std::uint64_t)initial_bucket_count * max_segments &&
+                   level_size(state) < ((std::uint64_t)1 << (8 * sizeof(hash_value_t)))) {
+                split(state);
+                state = split_state.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Moves the entries of the bucket under the split pointer that
+        // belong to its image at the end of the table. Requires split_mutex.
+        void split(std::uint64_t state) {
+            std::uint64_t n = level_size(state);
+            std::uint64_t source_number = split_pointer(state);
+            std::uint64_t image_number = source_number + n;
+
+            std::uint64_t s = image_number / initial_bucket_count;
+            if (!segments[s].load(std::memory_order_relaxed)) {
+                segments[s].store(new hash_bucket[initial_bucket_count], std::memory_order_release);
+            }
+            // Unreachable until the new state is published
+            hash_bucket* image = bucket_at(image_number);
+
+            hash_bucket* source = bucket_at(source_number);
+            boost::lock_guard<boost::mutex> source_lock(source->bucket_mutex);
+            source->begin_write();
+            std::uint32_t count = source->entry_count.load(std::memory_order_relaxed);
+            std::uint32_t kept = 0;
+            entry_page* p = &source->first_page;
+            for (std::uint32_t i = 0; i < count; i++) {
+                hash_value_t hash_value = p->hash_values[i % page_entries].load(std::memory_order_relaxed);
+                bucket_entry* e = p->entries[i % page_entries].load(std::memory_order_relaxed);
+                if (hash_value & n) {
+                    image->append(hash_value, e);
+                } else {
+                    // kept <= i, so the slot was already read
+                    source->set_entry(kept++, hash_value, e);
+                }
+                if (i % page_entries == page_entries - 1) {
+                    p = p->next.load(std::memory_order_relaxed);
+                }
+            }
+            for (std::uint32_t i = kept; i < count; i++) {
+                source->set_entry(i, 0, nullptr);
+            }
+            source->entry_count.store(kept, std::memory_order_release);
+            source->release_unused_pages();
+
+            std::uint64_t new_state = source_number + 1 == n ? ((state >> 32) + 1) << 32 : state + 1;
+            split_state.store(new_state, std::memory_order_release);
+            source->end_write();
+        }
+
+        template<typename cmp>
+        void scan_internal(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) {
+            std::priority_queue<hash_entry, std::vector<hash_entry>, cmp> pri_queue;
+
+            // FULL SCAN
+            {
+                boost::lock_guard<boost::mutex> split_lock(split_mutex);
+                std::uint64_t buckets = bucket_count(split_state.load(std::memory_order_acquire));
+                for (std::uint64_t b = 0; b < buckets; b++) {
+                    hash_bucket* bucket = bucket_at(b);
+                    boost::lock_guard<boost::mutex> bucket_lock(bucket->bucket_mutex);
+                    std::uint32_t count = bucket->entry_count.load(std::memory_order_relaxed);
+                    for (std::uint32_t i = 0; i < count; i++) {
+                        bucket_entry* e = bucket->entry(i);
+                        std::string key = e->key();
+                        if (key >= start_key && (!end_key || key <= *end_key)) {
+                            pri_queue.push(std::make_tuple(key, e->value()));
+                        }
+                    }
+                }
+            }
+
+            // Apply push op
+            while(!pri_queue.empty()) {
+                hash_entry entry = pri_queue.top();
+                std::string key   = std::get<0>(entry);
+                std::string value = std::get<1>(entry);
+                const char* keyp = key.c_str();
+                if (!apo.invoke(keyp, key.size(), value)) {
+                    return;
+                }
+                pri_queue.pop();
+            }
+        }
+
+    public:
+        linear_hash_table(abstract_hash<hash_value_t>& _hash) : hash(_hash),
+                segments(static_cast<std::atomic<hash_bucket*>*>(std::calloc(max_segments, sizeof(std::atomic<hash_bucket*>)))) {
+            if (!segments)
+                throw std::bad_alloc();
+            segments[0].store(new hash_bucket[initial_bucket_count]);
+        }
+        ~linear_hash_table() {
+            for (std::uint32_t s = 0; s < max_segments; s++) {
+                delete[] segments[s].load();
+            }
+            std::free(segments);
+        }
+
+        bool get(const std::string& key, std::string& value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+
+            utils::epoch_manager::guard epoch_guard;
+            for (std::uint32_t attempt = 1; ; attempt++) {
+                if (attempt % read_retries_before_yield == 0) {
+                    std::this_thread::yield(); // The writer may have been descheduled
+                }
+                std::uint64_t b = bucket_number(hash_value, split_state.load(std::memory_order_acquire));
+                hash_bucket* bucket = bucket_at(b);
+                std::uint64_t version = bucket->version.load(std::memory_order_acquire);
+                if (version & 1) {
+                    continue; // Writer active
+                }
+                if (bucket_number(hash_value, split_state.load(std::memory_order_acquire)) != b) {
+                    continue; // Bucket split since the split state was read
+                }
+
+                std::uint32_t i = find(bucket, hash_value, key);
+                bucket_entry* found = i < bucket->entry_count.load(std::memory_order_relaxed) ? bucket->entry(i) : nullptr;
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (bucket->version.load(std::memory_order_relaxed) == version) {
+                    if (found) {
+                        found->read_value(value);
+                    }
+                    return found != nullptr;
+                }
+            }
+        }
+
+        // Like the other hash tables, does not check whether the key is present
+        void insert(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            bucket_entry* new_entry = bucket_entry::create(hash_value, key, new_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            {
+                boost::unique_lock<boost::mutex> bucket_lock;
+                hash_bucket* bucket = lock_owning_bucket(hash_value, bucket_lock);
+                bucket->begin_write();
+                bucket->append(hash_value, new_entry);
+                bucket->end_write();
+            }
+            std::uint64_t state = split_state.load(std::memory_order_relaxed);
+            if (entry_count.fetch_add(1, std::memory_order_relaxed) + 1 > split_load_factor * bucket_count(state)) {
+                split_if_needed();
+            }
+        }
+
+        void update(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+
+            utils::epoch_manager::guard epoch_guard;
+            boost::unique_lock<boost::mutex> bucket_lock;
+            hash_bucket* bucket = lock_owning_bucket(hash_value, bucket_lock);
+            std::uint32_t i = find(bucket, hash_value, key);
+            if (i < bucket->entry_count.load(std::memory_order_relaxed)) {
+                // A single pointer store, readers see either entry
+                std::atomic<bucket_entry*>& slot = bucket->page(i / page_entries)->entries[i % page_entries];
+                bucket_entry* old_entry = slot.load(std::memory_order_relaxed);
+                slot.store(bucket_entry::create(hash_value, key, new_value), std::memory_order_release);
+                utils::epoch_manager::instance().retire(old_entry);
+            }
+        }
+
+        void remove(const std::string& key) override {
+            hash_value_t hash_value = hash.get_hash(key);
+
+            utils::epoch_manager::guard epoch_guard;
+            boost::unique_lock<boost::mutex> bucket_lock;
+            hash_bucket* bucket = lock_owning_bucket(hash_value, bucket_lock);
+            std::uint32_t i = find(bucket, hash_value, key);
+            if (i < bucket->entry_count.load(std::memory_order_relaxed)) {
+                bucket_entry* old_entry = bucket->entry(i);
+                bucket->begin_write();
+                bucket->move_last_to(i);
+                bucket->end_write();
+                entry_count.fetch_sub(1, std::memory_order_relaxed);
+                utils::epoch_manager::instance().retire(old_entry);
+            }
+        }
+
+        void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<less_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<greater_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        size_t get_bucket_count() {
+            return bucket_count(split_state.load());
+        }
+        std::uint32_t get_level() {
+            return split_state.load() >> 32;
+        }
+        size_t get_split_pointer() {
+            return split_pointer(split_state.load());
+        }
+
+        size_t size() {
+            return entry_count.load();
+        }
+
+        std::string to_string() override {
+            return "linear_hash_table";
+        }
+    };
+}
+
+#endif
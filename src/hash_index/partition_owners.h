@@ -0,0 +1,403 @@
+#ifndef partition_owners_h
+#define partition_owners_h
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../util/epoch_manager.h"
+#include "../util/rw_spinlock.h"
+#include "../util/spsc_ring.h"
+#include "../util/thread_util.h"
+
+typedef std::uint32_t hash_value_t;
+
+namespace dbindex {
+	enum class delegated_op : std::uint8_t { get, insert, update, remove, scan };
+
+	/*
+	 * An operation on one partition. Keys, values and the result string are
+	 * the client's, which keeps them alive until the operation completed.
+	 */
+	struct delegated_request {
+		delegated_op op;
+		std::uint32_t partition;
+		hash_value_t hash_value;
+		std::uint64_t ticket;
+		const std::string* key;
+		const std::string* value;
+		std::string* result;
+		void* task;
+	};
+
+	// found is the result of a get, true for the other operations
+	struct delegated_completion {
+		std::uint64_t ticket;
+		bool found;
+	};
+
+	/**
+	 * Threads that each own a consecutive block of partitions and are the
+	 * only ones touching them, so the partitions need no locks. Clients talk
+	 * to the owners through sessions: a session has a single producer single
+	 * consumer ring of requests to every owner and one of completions back,
+	 * and an owner serves the rings of all sessions in batches.
+	 *
+	 * A session keeps at most ring_capacity operations outstanding per owner,
+	 * so the completions always fit and neither side ever waits on the
+	 * other. Owners find the ring pairs of the sessions in slots and read
+	 * them inside an epoch guard, a closed session's rings are retired to
+	 * the epoch_manager. The slots grow slots_per_chunk at a time, up to
+	 * max_sessions open at once. Opening a session beyond that waits until
+	 * another one is closed.
+	 *
+	 * Threads that use the index through abstract_index get a session of
+	 * their own, kept until the thread exits.
+	 */
+	class partition_owners {
+	public:
+		static constexpr std::uint32_t slots_per_chunk = 64;
+		static constexpr std::uint32_t max_slot_chunks = 64;
+		static constexpr std::uint32_t max_sessions  = slots_per_chunk * max_slot_chunks;
+		static constexpr std::uint32_t ring_capacity = 64;
+		static constexpr std::uint32_t batch_size    = 32;
+
+		typedef std::function<bool(const delegated_request&)> executor_type;
+
+		class session {
+		public:
+			explicit session(partition_owners& _owners) : owners(&_owners),
+				channel(new channels(_owners.owner_count())), outstanding(_owners.owner_count(), 0) {
+				slot = owners->claim_slot(channel);
+			}
+			session(const session&) = delete;
+			session& operator=(const session&) = delete;
+
+			~session() {
+				if (!owners)
+					return;
+				std::vector<delegated_completion> completed;
+				drain(completed);
+				owners->release_slot(slot, channel);
+			}
+
+			/*
+			 * Queues request and returns its ticket, ticket 0 for requests whose
+			 * completion is not wanted. Polls while the owner has ring_capacity
+			 * operations of this session outstanding, keeping what completed for
+			 * the next poll.
+			 */
+			std::uint64_t submit(delegated_request request, bool wants_completion = true) {
+				request.ticket = wants_completion ? next_ticket++ : 0;
+				std::uint32_t owner = owners->owner_of(request.partition);
+				utils::spin_wait backoff;
+				while (outstanding[owner] == ring_capacity) {
+					if (!receive(ready))
+						backoff.wait();
+				}
+				outstanding[owner]++;
+				channel->requests[owner].try_push(request);
+				return request.ticket;
+			}
+
+			// Appends the operations completed since the last poll, returns how many
+			size_t poll(std::vector<delegated_completion>& completed) {
+				size_t before = completed.size();
+				completed.insert(completed.end(), ready.begin(), ready.end());
+				ready.clear();
+				receive(completed);
+				return completed.size() - before;
+			}
+
+			// Waits until every submitted operation completed, appending them
+			void drain(std::vector<delegated_completion>& completed) {
+				poll(completed);
+				utils::spin_wait backoff;
+				while (pending() != 0) {
+					if (!receive(completed))
+						backoff.wait();
+				}
+			}
+
+			// Waits for the completion of ticket, keeping the others for the next poll
+			bool wait(std::uint64_t ticket) {
+				utils::spin_wait backoff;
+				for (;;) {
+					for (size_t i = 0; i < ready.size(); i++) {
+						if (ready[i].ticket == ticket) {
+							bool found = ready[i].found;
+							ready.erase(ready.begin() + i);
+							return found;
+						}
+					}
+					if (!receive(ready))
+						backoff.wait();
+				}
+			}
+
+			// For a session whose owners are gone and freed its rings with its slots, see thread_session
+			void detach() {
+				owners = nullptr;
+				channel = nullptr;
+			}
+
+		private:
+			struct channels {
+				explicit channels(std::uint32_t owner_count) :
+					requests(new utils::spsc_ring<delegated_request, ring_capacity>[owner_count]),
+					completions(new utils::spsc_ring<delegated_completion, ring_capacity>[owner_count]) {}
+				std::unique_ptr<utils::spsc_ring<delegated_request, ring_capacity>[]> requests;
+				std::unique_ptr<utils::spsc_ring<delegated_completion, ring_capacity>[]> completions;
+			};
+
+			partition_owners* owners;
+			channels* channel;
+			std::uint32_t slot;
+			std::uint64_t next_ticket = 1;
+			std::vector<std::uint32_t> outstanding;
+			std::vector<delegated_completion> ready;
+
+			std::uint32_t pending() const {
+				std::uint32_t total = 0;
+				for (std::uint32_t count : outstanding)
+					total += count;
+				return total;
+			}
+
+			// Takes the completions of all owners, appending the wanted ones
+			bool receive(std::vector<delegated_completion>& completed) {
+				bool received = false;
+				delegated_completion batch[batch_size];
+				for (std::uint32_t owner = 0; owner < outstanding.size(); owner++) {
+					if (outstanding[owner] == 0)
+						continue;
+					std::uint32_t count = channel->completions[owner].try_pop(batch, batch_size);
+					outstanding[owner] -= count;
+					for (std::uint32_t i = 0; i < count; i++) {
+						if (batch[i].ticket != 0)
+							completed.push_back(batch[i]);
+					}
+					received |= count != 0;
+				}
+				return received;
+			}
+
+			friend class partition_owners;
+		};
+
+		/*
+		 * Starts owner_count threads, owner o serving the partitions from
+		 * o*partition_count/owner_count on, each running on the node of its
+		 * first partition in partition_nodes. executor runs a request on an
+		 * owner thread.
+		 */
+		partition_owners(executor_type _executor, std::uint32_t _partition_count, std::uint32_t _owner_count,
+		                 const std::vector<std::uint32_t>& partition_nodes) :
+			executor(_executor), partition_count(_partition_count), owners_count(_owner_count), stopping(false) {
+			{
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				id = next_id()++;
+				live_ids().insert(id);
+			}
+			for (std::uint32_t c = 0; c < max_slot_chunks; c++)
+				slot_chunks[c].store(nullptr);
+			slot_chunks[0].store(new std::atomic<channels*>[slots_per_chunk]());
+			slot_chunk_count.store(1);
+			// Pinned before they are handed any request, so the partitions they fill get their memory from node
+			for (std::uint32_t o = 0; o < owners_count; o++) {
+				std::uint32_t node = partition_nodes[(std::uint64_t)o * partition_count / owners_count];
+				threads.emplace_back([this, o]() {
+					serve(o);
+				});
+				if (utils::stick_thread_to_node(threads.back().native_handle(), node) != 0) {
+					stop();
+					throw std::runtime_error("partition_owners: cannot run on node " + std::to_string(node));
+				}
+			}
+		}
+
+		// Sessions of other threads must be closed, those kept by thread_session are detached
+		~partition_owners() {
+			stop();
+			for (std::uint32_t c = 0; c < slot_chunk_count.load(); c++) {
+				for (std::uint32_t i = 0; i < slots_per_chunk; i++)
+					delete slot_chunks[c].load()[i].load();
+				delete[] slot_chunks[c].load();
+			}
+		}
+
+		std::uint32_t owner_count() const {
+			return owners_count;
+		}
+
+		std::uint32_t owner_of(std::uint32_t partition) const {
+			return (std::uint32_t)(((std::uint64_t)partition * owners_count + owners_count - 1) / partition_count);
+		}
+
+		// The session of the calling thread, for operations through abstract_index
+		session& thread_session() {
+			thread_sessions& local = local_sessions();
+			for (auto& entry : local.sessions) {
+				if (entry.first == id)
+					return *entry.second;
+			}
+			local.prune();
+			local.sessions.emplace_back(id, new session(*this));
+			return *local.sessions.back().second;
+		}
+
+	private:
+		typedef session::channels channels;
+
+		// A thread's sessions by the id of their owners, closed when the thread exits
+		struct thread_sessions {
+			std::vector<std::pair<std::uint64_t, session*>> sessions;
+
+			// Detaches and frees the sessions of owners that are gone
+			void prune() {
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				for (size_t i = 0; i < sessions.size(); ) {
+					if (live_ids().count(sessions[i].first)) {
+						i++;
+						continue;
+					}
+					sessions[i].second->detach();
+					delete sessions[i].second;
+					sessions.erase(sessions.begin() + i);
+				}
+			}
+
+			~thread_sessions() {
+				// Holding the registry lock keeps live owners from being destroyed meanwhile
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				for (auto& entry : sessions) {
+					if (!live_ids().count(entry.first))
+						entry.second->detach();
+					delete entry.second;
+				}
+			}
+		};
+
+		executor_type executor;
+		const std::uint32_t partition_count;
+		const std::uint32_t owners_count;
+		std::uint64_t id;
+		std::atomic<bool> stopping;
+		// Chunks of slots_per_chunk slots, the first slot_chunk_count of them allocated
+		std::atomic<std::atomic<channels*>*> slot_chunks[max_slot_chunks];
+		std::atomic<std::uint32_t> slot_chunk_count;
+		// Taken only to add a chunk
+		std::mutex slot_growth_mutex;
+		std::vector<std::thread> threads;
+
+		static std::mutex& registry_mutex() {
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		static std::set<std::uint64_t>& live_ids() {
+			static std::set<std::uint64_t> ids;
+			return ids;
+		}
+
+		static std::uint64_t& next_id() {
+			static std::uint64_t id = 0;
+			return id;
+		}
+
+		static thread_sessions& local_sessions() {
+			// Registered first, so that the epoch slot outlives the sessions, which retire their rings on thread exit
+			utils::epoch_manager::instance().register_thread();
+			static thread_local thread_sessions sessions;
+			return sessions;
+		}
+
+		void stop() {
+			{
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				live_ids().erase(id);
+			}
+			stopping.store(true);
+			for (auto& thread : threads)
+				thread.join();
+		}
+
+		std::atomic<channels*>& slot(std::uint32_t i) {
+			return slot_chunks[i / slots_per_chunk].load(std::memory_order_acquire)[i % slots_per_chunk];
+		}
+
+		// A free slot for channel, adding a chunk when all are taken or waiting once there are max_sessions
+		std::uint32_t claim_slot(channels* channel) {
+			utils::spin_wait backoff;
+			for (;;) {
+				std::uint32_t chunk_count = slot_chunk_count.load(std::memory_order_acquire);
+				for (std::uint32_t i = 0; i < chunk_count * slots_per_chunk; i++) {
+					channels* expected = nullptr;
+					if (slot(i).compare_exchange_strong(expected, channel))
+						return i;
+				}
+				if (chunk_count == max_slot_chunks) {
+					backoff.wait();
+					continue;
+				}
+				std::lock_guard<std::mutex> lock(slot_growth_mutex);
+				if (slot_chunk_count.load() != chunk_count)
+					continue;
+				std::atomic<channels*>* chunk = new std::atomic<channels*>[slots_per_chunk]();
+				chunk[0].store(channel);
+				slot_chunks[chunk_count].store(chunk, std::memory_order_release);
+				slot_chunk_count.store(chunk_count + 1, std::memory_order_release);
+				return chunk_count * slots_per_chunk;
+			}
+		}
+
+		// Owners may still look at the rings, they are freed once they left their guard
+		void release_slot(std::uint32_t slot_index, channels* channel) {
+			slot(slot_index).store(nullptr);
+			utils::epoch_manager::instance().retire(channel);
+		}
+
+		void serve(std::uint32_t owner) {
+			delegated_request requests[batch_size];
+			delegated_completion completions[batch_size];
+			utils::epoch_manager::thread_registration registration;
+			utils::spin_wait backoff;
+			while (!stopping.load(std::memory_order_relaxed)) {
+				bool served = false;
+				{
+					utils::epoch_manager::guard epoch_guard;
+					std::uint32_t slot_count = slot_chunk_count.load(std::memory_order_acquire) * slots_per_chunk;
+					for (std::uint32_t i = 0; i < slot_count; i++) {
+						channels* channel = slot(i).load(std::memory_order_acquire);
+						if (!channel)
+							continue;
+						std::uint32_t count = channel->requests[owner].try_pop(requests, batch_size);
+						if (count == 0)
+							continue;
+						for (std::uint32_t r = 0; r < count; r++) {
+							completions[r].ticket = requests[r].ticket;
+							completions[r].found  = executor(requests[r]);
+						}
+						// Never full, a session has no more outstanding than fit
+						channel->completions[owner].try_push(completions, count);
+						served = true;
+					}
+				}
+				if (served)
+					backoff = utils::spin_wait();
+				else
+					backoff.wait();
+			}
+		}
+	};
+}
+
+#endif
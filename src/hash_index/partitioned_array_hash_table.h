@@ -1,32 +1,383 @@
 #ifndef partitioned_array_hash_table_h
 #define partitioned_array_hash_table_h
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <functional>
+#include <memory>
 #include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <boost/thread.hpp>
 
 #include "../macros.h"
+#include "../util/cache_aligned.h"
+#include "../util/null_lock.h"
+#include "../util/numa_topology.h"
+#include "../util/rw_spinlock.h"
+#include "../util/thread_util.h"
+#include "../util/worker_pool.h"
 
 #include "../abstract_index.h"
 #include "../push_ops.h"
+#include "partition_owners.h"
 
 typedef std::uint32_t hash_value_t;
 
 namespace dbindex {
-	template<std::uint8_t prefix_bits, std::uint32_t directory_size>
-	class partitioned_array_hash_table : public abstract_index {
+	/**
+	 * Partitions are spread over the NUMA nodes with cores in consecutive
+	 * blocks, the same way utils::core_for_thread fills the nodes with
+	 * threads, and each is created by a thread running on its home node,
+	 * so that its initial directory and locks are first touched, and
+	 * placed, there. Only delegated execution keeps the rest of a
+	 * partition's data local: its buckets and entries are allocated by the
+	 * thread that inserts them, which with shared execution is any client
+	 * on any node, while the owners run on the home node.
+	 *
+	 * With count_caller_nodes every point operation counts whether the
+	 * thread running it was on the home node of its partition at the time,
+	 * the calling thread with shared execution and the owner with
+	 * delegated execution, at the cost of a sched_getcpu and a shared
+	 * counter per operation, each partition's counters on their own cache
+	 * line. That is where the work ran, not where the memory it touched
+	 * lives.
+	 *
+	 * key_prefix routing takes the partition from the first prefix_bits of
+	 * the key and stores the rest of it, which keeps the partitions in key
+	 * order but piles keys with a common prefix into one partition. hash
+	 * routing takes the partition from the high bits of the key's hash,
+	 * multiplied by the 32 bit golden ratio first so that hashes that only
+	 * vary in their low bits, like mod_hash of short keys, are spread too.
+	 * The partitions then store the whole key and use the same hash value,
+	 * and scans visit all partitions.
+	 *
+	 * shared execution lets every thread operate on every partition under
+	 * its bucket locks. delegated execution hands each partition to one
+	 * owner thread of a partition_owners, which runs all operations on it,
+	 * so the partitions have no locks at all. Operations through
+	 * abstract_index then wait for their completion, the delegation_session
+	 * overloads queue them and return a ticket to collect in batches.
+	 */
+	enum class partition_routing { key_prefix, hash };
+	enum class partition_execution { shared, delegated };
+
+	template<std::uint8_t prefix_bits, std::uint32_t directory_size,
+	         partition_routing routing = partition_routing::key_prefix, bool count_caller_nodes = false,
+	         partition_execution execution = partition_execution::shared>
+	class partitioned_array_hash_table : public abstract_index, public utils::cache_aligned {
+	public:
+		typedef partition_owners::session delegation_session;
 	private:
 		static constexpr std::uint32_t hash_table_amount = 1<<prefix_bits;
+		static constexpr bool delegated = execution == partition_execution::delegated;
+
+		typedef array_hash_table<typename std::conditional<delegated, utils::null_lock, utils::rw_spinlock>::type> partition_type;
+
+		struct alignas(CACHE_LINE_SIZE) caller_node_counter {
+			std::atomic<std::uint64_t> home_node{0};
+			std::atomic<std::uint64_t> other_node{0};
+		};
+
+		abstract_hash<hash_value_t>& hash;
+		std::vector<partition_type> hash_tables;
+		std::vector<std::uint32_t> partition_nodes;
+		caller_node_counter access_counters[hash_table_amount];
+
+		void count_access(std::uint32_t partition) {
+			if (!count_caller_nodes)
+				return;
+			if (utils::numa_topology::instance().current_node() == partition_nodes[partition])
+				access_counters[partition].home_node.fetch_add(1, std::memory_order_relaxed);
+			else
+				access_counters[partition].other_node.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		static std::uint32_t hash_partition(hash_value_t hash_value) {
+			return prefix_bits == 0 ? 0 : (std::uint32_t)(hash_value * 2654435769u) >> ((32 - prefix_bits) & 31);
+		}
+
+		// Reused by the point operations of a thread, so routing does not allocate a suffix per operation
+		static std::string& suffix_buffer() {
+			static thread_local std::string suffix_key;
+			return suffix_key;
+		}
+
+		struct scan_job;
+
+		// The sorted run of one partition for a scan
+		struct scan_task {
+			scan_job* job;
+			std::uint32_t partition;
+			const std::string* start_key;
+			const std::string* end_key;
+			std::vector<hash_entry> run;
+			std::atomic<bool> done{false};
+		};
+
+		// Tasks in the order their runs are pushed, taken by the scanning thread and scan_workers alike
+		struct scan_job {
+			explicit scan_job(std::uint32_t task_count, bool _reverse) : tasks(task_count), reverse(_reverse) {}
+			std::vector<scan_task> tasks;
+			std::atomic<std::uint32_t> next{0};
+			std::atomic<bool> cancelled{false};
+			const bool reverse;
+		};
+
+		utils::worker_pool scan_workers;
+
+		static std::uint32_t default_scan_workers() {
+			return std::min((std::uint32_t)hash_table_amount, std::max(1u, std::thread::hardware_concurrency())) - 1;
+		}
+
+		// Declared after the partitions, so that the owners have stopped before they are destroyed
+		std::unique_ptr<partition_owners> owners;
+
+		static std::uint32_t default_owner_count() {
+			return std::min((std::uint32_t)hash_table_amount, std::max(1u, std::thread::hardware_concurrency()));
+		}
+
+		void run_task(scan_task& task) {
+			if (!task.job->cancelled.load(std::memory_order_relaxed)) {
+				if (task.job->reverse)
+					hash_tables[task.partition].template sorted_run<greater_than_hash_entry>(*task.start_key, task.end_key, task.run);
+				else
+					hash_tables[task.partition].template sorted_run<less_than_hash_entry>(*task.start_key, task.end_key, task.run);
+			}
+			task.done.store(true, std::memory_order_release);
+		}
 
-		std::vector< array_hash_table<directory_size> > hash_tables;
+		// Takes and runs the next task of job, false once all are taken
+		bool work_on(scan_job& job) {
+			std::uint32_t i = job.next.fetch_add(1);
+			if (i >= job.tasks.size())
+				return false;
+			run_task(job.tasks[i]);
+			return true;
+		}
+
+		// The partition of key for key_prefix routing, the prefix that split_prefix_key takes off
+		static std::uint32_t prefix_partition(const std::string& key) {
+			assert(prefix_bits < key.size()*8);
+			auto ukey = reinterpret_cast<const std::uint8_t*>(key.data());
+			const std::uint8_t head_blocks = prefix_bits/8;
+			const std::uint8_t tail_bits = prefix_bits%8;
+			std::uint32_t prefix_result = 0;
+			for (std::uint8_t i = 0; i < head_blocks; i++)
+				prefix_result = (prefix_result << 8) | ukey[i];
+			if (tail_bits != 0)
+				prefix_result = (prefix_result << tail_bits) | (ukey[head_blocks] >> (8-tail_bits));
+			return prefix_result;
+		}
+
+		// The partition of key, with the hash value that picked it for hash routing. The owner splits the key.
+		delegated_request route(delegated_op op, const std::string& key) {
+			delegated_request request{};
+			request.op = op;
+			request.key = &key;
+			if (routing == partition_routing::hash) {
+				request.hash_value = hash.get_hash(key);
+				request.partition = hash_partition(request.hash_value);
+			} else {
+				request.partition = prefix_partition(key);
+			}
+			return request;
+		}
+
+		// Runs a delegated request, on the owner thread of its partition
+		bool execute(const delegated_request& request) {
+			partition_type& table = hash_tables[request.partition];
+			if (request.op == delegated_op::scan) {
+				run_task(*static_cast<scan_task*>(request.task));
+				return true;
+			}
+			count_access(request.partition);
+			if (routing == partition_routing::hash) {
+				switch (request.op) {
+				case delegated_op::get:    return table.get(*request.key, request.hash_value, *request.result);
+				case delegated_op::insert: table.insert(*request.key, request.hash_value, *request.value); break;
+				case delegated_op::update: table.update(*request.key, request.hash_value, *request.value); break;
+				default:                   table.remove(*request.key, request.hash_value); break;
+				}
+				return true;
+			}
+			std::uint32_t prefix_result;
+			std::string& suffix_key = suffix_buffer();
+			split_prefix_key(*request.key, prefix_result, suffix_key);
+			switch (request.op) {
+			case delegated_op::get:    return table.get(suffix_key, *request.result);
+			case delegated_op::insert: table.insert(suffix_key, *request.value); break;
+			case delegated_op::update: table.update(suffix_key, *request.value); break;
+			default:                   table.remove(suffix_key); break;
+			}
+			return true;
+		}
+
+		// Runs request on its owner and waits for it, for the operations through abstract_index
+		bool delegate(const delegated_request& request) {
+			delegation_session& session = owners->thread_session();
+			return session.wait(session.submit(request));
+		}
+
+		// Helps with the other tasks until the run of task is complete
+		void wait_for(scan_job& job, scan_task& task) {
+			utils::spin_wait backoff;
+			while (!task.done.load(std::memory_order_acquire)) {
+				if (!work_on(job))
+					backoff.wait();
+			}
+		}
+
+		// Skips the tasks nobody took yet and waits for the running ones, which use the scanning thread's keys
+		void finish(scan_job& job) {
+			job.cancelled.store(true, std::memory_order_relaxed);
+			while (work_on(job)) {}
+			for (scan_task& task : job.tasks)
+				wait_for(job, task);
+		}
+
+		// The original key of a suffix stored in partition, the inverse of split_prefix_key
+		static void join_prefix_key(std::uint32_t partition, const std::string& suffix_key, std::string& key) {
+			const std::uint8_t head_blocks = prefix_bits/8;
+			const std::uint8_t tail_bits = prefix_bits%8;
+			key.clear();
+			for (std::uint8_t i = 0; i < head_blocks; i++)
+				key.push_back((char)((partition >> (tail_bits + 8*(head_blocks-1-i))) & 0xFF));
+			key.append(suffix_key);
+			if (tail_bits != 0 && key.size() > head_blocks)
+				key[head_blocks] |= (char)((partition & ((1<<tail_bits)-1)) << (8-tail_bits));
+		}
+
+		/*
+		 * Every partition that can hold keys of the range produces a sorted
+		 * run, in parallel on the scanning thread and the scan_workers. With
+		 * key_prefix routing the partitions cover consecutive key ranges, so
+		 * the runs are pushed one after another as soon as each is complete.
+		 * With hash routing any partition can hold any key and the runs are
+		 * merged k-way. Once apo returns false, partitions not started yet are
+		 * not scanned at all.
+		 */
+		template<typename cmp>
+		void scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo, bool reverse) {
+			std::uint32_t first_partition = 0;
+			std::uint32_t last_partition = hash_table_amount-1;
+			std::string start_suffix_key;
+			std::string end_suffix_key;
+			if (routing == partition_routing::key_prefix) {
+				if (start_key != "")
+					split_prefix_key(start_key, first_partition, start_suffix_key);
+				if (end_key)
+					split_prefix_key(*end_key, last_partition, end_suffix_key);
+			}
+
+			const std::string empty_key = "";
+			std::uint32_t task_count = last_partition - first_partition + 1;
+			std::shared_ptr<scan_job> job = std::make_shared<scan_job>(task_count, reverse);
+			for (std::uint32_t i = 0; i < task_count; i++) {
+				scan_task& task = job->tasks[reverse ? task_count-1-i : i];
+				task.job = job.get();
+				task.partition = first_partition + i;
+				if (routing == partition_routing::hash) {
+					task.start_key = &start_key;
+					task.end_key = end_key;
+				} else {
+					task.start_key = task.partition == first_partition ? &start_suffix_key : &empty_key;
+					task.end_key = task.partition == last_partition && end_key ? &end_suffix_key : nullptr;
+				}
+			}
+			if (delegated) {
+				// Only the owners may touch the partitions, none of the tasks is up for taking
+				job->next.store(task_count);
+				delegation_session& session = owners->thread_session();
+				for (scan_task& task : job->tasks) {
+					delegated_request request{};
+					request.op = delegated_op::scan;
+					request.partition = task.partition;
+					request.task = &task;
+					session.submit(request, false);
+				}
+			}
+			std::uint32_t helpers = std::min(scan_workers.size(), task_count-1);
+			for (std::uint32_t i = 0; i < helpers; i++) {
+				scan_workers.submit([this, job]() {
+					while (work_on(*job)) {}
+				});
+			}
+
+			if (routing == partition_routing::key_prefix) {
+				std::string key;
+				for (scan_task& task : job->tasks) {
+					wait_for(*job, task);
+					for (const hash_entry& entry : task.run) {
+						join_prefix_key(task.partition, std::get<0>(entry), key);
+						if (!apo.invoke(key.c_str(), key.size(), std::get<1>(entry))) {
+							finish(*job);
+							return;
+						}
+					}
+				}
+			} else {
+				for (scan_task& task : job->tasks)
+					wait_for(*job, task);
+				// Heap of the runs by their next entry, cmp ranks the entry to push next on top
+				std::vector<size_t> positions(task_count, 0);
+				auto later = [&](std::uint32_t lhs, std::uint32_t rhs) {
+					return cmp()(job->tasks[lhs].run[positions[lhs]], job->tasks[rhs].run[positions[rhs]]);
+				};
+				std::priority_queue<std::uint32_t, std::vector<std::uint32_t>, decltype(later)> runs(later);
+				for (std::uint32_t i = 0; i < task_count; i++) {
+					if (!job->tasks[i].run.empty())
+						runs.push(i);
+				}
+				while (!runs.empty()) {
+					std::uint32_t i = runs.top();
+					runs.pop();
+					const hash_entry& entry = job->tasks[i].run[positions[i]];
+					if (!apo.invoke(std::get<0>(entry).c_str(), std::get<0>(entry).size(), std::get<1>(entry)))
+						break;
+					if (++positions[i] < job->tasks[i].run.size())
+						runs.push(i);
+				}
+			}
+			finish(*job);
+		}
 	public:
-		partitioned_array_hash_table(abstract_hash<hash_value_t>& _hash){
+		/*
+		 * scan_worker_count threads help the scanning thread, by default one
+		 * less than partitions or cores. With delegated execution owner_count
+		 * threads own the partitions, by default one per partition or core,
+		 * and there are no scan workers.
+		 */
+		partitioned_array_hash_table(abstract_hash<hash_value_t>& _hash, std::uint32_t scan_worker_count = default_scan_workers(),
+		                             std::uint32_t owner_count = default_owner_count()) : hash(_hash),
+			scan_workers(delegated ? 0 : scan_worker_count) {
 			static_assert(prefix_bits <= sizeof(std::uint32_t)*8, "Cannot have that many prefix_bits!");
+			const std::vector<std::uint32_t>& nodes = utils::numa_topology::instance().cpu_nodes();
 			hash_tables.reserve(hash_table_amount);
 			for (std::uint32_t i = 0; i < hash_table_amount; i++) {
-				hash_tables.emplace_back(_hash);
+				std::uint32_t node = nodes[(std::uint64_t)i * nodes.size() / hash_table_amount];
+				partition_nodes.push_back(node);
+				if (nodes.size() == 1) {
+					hash_tables.emplace_back(_hash, directory_size);
+					continue;
+				}
+				int pinned = 0;
+				std::thread allocator([&]() {
+					pinned = utils::stick_thread_to_node(pthread_self(), node);
+					if (pinned == 0)
+						hash_tables.emplace_back(_hash, directory_size);
+				});
+				allocator.join();
+				if (pinned != 0)
+					throw std::runtime_error("partitioned_array_hash_table: cannot run on node " + std::to_string(node));
+			}
+			if (delegated) {
+				owners.reset(new partition_owners([this](const delegated_request& request) { return execute(request); },
+				                                  hash_table_amount, std::min(owner_count, (std::uint32_t)hash_table_amount), partition_nodes));
 			}
 		}
 			
@@ -77,8 +428,8 @@ namespace dbindex {
            		prefix_result >>= 8-tail_bits;
             	// std::cout << "post-tail prefix: " << prefix_result << std::endl; 
             }
-           	// Remainder of string.
-           	suffix_key = key.substr(head_blocks);
+           	// Remainder of string, assigned in place to reuse the capacity of suffix_key
+           	suffix_key.assign(key, head_blocks, std::string::npos);
            	suffix_key[0] = (char)(blocks[0] & create_bit_mask(7-tail_bits));
 		}
 
@@ -92,218 +443,186 @@ namespace dbindex {
 		}
 
 		bool get(const std::string& key, std::string& value) override {
+			if (delegated) {
+				delegated_request request = route(delegated_op::get, key);
+				request.result = &value;
+				return delegate(request);
+			}
+			if (routing == partition_routing::hash) {
+				hash_value_t hash_value = hash.get_hash(key);
+				std::uint32_t partition = hash_partition(hash_value);
+				count_access(partition);
+				return hash_tables[partition].get(key, hash_value, value);
+			}
 			std::uint32_t prefix_result;
-			std::string suffix_key;
-				
+			std::string& suffix_key = suffix_buffer();
 			split_prefix_key(key, prefix_result, suffix_key);
+			count_access(prefix_result);
 			return hash_tables[prefix_result].get(suffix_key, value);
 		}
 
 		void insert(const std::string& key, const std::string& new_value) override {
+			if (delegated) {
+				delegated_request request = route(delegated_op::insert, key);
+				request.value = &new_value;
+				delegate(request);
+				return;
+			}
+			if (routing == partition_routing::hash) {
+				hash_value_t hash_value = hash.get_hash(key);
+				std::uint32_t partition = hash_partition(hash_value);
+				count_access(partition);
+				hash_tables[partition].insert(key, hash_value, new_value);
+				return;
+			}
 			std::uint32_t prefix_result;
-			std::string suffix_key;
+			std::string& suffix_key = suffix_buffer();
 			split_prefix_key(key, prefix_result, suffix_key);
-			// std::cout << "Key: " << key << ", first char: " << key[0] << ", int of first char: " << (int)key[0] << ", prefix: " << prefix_result << ", suffix_key: " << suffix_key << std::endl;
+			count_access(prefix_result);
 			hash_tables[prefix_result].insert(suffix_key, new_value);
 		}
 
 		void update(const std::string& key, const std::string& new_value) override {
+			if (delegated) {
+				delegated_request request = route(delegated_op::update, key);
+				request.value = &new_value;
+				delegate(request);
+				return;
+			}
+			if (routing == partition_routing::hash) {
+				hash_value_t hash_value = hash.get_hash(key);
+				std::uint32_t partition = hash_partition(hash_value);
+				count_access(partition);
+				hash_tables[partition].update(key, hash_value, new_value);
+				return;
+			}
 			std::uint32_t prefix_result;
-			std::string suffix_key;
+			std::string& suffix_key = suffix_buffer();
 			split_prefix_key(key, prefix_result, suffix_key);
+			count_access(prefix_result);
 			hash_tables[prefix_result].update(suffix_key, new_value);
 		}
 
 		void remove(const std::string& key) override {
+			if (delegated) {
+				delegated_request request = route(delegated_op::remove, key);
+				delegate(request);
+				return;
+			}
+			if (routing == partition_routing::hash) {
+				hash_value_t hash_value = hash.get_hash(key);
+				std::uint32_t partition = hash_partition(hash_value);
+				count_access(partition);
+				hash_tables[partition].remove(key, hash_value);
+				return;
+			}
 			std::uint32_t prefix_result;
-			std::string suffix_key;
+			std::string& suffix_key = suffix_buffer();
 			split_prefix_key(key, prefix_result, suffix_key);
+			count_access(prefix_result);
 			hash_tables[prefix_result].remove(suffix_key);
 		}
 
 		void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override{
 			if (end_key) assert(*end_key > start_key);
-			
-			// std::cout << "1" << std::endl;
-
-			std::uint32_t start_prefix_result;
-			std::string start_suffix_key;
-			// std::cout << "2" << std::endl;
-			if (start_key == "") {
-				start_prefix_result = 0;
-				start_suffix_key = "";
-			} else {
-				split_prefix_key(start_key, start_prefix_result, start_suffix_key);
-			}
-			// std::cout << "3" << std::endl;
-			partitioned_push_op<less_than_hash_entry> po{generate_key_prefix(start_prefix_result)};
-			// std::cout << "start_prefix_result: " << start_prefix_result << std::endl;
-			// std::cout << "startkey: " << start_key << std::endl;
-			// std::cout << "start_prefix_result: " << start_prefix_result << std::endl;
-			// std::cout << "start_suffix_key: " << start_suffix_key << std::endl;
-			// std::cout << "4" << std::endl;
-			if (end_key) { // Closed-end scan
-				// std::cout << "411" << std::endl;
-				std::uint32_t end_prefix_result;
-				std::string end_suffix_key;
-				split_prefix_key(*end_key, end_prefix_result, end_suffix_key);
-				// std::cout << "412" << std::endl;
-
-				const std::string* end_suffix_keyp = &end_suffix_key;
-
-				if (start_prefix_result == end_prefix_result) { // Only one partition
-					// std::cout << "Only bucket: " << start_prefix_result << std::endl;
-					// std::cout << "4131" << std::endl;
-					hash_tables[start_prefix_result].range_scan(start_suffix_key, end_suffix_keyp, po);
-					// std::cout << "4132" << std::endl;
-				} else { // Multiple partitions
-					// std::cout << "4141" << std::endl;
-					// std::cout << "spr: " << start_prefix_result << ", hta: " << hash_table_amount << std::endl;
-					hash_tables[start_prefix_result].range_scan(start_suffix_key, NULL, po);
-					// std::cout << "First bucket: " << start_prefix_result << ", then buckets: ";
-					// std::cout << "4142" << std::endl;
-					for (std::uint32_t i = start_prefix_result+1; i < end_prefix_result; i++) {
-						// std::cout << i << ", ";
-						po.set_prefix(generate_key_prefix(i));
-						hash_tables[i].range_scan("", NULL, po);
-					}
-					// std::cout << "\nFinally bucket: " << end_prefix_result << std::endl;
-					// std::cout << "4143" << std::endl;
-					po.set_prefix(generate_key_prefix(end_prefix_result));
-					hash_tables[end_prefix_result].range_scan("", end_suffix_keyp, po);
-					// std::cout << "4144" << std::endl;
-				}
-			} else { // Open-ended scan
-				// std::cout << "421" << std::endl;
-				// std::cout << "First bucket: " << start_prefix_result << ", then buckets: ";
-				hash_tables[start_prefix_result].range_scan(start_suffix_key, NULL, po);
-				// std::cout << "422" << std::endl;
-				for (std::uint32_t i = start_prefix_result+1; i < hash_table_amount; i++) {
-					// std::cout << i << ", ";
-					po.set_prefix(generate_key_prefix(i));
-					hash_tables[i].range_scan("", NULL, po);
-				}
-				// std::cout << "424" << std::endl;
-			}
-
-			// std::cout << "5" << std::endl;
-			// push results
-			auto queue = po.get();
-			// std::cout << "6" << std::endl;
-
-			while (!queue.empty())
-			{
-				hash_entry entry = queue.top();
-				std::string key   = std::get<0>(entry);
-				std::string value = std::get<1>(entry);
-				// std::cout << "Value: " << value << std::endl;
-				// std::cout << "8" << std::endl;
-				const char* keyp = key.c_str();
-				if (!apo.invoke(keyp, key.size(), value)) {
-					return;
-				}
-				// std::cout << "9" << std::endl;
-				queue.pop();
-			}
-			// std::cout << "10" << std::endl;
+			scan<less_than_hash_entry>(start_key, end_key, apo, false);
 		}
 
 		void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override{
 			if (end_key) assert(*end_key > start_key);
+			scan<greater_than_hash_entry>(start_key, end_key, apo, true);
+		}
+
+		/*
+		 * The batch interface of delegated execution: queues the operation on
+		 * session and returns its ticket, to find among the completions of the
+		 * session's poll or drain. key, value and the result must stay alive
+		 * until then.
+		 */
+		std::uint64_t get(delegation_session& session, const std::string& key, std::string& value) {
+			delegated_request request = route(delegated_op::get, key);
+			request.result = &value;
+			return session.submit(request);
+		}
 
-			// std::cout << "1" << std::endl;
+		std::uint64_t insert(delegation_session& session, const std::string& key, const std::string& new_value) {
+			delegated_request request = route(delegated_op::insert, key);
+			request.value = &new_value;
+			return session.submit(request);
+		}
 
-			std::uint32_t start_prefix_result;
-			std::string start_suffix_key;
-			// std::cout << "2" << std::endl;
-			split_prefix_key(start_key, start_prefix_result, start_suffix_key);
-			// std::cout << "3" << std::endl;
-			partitioned_push_op<greater_than_hash_entry> po{generate_key_prefix(start_prefix_result)};
-			// std::cout << "start_prefix_result: " << start_prefix_result << std::endl;
-			// std::cout << "startkey: " << start_key << std::endl;
-			// std::cout << "start_prefix_result: " << start_prefix_result << std::endl;
-			// std::cout << "start_suffix_key: " << start_suffix_key << std::endl;
-			// std::cout << "4" << std::endl;
-			if (end_key) { // Closed-end scan
-				// std::cout << "411" << std::endl;
-				std::uint32_t end_prefix_result;
-				std::string end_suffix_key;
-				split_prefix_key(*end_key, end_prefix_result, end_suffix_key);
-				// std::cout << "412" << std::endl;
-
-				const std::string* end_suffix_keyp = &end_suffix_key;
-
-				if (start_prefix_result == end_prefix_result) { // Only one partition
-					// std::cout << "Only bucket: " << start_prefix_result << std::endl;
-					// std::cout << "4131" << std::endl;
-					hash_tables[start_prefix_result].reverse_range_scan(start_suffix_key, end_suffix_keyp, po);
-					// std::cout << "4132" << std::endl;
-				} else { // Multiple partitions
-					// std::cout << "4141" << std::endl;
-					// std::cout << "spr: " << start_prefix_result << ", hta: " << hash_table_amount << std::endl;
-					hash_tables[start_prefix_result].reverse_range_scan(start_suffix_key, NULL, po);
-					// std::cout << "First bucket: " << start_prefix_result << ", then buckets: ";
-					// std::cout << "4142" << std::endl;
-					for (std::uint32_t i = start_prefix_result+1; i < end_prefix_result; i++) {
-						// std::cout << i << ", ";
-						po.set_prefix(generate_key_prefix(i));
-						hash_tables[i].reverse_range_scan("", NULL, po);
-					}
-					// std::cout << "\nFinally bucket: " << end_prefix_result << std::endl;
-					// std::cout << "4143" << std::endl;
-					po.set_prefix(generate_key_prefix(end_prefix_result));
-					hash_tables[end_prefix_result].reverse_range_scan("", end_suffix_keyp, po);
-					// std::cout << "4144" << std::endl;
-				}
-			} else { // Open-ended scan
-				// std::cout << "421" << std::endl;
-				// std::cout << "First bucket: " << start_prefix_result << ", then buckets: ";
-				hash_tables[start_prefix_result].reverse_range_scan(start_suffix_key, NULL, po);
-				// std::cout << "422" << std::endl;
-				for (std::uint32_t i = start_prefix_result+1; i < hash_table_amount; i++) {
-					// std::cout << i << ", ";
-					po.set_prefix(generate_key_prefix(i));
-					hash_tables[i].reverse_range_scan("", NULL, po);
-				}
-				// std::cout << "424" << std::endl;
-			}
+		std::uint64_t update(delegation_session& session, const std::string& key, const std::string& new_value) {
+			delegated_request request = route(delegated_op::update, key);
+			request.value = &new_value;
+			return session.submit(request);
+		}
 
-			// std::cout << "5" << std::endl;
-			// push results
-			auto queue = po.get();
-			// std::cout << "6" << std::endl;
-
-			while (!queue.empty())
-			{
-				hash_entry entry = queue.top();
-				std::string key   = std::get<0>(entry);
-				std::string value = std::get<1>(entry);
-				// std::cout << "Value: " << key << std::endl;
-				// std::cout << "8" << std::endl;
-				const char* keyp = key.c_str();
-				if (!apo.invoke(keyp, key.size(), value)) {
-					return;
-				}
-				// std::cout << "9" << std::endl;
-				queue.pop();
-			}
-			// std::cout << "10" << std::endl;
+		std::uint64_t remove(delegation_session& session, const std::string& key) {
+			return session.submit(route(delegated_op::remove, key));
+		}
+
+		// The owners that sessions for the batch interface are opened on
+		partition_owners& delegation_owners() {
+			static_assert(delegated, "Only delegated execution has owners");
+			return *owners;
 		}
 
 		std::uint32_t get_directory_size() {
 			return directory_size;
 		}
 
+		std::uint32_t partition_node(std::uint32_t partition) {
+			return partition_nodes[partition];
+		}
+
+		// Entries per partition, to see how evenly the routing spreads the keys
+		std::vector<size_t> partition_sizes() {
+			std::vector<size_t> sizes;
+			for (auto& table : hash_tables)
+				sizes.push_back(table.size());
+			return sizes;
+		}
+
+		// Counted point operations per partition, to see how evenly the routing spreads the load
+		std::vector<std::uint64_t> partition_accesses() {
+			std::vector<std::uint64_t> accesses;
+			for (std::uint32_t i = 0; i < hash_table_amount; i++)
+				accesses.push_back(access_counters[i].home_node.load(std::memory_order_relaxed) + access_counters[i].other_node.load(std::memory_order_relaxed));
+			return accesses;
+		}
+
+		// Point operations run by a thread on the home node of their partition, if counted
+		std::uint64_t calls_from_home_node() {
+			std::uint64_t total = 0;
+			for (std::uint32_t i = 0; i < hash_table_amount; i++)
+				total += access_counters[i].home_node.load(std::memory_order_relaxed);
+			return total;
+		}
+
+		std::uint64_t calls_from_other_nodes() {
+			std::uint64_t total = 0;
+			for (std::uint32_t i = 0; i < hash_table_amount; i++)
+				total += access_counters[i].other_node.load(std::memory_order_relaxed);
+			return total;
+		}
+
+		void reset_access_counts() {
+			for (std::uint32_t i = 0; i < hash_table_amount; i++) {
+				access_counters[i].home_node.store(0, std::memory_order_relaxed);
+				access_counters[i].other_node.store(0, std::memory_order_relaxed);
+			}
+		}
+
 		size_t size() {
 			std::uint32_t total_size = 0;
-			for (typename std::vector<array_hash_table<directory_size>>::iterator it = hash_tables.begin(); it != hash_tables.end(); ++it) {
+			for (typename std::vector<partition_type>::iterator it = hash_tables.begin(); it != hash_tables.end(); ++it) {
 				total_size += (*it).size();
 			}
 			return total_size;
 		}
 
         std::string to_string() override {
-            return "partitioned_array_hash_table";
+            return routing == partition_routing::hash ? "partitioned_array_hash_table_hashed" : "partitioned_array_hash_table";
         }
 
 	};
@@ -0,0 +1,358 @@
+#ifndef robin_hood_hash_table_h
+#define robin_hood_hash_table_h
+
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "../macros.h"
+
+#include "../abstract_index.h"
+#include "../push_ops.h"
+#include "../util/cache_aligned.h"
+#include "../util/epoch_manager.h"
+#include "bucket_entry.h"
+
+typedef std::uint32_t hash_value_t;
+
+namespace dbindex {
+    /**
+     * Open addressing hash table with Robin Hood linear probing. Each slot
+     * records how far its entry is from its home slot. An insert takes the
+     * slot of any entry closer to home than itself and carries that entry
+     * on, which keeps probe lengths short and nearly equal even at 90% load.
+     * A lookup stops at the first slot closer to home than its own probe,
+     * so misses are as cheap as hits. A remove shifts the entries that
+     * follow back by one slot instead of leaving a tombstone.
+     *
+     * The table is split into shard_count shards, each with its own lock
+     * and version, and growing on its own. get never takes a lock. It
+     * probes and validates against the version of the shard, which is odd
+     * while a writer modifies it, retrying if a writer got in between.
+     * The low bits of the hash value select the shard, the bits above the
+     * home slot.
+     */
+    template<std::uint32_t initial_shard_capacity = 1024, std::uint32_t shard_count = 64>
+    class robin_hood_hash_table : public abstract_index {
+    private:
+        abstract_hash<hash_value_t>& hash;
+
+        // Grow once a shard is more than max_load_percent full
+        static const std::uint32_t max_load_percent = 90;
+        static const std::uint32_t read_retries_before_yield = 64;
+        // Slots ahead whose entries a scan prefetches
+        static const std::uint32_t scan_prefetch_distance = 8;
+
+        static_assert(initial_shard_capacity > 1 && (initial_shard_capacity & (initial_shard_capacity-1)) == 0,
+                      "shard capacity must be a power of two");
+        static_assert(shard_count > 0 && (shard_count & (shard_count-1)) == 0, "shard count must be a power of two");
+
+        struct hash_slot {
+            std::atomic<std::uint32_t> distance; // Probe distance + 1, 0 if the slot is empty
+            std::atomic<hash_value_t>  hash_value;
+            std::atomic<bucket_entry*> entry;
+        };
+
+        // The slots are replaced as a whole when a shard grows, the old
+        // array is retired through the epoch manager. It does not own the
+        // entries, they are moved to the new array.
+        struct slot_array {
+            const std::uint32_t capacity;
+            hash_slot* const slots;
+
+            // calloc, zeroed atomics are empty slots
+            slot_array(std::uint32_t _capacity) : capacity(_capacity),
+                slots(static_cast<hash_slot*>(std::calloc(_capacity, sizeof(hash_slot)))) {
+                if (!slots)
+                    throw std::bad_alloc();
+            }
+            ~slot_array() {
+                std::free(slots);
+            }
+        };
+
+        struct alignas(CACHE_LINE_SIZE) hash_shard {
+            std::atomic<std::uint64_t> version{0}; // Odd while a writer modifies the shard
+            std::atomic<slot_array*> array;
+            std::atomic<size_t> entry_count{0};
+            boost::mutex shard_mutex;
+
+            hash_shard() : array(new slot_array(initial_shard_capacity)) {}
+            ~hash_shard() {
+                slot_array* a = array.load();
+                for (std::uint32_t i = 0; i < a->capacity; i++) {
+                    delete a->slots[i].entry.load();
+                }
+                delete a;
+            }
+
+            void begin_write() {
+                version.fetch_add(1, std::memory_order_acq_rel);
+            }
+            void end_write() {
+                version.fetch_add(1, std::memory_order_release);
+            }
+        };
+
+        std::vector<hash_shard, utils::cache_aligned_allocator<hash_shard>> shards{shard_count};
+
+        static const std::uint32_t not_found = ~(std::uint32_t)0;
+
+        hash_shard& shard_of(hash_value_t hash_value) {
+            return shards[hash_value & (shard_count-1)];
+        }
+        static std::uint32_t home_slot(const slot_array* a, hash_value_t hash_value) {
+            return (hash_value / shard_count) & (a->capacity-1);
+        }
+
+        // Slot of key, not_found if not present. Bounded by the capacity, as
+        // an optimistic reader may see slots in the middle of a shift.
+        static std::uint32_t find(const slot_array* a, hash_value_t hash_value, const std::string& key) {
+            std::uint32_t mask = a->capacity - 1;
+            std::uint32_t i = home_slot(a, hash_value);
+            for (std::uint32_t distance = 1; distance <= a->capacity; distance++, i = (i+1) & mask) {
+                const hash_slot& slot = a->slots[i];
+                if (slot.distance.load(std::memory_order_acquire) < distance) {
+                    return not_found; // Our key would have taken this slot
+                }
+                if (slot.hash_value.load(std::memory_order_relaxed) == hash_value) {
+                    bucket_entry* e = slot.entry.load(std::memory_order_acquire);
+                    if (e && e->matches(hash_value, key)) {
+                        return i;
+                    }
+                }
+            }
+            return not_found;
+        }
+
+        static void set_slot(hash_slot& slot, std::uint32_t distance, hash_value_t hash_value, bucket_entry* e) {
+            slot.hash_value.store(hash_value, std::memory_order_relaxed);
+            slot.entry.store(e, std::memory_order_relaxed);
+            slot.distance.store(distance, std::memory_order_release);
+        }
+
+        // Robin Hood insert, the array must have a free slot
+        static void place(slot_array* a, bucket_entry* e) {
+            std::uint32_t mask = a->capacity - 1;
+            std::uint32_t i = home_slot(a, e->hash_value);
+            std::uint32_t distance = 1;
+            while (true) {
+                hash_slot& slot = a->slots[i];
+                std::uint32_t slot_distance = slot.distance.load(std::memory_order_relaxed);
+                if (slot_distance == 0) {
+                    set_slot(slot, distance, e->hash_value, e);
+                    return;
+                }
+                if (slot_distance < distance) {
+                    // Take the slot from the richer entry and carry that one on
+                    bucket_entry* displaced = slot.entry.load(std::memory_order_relaxed);
+                    set_slot(slot, distance, e->hash_value, e);
+                    e = displaced;
+                    distance = slot_distance;
+                }
+                distance++;
+                i = (i+1) & mask;
+            }
+        }
+
+        // Backward shift deletion of slot i
+        static void erase(slot_array* a, std::uint32_t i) {
+            std::uint32_t mask = a->capacity - 1;
+            std::uint32_t next = (i+1) & mask;
+            while (a->slots[next].distance.load(std::memory_order_relaxed) > 1) {
+                hash_slot& slot = a->slots[next];
+                set_slot(a->slots[i], slot.distance.load(std::memory_order_relaxed) - 1,
+                         slot.hash_value.load(std::memory_order_relaxed), slot.entry.load(std::memory_order_relaxed));
+                i = next;
+                next = (next+1) & mask;
+            }
+            set_slot(a->slots[i], 0, 0, nullptr);
+        }
+
+        // Doubles the slots of the shard. Requires the shard lock and an open write.
+        static void grow(hash_shard& shard) {
+            slot_array* a = shard.array.load(std::memory_order_relaxed);
+            slot_array* new_array = new slot_array(a->capacity * 2);
+            for (std::uint32_t i = 0; i < a->capacity; i++) {
+                bucket_entry* e = a->slots[i].entry.load(std::memory_order_relaxed);
+                if (e) {
+                    place(new_array, e);
+                }
+            }
+            shard.array.store(new_array, std::memory_order_release);
+            utils::epoch_manager::instance().retire(a);
+        }
+
+        template<typename cmp>
+        void scan_internal(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) {
+            std::priority_queue<hash_entry, std::vector<hash_entry>, cmp> pri_queue;
+
+            // FULL SCAN, the slots are read in order and the entries they
+            // point to are prefetched a few slots ahead
+            for (hash_shard& shard : shards) {
+                boost::lock_guard<boost::mutex> shard_lock(shard.shard_mutex);
+                slot_array* a = shard.array.load(std::memory_order_relaxed);
+                for (std::uint32_t i = 0; i < a->capacity; i++) {
+                    if (i + scan_prefetch_distance < a->capacity) {
+                        __builtin_prefetch(a->slots[i + scan_prefetch_distance].entry.load(std::memory_order_relaxed));
+                    }
+                    bucket_entry* e = a->slots[i].entry.load(std::memory_order_relaxed);
+                    if (e) {
+                        std::string key = e->key();
+                        if (key >= start_key && (!end_key || key <= *end_key)) {
+                            pri_queue.push(std::make_tuple(key, e->value()));
+                        }
+                    }
+                }
+            }
+
+            // Apply push op
+            while(!pri_queue.empty()) {
+                hash_entry entry = pri_queue.top();
+                std::string key   = std::get<0>(entry);
+                std::string value = std::get<1>(entry);
+                const char* keyp = key.c_str();
+                if (!apo.invoke(keyp, key.size(), value)) {
+                    return;
+                }
+                pri_queue.pop();
+            }
+        }
+
+    public:
+        robin_hood_hash_table(abstract_hash<hash_value_t>& _hash) : hash(_hash) {}
+
+        bool get(const std::string& key, std::string& value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_shard& shard = shard_of(hash_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            for (std::uint32_t attempt = 1; ; attempt++) {
+                if (attempt % read_retries_before_yield == 0) {
+                    std::this_thread::yield(); // The writer may have been descheduled
+                }
+                std::uint64_t version = shard.version.load(std::memory_order_acquire);
+                if (version & 1) {
+                    continue; // Writer active
+                }
+                slot_array* a = shard.array.load(std::memory_order_acquire);
+                std::uint32_t i = find(a, hash_value, key);
+                bucket_entry* found = i == not_found ? nullptr : a->slots[i].entry.load(std::memory_order_acquire);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (shard.version.load(std::memory_order_relaxed) == version) {
+                    if (found) {
+                        found->read_value(value);
+                    }
+                    return found != nullptr;
+                }
+            }
+        }
+
+        // Like the other hash tables, does not check whether the key is present
+        void insert(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_shard& shard = shard_of(hash_value);
+            bucket_entry* new_entry = bucket_entry::create(hash_value, key, new_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            boost::lock_guard<boost::mutex> shard_lock(shard.shard_mutex);
+            shard.begin_write();
+            slot_array* a = shard.array.load(std::memory_order_relaxed);
+            if ((shard.entry_count.load(std::memory_order_relaxed) + 1) * 100 > (size_t)a->capacity * max_load_percent) {
+                grow(shard);
+                a = shard.array.load(std::memory_order_relaxed);
+            }
+            place(a, new_entry);
+            shard.entry_count.fetch_add(1, std::memory_order_relaxed);
+            shard.end_write();
+        }
+
+        void update(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_shard& shard = shard_of(hash_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            boost::lock_guard<boost::mutex> shard_lock(shard.shard_mutex);
+            slot_array* a = shard.array.load(std::memory_order_relaxed);
+            std::uint32_t i = find(a, hash_value, key);
+            if (i == not_found) {
+                return;
+            }
+            // A single pointer store, readers see either entry
+            bucket_entry* old_entry = a->slots[i].entry.load(std::memory_order_relaxed);
+            a->slots[i].entry.store(bucket_entry::create(hash_value, key, new_value), std::memory_order_release);
+            utils::epoch_manager::instance().retire(old_entry);
+        }
+
+        void remove(const std::string& key) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_shard& shard = shard_of(hash_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            boost::lock_guard<boost::mutex> shard_lock(shard.shard_mutex);
+            slot_array* a = shard.array.load(std::memory_order_relaxed);
+            std::uint32_t i = find(a, hash_value, key);
+            if (i == not_found) {
+                return;
+            }
+            bucket_entry* old_entry = a->slots[i].entry.load(std::memory_order_relaxed);
+            shard.begin_write();
+            erase(a, i);
+            shard.entry_count.fetch_sub(1, std::memory_order_relaxed);
+            shard.end_write();
+            utils::epoch_manager::instance().retire(old_entry);
+        }
+
+        void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<less_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<greater_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        size_t capacity() {
+            size_t total_capacity = 0;
+            for (hash_shard& shard : shards) {
+                boost::lock_guard<boost::mutex> shard_lock(shard.shard_mutex);
+                total_capacity += shard.array.load()->capacity;
+            }
+            return total_capacity;
+        }
+
+        // Longest distance of an entry from its home slot, 0 if empty
+        std::uint32_t max_probe_length() {
+            std::uint32_t max_distance = 0;
+            for (hash_shard& shard : shards) {
+                boost::lock_guard<boost::mutex> shard_lock(shard.shard_mutex);
+                slot_array* a = shard.array.load();
+                for (std::uint32_t i = 0; i < a->capacity; i++) {
+                    max_distance = std::max(max_distance, a->slots[i].distance.load());
+                }
+            }
+            return max_distance ? max_distance - 1 : 0;
+        }
+
+        size_t size() {
+            size_t total_entry_count = 0;
+            for (hash_shard& shard : shards) {
+                total_entry_count += shard.entry_count.load();
+            }
+            return total_entry_count;
+        }
+
+        std::string to_string() override {
+            return "robin_hood_hash_table";
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,368 @@
+#ifndef split_ordered_hash_table_h
+#define split_ordered_hash_table_h
+
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "../macros.h"
+
+#include "../abstract_index.h"
+#include "../push_ops.h"
+#include "../util/epoch_manager.h"
+
+typedef std::uint32_t hash_value_t;
+
+namespace dbindex {
+    /**
+     * Lock-free hash table on a split-ordered list (Shalev and Shavit).
+     * All entries live in a single lock-free sorted linked list (Harris and
+     * Michael), ordered by the bit reversed hash value. Bucket b points to
+     * a dummy node in the list in front of every entry whose hash value is
+     * b modulo the bucket count. Doubling the bucket count therefore moves
+     * no entry. A new bucket is initialized lazily, on first use, by
+     * inserting its dummy node after the dummy node of its parent bucket.
+     *
+     * No operation takes a lock, so a descheduled thread never blocks the
+     * others. Unlinked nodes and replaced values are freed through the
+     * epoch manager.
+     *
+     * Buckets are kept in segments that are allocated on first use and
+     * never move. Segment 0 holds the first initial_bucket_count buckets,
+     * and segment s > 0 holds initial_bucket_count << (s-1) buckets.
+     */
+    template<std::uint32_t initial_bucket_count = 1024>
+    class split_ordered_hash_table : public abstract_index {
+    private:
+        abstract_hash<hash_value_t>& hash;
+
+        // Average number of entries per bucket before the bucket count doubles
+        static const std::uint32_t max_load_factor = 2;
+        static const std::uint32_t max_segments = 33;
+
+        static_assert(initial_bucket_count > 0 && (initial_bucket_count & (initial_bucket_count-1)) == 0,
+                      "bucket count must be a power of two");
+
+        // Dummy nodes have an even split order key and no key or value.
+        // Regular nodes have an odd one, and are ordered by key when their
+        // split order keys are equal. The low bit of next marks the node as
+        // removed.
+        struct list_node {
+            const std::uint64_t so_key;
+            const hash_value_t hash_value;
+            const std::string key;
+            std::atomic<std::string*> value;
+            std::atomic<list_node*> next;
+
+            list_node(std::uint64_t _so_key) : so_key(_so_key), hash_value(0), value(nullptr), next(nullptr) {}
+            list_node(std::uint64_t _so_key, hash_value_t _hash_value, const std::string& _key, const std::string& _value) :
+                so_key(_so_key), hash_value(_hash_value), key(_key), value(new std::string(_value)), next(nullptr) {}
+
+            ~list_node() {
+                delete value.load();
+            }
+
+            bool is_dummy() const {
+                return (so_key & 1) == 0;
+            }
+        };
+
+        static bool is_marked(list_node* p) {
+            return reinterpret_cast<std::uintptr_t>(p) & 1;
+        }
+        static list_node* marked(list_node* p) {
+            return reinterpret_cast<list_node*>(reinterpret_cast<std::uintptr_t>(p) | 1);
+        }
+        static list_node* unmarked(list_node* p) {
+            return reinterpret_cast<list_node*>(reinterpret_cast<std::uintptr_t>(p) & ~(std::uintptr_t)1);
+        }
+
+        static std::uint64_t reverse_bits(std::uint64_t x) {
+            x = ((x >> 1)  & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+            x = ((x >> 2)  & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+            x = ((x >> 4)  & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+            x = ((x >> 8)  & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+            x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+            return (x >> 32) | (x << 32);
+        }
+        static std::uint64_t regular_so_key(hash_value_t hash_value) {
+            return reverse_bits((std::uint64_t)hash_value | (1ULL << 63));
+        }
+        static std::uint64_t dummy_so_key(std::uint64_t bucket) {
+            return reverse_bits(bucket);
+        }
+
+        // Order of node against the split order key and key searched for
+        static int compare(const list_node* node, std::uint64_t so_key, const std::string* key) {
+            if (node->so_key != so_key) {
+                return node->so_key < so_key ? -1 : 1;
+            }
+            return key ? node->key.compare(*key) : 0;
+        }
+
+        std::atomic<std::atomic<list_node*>*> segments[max_segments];
+        std::atomic<std::uint64_t> bucket_count{initial_bucket_count};
+        std::atomic<size_t> entry_count{0};
+
+        static std::uint32_t segment_of(std::uint64_t bucket, std::uint64_t& offset) {
+            if (bucket < initial_bucket_count) {
+                offset = bucket;
+                return 0;
+            }
+            std::uint32_t s = 64 - __builtin_clzll(bucket / initial_bucket_count);
+            offset = bucket - ((std::uint64_t)initial_bucket_count << (s-1));
+            return s;
+        }
+        static std::uint64_t segment_size(std::uint32_t s) {
+            return s == 0 ? initial_bucket_count : (std::uint64_t)initial_bucket_count << (s-1);
+        }
+
+        std::atomic<list_node*>& bucket_slot(std::uint64_t bucket) {
+            std::uint64_t offset;
+            std::uint32_t s = segment_of(bucket, offset);
+            std::atomic<list_node*>* segment = segments[s].load(std::memory_order_acquire);
+            if (!segment) {
+                // calloc, a zeroed atomic pointer is a null pointer
+                std::atomic<list_node*>* new_segment =
+                    static_cast<std::atomic<list_node*>*>(std::calloc(segment_size(s), sizeof(std::atomic<list_node*>)));
+                if (!new_segment)
+                    throw std::bad_alloc();
+                if (segments[s].compare_exchange_strong(segment, new_segment)) {
+                    segment = new_segment;
+                } else {
+                    std::free(new_segment);
+                }
+            }
+            return segment[offset];
+        }
+
+        /**
+         * Positions prev and curr around so_key and key, starting from the
+         * dummy node start: curr is the first node not ordered before them
+         * and prev is the link pointing to it. Unlinks removed nodes on the
+         * way and retires them. Returns whether curr matches exactly.
+         * Requires an epoch guard.
+         */
+        bool find(list_node* start, std::uint64_t so_key, const std::string* key,
+                  std::atomic<list_node*>*& prev, list_node*& curr) {
+        retry:
+            prev = &start->next;
+            curr = prev->load(std::memory_order_acquire);
+            while (true) {
+                if (!curr) {
+                    return false;
+                }
+                list_node* next = curr->next.load(std::memory_order_acquire);
+                if (is_marked(next)) {
+                    list_node* expected = curr;
+                    if (!prev->compare_exchange_strong(expected, unmarked(next))) {
+                        goto retry;
+                    }
+                    utils::epoch_manager::instance().retire(curr);
+                    curr = unmarked(next);
+                    continue;
+                }
+                if (prev->load(std::memory_order_acquire) != curr) {
+                    goto retry; // prev was removed or a node was inserted in front of curr
+                }
+                int order = compare(curr, so_key, key);
+                if (order >= 0) {
+                    return order == 0;
+                }
+                prev = &curr->next;
+                curr = next;
+            }
+        }
+
+        // Dummy node of bucket, initializing the bucket if needed. Requires an epoch guard.
+        list_node* get_bucket(std::uint64_t bucket) {
+            std::atomic<list_node*>& slot = bucket_slot(bucket);
+            list_node* dummy = slot.load(std::memory_order_acquire);
+            if (dummy) {
+                return dummy;
+            }
+            // The parent is the bucket this one was split from
+            std::uint64_t parent = bucket & ~(1ULL << (63 - __builtin_clzll(bucket)));
+            list_node* parent_dummy = get_bucket(parent);
+
+            list_node* new_dummy = new list_node(dummy_so_key(bucket));
+            std::atomic<list_node*>* prev;
+            list_node* curr;
+            while (true) {
+                if (find(parent_dummy, new_dummy->so_key, nullptr, prev, curr)) {
+                    delete new_dummy; // Another thread inserted it
+                    new_dummy = curr;
+                    break;
+                }
+                new_dummy->next.store(curr, std::memory_order_relaxed);
+                if (prev->compare_exchange_strong(curr, new_dummy)) {
+                    break;
+                }
+            }
+            slot.store(new_dummy, std::memory_order_release);
+            return new_dummy;
+        }
+
+        list_node* bucket_of(hash_value_t hash_value) {
+            return get_bucket(hash_value & (bucket_count.load(std::memory_order_acquire) - 1));
+        }
+
+        template<typename cmp>
+        void scan_internal(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) {
+            std::priority_queue<hash_entry, std::vector<hash_entry>, cmp> pri_queue;
+
+            // FULL SCAN of the list
+            {
+                utils::epoch_manager::guard epoch_guard;
+                list_node* curr = bucket_slot(0).load(std::memory_order_acquire);
+                while (curr) {
+                    list_node* next = curr->next.load(std::memory_order_acquire);
+                    if (!curr->is_dummy() && !is_marked(next) &&
+                        curr->key >= start_key && (!end_key || curr->key <= *end_key)) {
+                        pri_queue.push(std::make_tuple(curr->key, *curr->value.load(std::memory_order_acquire)));
+                    }
+                    curr = unmarked(next);
+                }
+            }
+
+            // Apply push op
+            while(!pri_queue.empty()) {
+                hash_entry entry = pri_queue.top();
+                std::string key   = std::get<0>(entry);
+                std::string value = std::get<1>(entry);
+                const char* keyp = key.c_str();
+                if (!apo.invoke(keyp, key.size(), value)) {
+                    return;
+                }
+                pri_queue.pop();
+            }
+        }
+    public:
+        split_ordered_hash_table(abstract_hash<hash_value_t>& _hash) : hash(_hash) {
+            for (std::uint32_t s = 0; s < max_segments; s++) {
+                segments[s] = nullptr;
+            }
+            bucket_slot(0).store(new list_node(dummy_so_key(0)));
+        }
+
+        ~split_ordered_hash_table() {
+            list_node* node = bucket_slot(0).load();
+            while (node) {
+                list_node* next = unmarked(node->next.load());
+                delete node;
+                node = next;
+            }
+            for (std::uint32_t s = 0; s < max_segments; s++) {
+                std::free(segments[s].load());
+            }
+        }
+
+        bool get(const std::string& key, std::string& value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            std::uint64_t so_key = regular_so_key(hash_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            // Read only traversal, removed nodes are skipped, not unlinked
+            list_node* curr = bucket_of(hash_value)->next.load(std::memory_order_acquire);
+            while (curr) {
+                list_node* next = curr->next.load(std::memory_order_acquire);
+                int order = compare(curr, so_key, &key);
+                if (order > 0) {
+                    return false;
+                }
+                if (order == 0 && !is_marked(next)) {
+                    value = *curr->value.load(std::memory_order_acquire);
+                    return true;
+                }
+                curr = unmarked(next);
+            }
+            return false;
+        }
+
+        // Like the other hash tables, does not check whether the key is present
+        void insert(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            list_node* node = new list_node(regular_so_key(hash_value), hash_value, key, new_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            list_node* start = bucket_of(hash_value);
+            std::atomic<list_node*>* prev;
+            list_node* curr;
+            do {
+                find(start, node->so_key, &key, prev, curr);
+                node->next.store(curr, std::memory_order_relaxed);
+            } while (!prev->compare_exchange_strong(curr, node));
+
+            std::uint64_t buckets = bucket_count.load();
+            if (entry_count.fetch_add(1) + 1 > max_load_factor * buckets && buckets < (1ULL << 32)) {
+                bucket_count.compare_exchange_strong(buckets, buckets * 2);
+            }
+        }
+
+        void update(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+
+            utils::epoch_manager::guard epoch_guard;
+            std::atomic<list_node*>* prev;
+            list_node* curr;
+            if (find(bucket_of(hash_value), regular_so_key(hash_value), &key, prev, curr)) {
+                std::string* old_value = curr->value.exchange(new std::string(new_value));
+                utils::epoch_manager::instance().retire(old_value);
+            }
+        }
+
+        void remove(const std::string& key) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            std::uint64_t so_key = regular_so_key(hash_value);
+
+            utils::epoch_manager::guard epoch_guard;
+            list_node* start = bucket_of(hash_value);
+            std::atomic<list_node*>* prev;
+            list_node* curr;
+            while (find(start, so_key, &key, prev, curr)) {
+                list_node* next = curr->next.load(std::memory_order_acquire);
+                if (is_marked(next)) {
+                    continue;
+                }
+                // Marking removes the node logically, unlinking it physically
+                if (curr->next.compare_exchange_strong(next, marked(next))) {
+                    entry_count--;
+                    if (prev->compare_exchange_strong(curr, next)) {
+                        utils::epoch_manager::instance().retire(curr);
+                    } else {
+                        find(start, so_key, &key, prev, curr); // Unlinks it
+                    }
+                    return;
+                }
+            }
+        }
+
+        void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<less_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<greater_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        std::uint64_t get_bucket_count() {
+            return bucket_count.load();
+        }
+
+        size_t size() {
+            return entry_count.load();
+        }
+
+        std::string to_string() override {
+            return "split_ordered_hash_table";
+        }
+    };
+}
+
+#endif
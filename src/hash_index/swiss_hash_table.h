@@ -0,0 +1,300 @@
+#ifndef swiss_hash_table_h
+#define swiss_hash_table_h
+
+#include <iostream>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <boost/thread.hpp>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../macros.h"
+
+#include "../abstract_index.h"
+#include "../push_ops.h"
+#include "../util/cache_aligned.h"
+#include "../util/rw_spinlock.h"
+
+typedef std::uint32_t hash_value_t;
+
+namespace dbindex {
+    /**
+     * Open addressing hash table in the style of Swiss tables. Every slot has
+     * a control byte holding either a 7 bit tag of the hash value of its key
+     * or a marker for an empty or deleted slot. Slots are probed in groups of
+     * 16, whose control bytes are compared against the tag with a single SSE2
+     * compare, so a key is only compared when its tag matches.
+     *
+     * The table is split into shard_count shards, each with its own lock and
+     * growing on its own once it is 7/8 full. Bits 0-6 of the hash value are
+     * the tag, the bits above select the shard and then the first group.
+     *
+     * shard_lock_type guards a shard, anything Lockable and SharedLockable.
+     */
+    template<std::uint32_t initial_shard_capacity = 1024, std::uint32_t shard_count = 64,
+             typename shard_lock_type = utils::rw_spinlock>
+    class swiss_hash_table : public abstract_index {
+    private:
+        abstract_hash<hash_value_t>& hash;
+
+        static const std::uint32_t group_size = 16;
+        static const std::int8_t ctrl_empty   = -128;
+        static const std::int8_t ctrl_deleted = -2;
+
+        static_assert(initial_shard_capacity >= group_size && (initial_shard_capacity & (initial_shard_capacity-1)) == 0,
+                      "shard capacity must be a power of two of at least one group");
+        static_assert(shard_count > 0 && (shard_count & (shard_count-1)) == 0, "shard count must be a power of two");
+
+        struct hash_slot {
+            hash_value_t hash_value;
+            std::string key;
+            std::string value;
+        };
+
+        struct alignas(CACHE_LINE_SIZE) hash_shard {
+            std::vector<std::int8_t> control;
+            std::vector<hash_slot> slots;
+            size_t entry_count = 0;
+            size_t used_count  = 0; // Full and deleted slots
+            shard_lock_type shard_mutex;
+
+            hash_shard() : control(initial_shard_capacity, std::int8_t(ctrl_empty)), slots(initial_shard_capacity) {}
+        };
+
+        std::vector<hash_shard, utils::cache_aligned_allocator<hash_shard>> shards{shard_count};
+
+        static const size_t not_found = ~(size_t)0;
+
+        static std::int8_t tag(hash_value_t hash_value) {
+            return hash_value & 0x7F;
+        }
+        hash_shard& shard_of(hash_value_t hash_value) {
+            return shards[(hash_value >> 7) % shard_count];
+        }
+        static size_t first_group(hash_value_t hash_value) {
+            return (hash_value >> 7) / shard_count;
+        }
+
+        // Bit i is set if control byte i of the group equals b
+        static std::uint32_t match_byte(const std::int8_t* group, std::int8_t b) {
+#ifdef __SSE2__
+            __m128i control = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8(b)));
+#else
+            std::uint32_t mask = 0;
+            for (std::uint32_t i = 0; i < group_size; i++) {
+                mask |= (std::uint32_t)(group[i] == b) << i;
+            }
+            return mask;
+#endif
+        }
+
+        // Bit i is set if slot i of the group is empty or deleted, both have the sign bit set
+        static std::uint32_t match_free(const std::int8_t* group) {
+#ifdef __SSE2__
+            return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group)));
+#else
+            std::uint32_t mask = 0;
+            for (std::uint32_t i = 0; i < group_size; i++) {
+                mask |= (std::uint32_t)(group[i] < 0) << i;
+            }
+            return mask;
+#endif
+        }
+
+        // Visits the groups g, g+1, g+3, g+6, ... which covers every group
+        // when the group count is a power of two.
+        static size_t next_group(size_t group, size_t step, size_t group_mask) {
+            return (group + step) & group_mask;
+        }
+
+        size_t find(hash_shard& shard, hash_value_t hash_value, const std::string& key) {
+            size_t group_mask = shard.control.size() / group_size - 1;
+            size_t group = first_group(hash_value) & group_mask;
+            for (size_t step = 1; ; step++) {
+                const std::int8_t* control = &shard.control[group * group_size];
+                for (std::uint32_t mask = match_byte(control, tag(hash_value)); mask; mask &= mask - 1) {
+                    size_t i = group * group_size + __builtin_ctz(mask);
+                    if (shard.slots[i].hash_value == hash_value && shard.slots[i].key == key) {
+                        return i;
+                    }
+                }
+                if (match_byte(control, ctrl_empty)) { // The key would have been placed here
+                    return not_found;
+                }
+                group = next_group(group, step, group_mask);
+            }
+        }
+
+        // First empty or deleted slot on the probe sequence of hash_value
+        static size_t find_free(hash_shard& shard, hash_value_t hash_value) {
+            size_t group_mask = shard.control.size() / group_size - 1;
+            size_t group = first_group(hash_value) & group_mask;
+            for (size_t step = 1; ; step++) {
+                std::uint32_t mask = match_free(&shard.control[group * group_size]);
+                if (mask) {
+                    return group * group_size + __builtin_ctz(mask);
+                }
+                group = next_group(group, step, group_mask);
+            }
+        }
+
+        // Rebuilds the shard without deleted slots, doubling it if it is
+        // still more than half full. Requires the shard lock exclusively.
+        static void rehash(hash_shard& shard) {
+            size_t capacity = shard.control.size();
+            if (shard.entry_count * 2 >= capacity) {
+                capacity *= 2;
+            }
+            // Swap in empty arrays and move the entries over
+            std::vector<std::int8_t> old_control(capacity, std::int8_t(ctrl_empty));
+            std::vector<hash_slot> old_slots(capacity);
+            old_control.swap(shard.control);
+            old_slots.swap(shard.slots);
+
+            for (size_t i = 0; i < old_control.size(); i++) {
+                if (old_control[i] >= 0) {
+                    size_t j = find_free(shard, old_slots[i].hash_value);
+                    shard.control[j] = old_control[i];
+                    shard.slots[j]   = std::move(old_slots[i]);
+                }
+            }
+            shard.used_count = shard.entry_count;
+        }
+
+        template<typename cmp>
+        void scan_internal(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) {
+            typedef std::tuple<std::string, std::string> hash_entry;
+
+            std::priority_queue<hash_entry, std::vector<hash_entry>, cmp> pri_queue;
+
+            // FULL SCAN
+            for (hash_shard& shard : shards) {
+                boost::shared_lock<shard_lock_type> shard_shared_lock(shard.shard_mutex);
+                for (size_t i = 0; i < shard.control.size(); i++) {
+                    if (shard.control[i] >= 0 && shard.slots[i].key >= start_key && (!end_key || shard.slots[i].key <= *end_key)) {
+                        pri_queue.push(std::make_tuple(shard.slots[i].key, shard.slots[i].value));
+                    }
+                }
+            }
+
+            // Apply push op
+            while(!pri_queue.empty()) {
+                hash_entry current = pri_queue.top();
+                std::string key   = std::get<0>(current);
+                std::string value = std::get<1>(current);
+                const char* keyp = key.c_str();
+                if (!apo.invoke(keyp, key.size(), value)) {
+                    return;
+                }
+                pri_queue.pop();
+            }
+        }
+
+    public:
+        swiss_hash_table(abstract_hash<hash_value_t>& _hash) : hash(_hash) {}
+
+        bool get(const std::string& key, std::string& value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_shard& shard = shard_of(hash_value);
+
+            boost::shared_lock<shard_lock_type> shard_shared_lock(shard.shard_mutex);
+            size_t i = find(shard, hash_value, key);
+            if (i == not_found) {
+                return false;
+            }
+            value = shard.slots[i].value;
+            return true;
+        }
+
+        // Like the other hash tables, does not check whether the key is present
+        void insert(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_shard& shard = shard_of(hash_value);
+
+            boost::unique_lock<shard_lock_type> shard_exclusive_lock(shard.shard_mutex);
+            if ((shard.used_count + 1) * 8 > shard.control.size() * 7) {
+                rehash(shard);
+            }
+            size_t i = find_free(shard, hash_value);
+            if (shard.control[i] == ctrl_empty) {
+                shard.used_count++;
+            }
+            shard.control[i] = tag(hash_value);
+            shard.slots[i].hash_value = hash_value;
+            shard.slots[i].key   = key;
+            shard.slots[i].value = new_value;
+            shard.entry_count++;
+        }
+
+        void update(const std::string& key, const std::string& new_value) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_shard& shard = shard_of(hash_value);
+
+            boost::unique_lock<shard_lock_type> shard_exclusive_lock(shard.shard_mutex);
+            size_t i = find(shard, hash_value, key);
+            if (i != not_found) {
+                shard.slots[i].value = new_value;
+            }
+        }
+
+        void remove(const std::string& key) override {
+            hash_value_t hash_value = hash.get_hash(key);
+            hash_shard& shard = shard_of(hash_value);
+
+            boost::unique_lock<shard_lock_type> shard_exclusive_lock(shard.shard_mutex);
+            size_t i = find(shard, hash_value, key);
+            if (i == not_found) {
+                return;
+            }
+            shard.slots[i].key.clear();
+            shard.slots[i].value.clear();
+            // A group with an empty slot ends every probe reaching it, so no
+            // probe can pass through it and the slot can become empty again.
+            const std::int8_t* control = &shard.control[i / group_size * group_size];
+            if (match_byte(control, ctrl_empty)) {
+                shard.control[i] = ctrl_empty;
+                shard.used_count--;
+            } else {
+                shard.control[i] = ctrl_deleted;
+            }
+            shard.entry_count--;
+        }
+
+        void range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<less_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        void reverse_range_scan(const std::string& start_key, const std::string* end_key, abstract_push_op& apo) override {
+            if (end_key) assert(*end_key > start_key);
+            scan_internal<greater_than_hash_entry>(start_key, end_key, apo);
+        }
+
+        size_t capacity() {
+            size_t total_capacity = 0;
+            for (hash_shard& shard : shards) {
+                boost::shared_lock<shard_lock_type> shard_shared_lock(shard.shard_mutex);
+                total_capacity += shard.control.size();
+            }
+            return total_capacity;
+        }
+
+        size_t size() {
+            size_t total_entry_count = 0;
+            for (hash_shard& shard : shards) {
+                boost::shared_lock<shard_lock_type> shard_shared_lock(shard.shard_mutex);
+                total_entry_count += shard.entry_count;
+            }
+            return total_entry_count;
+        }
+
+        std::string to_string() override {
+            return "swiss_hash_table";
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,522 @@
+#include "blinktreeindex.h"
+
+#include "../util/epoch_manager.h"
+#include <thread>
+
+namespace {
+    using dbindex::bucket_entry;
+    using dbindex::compare_key;
+    using dbindex::key_prefix_of;
+    using dbindex::blinktree::keys_per_node;
+    using dbindex::blinktree::node;
+    using dbindex::blinktree::node_val;
+
+    // Entries of a node as a reader sees them, possibly half written
+    std::size_t entries_of(const node* a_node) {
+        std::size_t count = a_node->num_entries.load(std::memory_order_relaxed);
+        return count < keys_per_node ? count : keys_per_node;
+    }
+
+    // The functions below are for writers, holding the lock of the node
+
+    void set_val(node_val& to, bucket_entry* entry, node* child_node) {
+        to.key_prefix.store(entry != nullptr ? key_prefix_of(entry->key_data(), entry->key_length) : 0,
+                std::memory_order_relaxed);
+        to.entry.store(entry, std::memory_order_release);
+        to.child_node.store(child_node, std::memory_order_release);
+    }
+
+    void move_val(node_val& to, const node_val& from) {
+        to.key_prefix.store(from.key_prefix.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.entry.store(from.entry.load(std::memory_order_relaxed), std::memory_order_release);
+        to.child_node.store(from.child_node.load(std::memory_order_relaxed), std::memory_order_release);
+    }
+
+    // Places entry with child_node, null in leaves, in order among the entries of a node with room
+    void place_entry(node* a_node, const std::string& key, bucket_entry* entry, node* child_node) {
+        std::size_t count = a_node->num_entries.load(std::memory_order_relaxed);
+        std::size_t index = count;
+        while (index > 0 && compare_key(a_node->values[index - 1].entry.load(std::memory_order_relaxed), key) > 0) {
+            move_val(a_node->values[index], a_node->values[index - 1]);
+            index--;
+        }
+        set_val(a_node->values[index], entry, child_node);
+        a_node->num_entries.store(count + 1, std::memory_order_relaxed);
+    }
+
+    // Closes the gap at index of the entries of a leaf, clearing the last one
+    void remove_entry(node* leaf_node, std::size_t index) {
+        std::size_t count = leaf_node->num_entries.load(std::memory_order_relaxed);
+        for (std::size_t i = index + 1; i < count; i++) {
+            move_val(leaf_node->values[i - 1], leaf_node->values[i]);
+        }
+        set_val(leaf_node->values[count - 1], nullptr, nullptr);
+        leaf_node->num_entries.store(count - 1, std::memory_order_relaxed);
+    }
+
+    bucket_entry* copy_key(const bucket_entry* entry) {
+        return bucket_entry::create(0, entry->key(), "");
+    }
+}
+
+dbindex::blinktree::blinktreeindex::blinktreeindex() : root_node(new node(0)) {
+}
+
+dbindex::blinktree::blinktreeindex::~blinktreeindex() {
+    node* level_node = root_node.load();
+    while (level_node != nullptr) {
+        node* next_level_node = level_node->first_child_node.load();
+        free_level(level_node);
+        level_node = next_level_node;
+    }
+}
+
+void dbindex::blinktree::blinktreeindex::free_level(node* leftmost_node) {
+    node* a_node = leftmost_node;
+    while (a_node != nullptr) {
+        node* right_node = a_node->right_link.load();
+        for (std::size_t i = 0; i < a_node->num_entries.load(); i++) {
+            delete a_node->values[i].entry.load();
+        }
+        delete a_node->high_key.load();
+        delete a_node;
+        a_node = right_node;
+    }
+}
+
+/**
+ * Notes the version of the node covering key, a_node or one right of it,
+ * going right while key is at or above the high key. The caller reads the
+ * node and validates the version.
+ */
+dbindex::blinktree::node* dbindex::blinktree::blinktreeindex::move_right(node* a_node,
+        const std::string* key, std::uint64_t& version) {
+    a_node->lock.read_lock(version);
+    for (;;) {
+        bucket_entry* high_key = a_node->high_key.load(std::memory_order_acquire);
+        if (!beyond(key, high_key)) {
+            return a_node;
+        }
+        node* right_node = a_node->right_link.load(std::memory_order_acquire);
+        std::uint64_t right_version;
+        if (a_node->lock.validate(version)) {
+            right_node->lock.read_lock(right_version);
+            a_node = right_node;
+            version = right_version;
+        } else {
+            a_node->lock.read_lock(version);
+        }
+    }
+}
+
+/**
+ * Goes down to the node at level covering key, the last one of the level
+ * for a null key, and notes its version. path, if given, gets the node
+ * each level above was left from.
+ */
+dbindex::blinktree::node* dbindex::blinktree::blinktreeindex::find_node(
+        const std::string* key, std::size_t level, std::uint64_t& version, node** path) {
+    std::uint64_t prefix = key != nullptr ? key_prefix_of(key->data(), key->size()) : 0;
+    node* cur_node = move_right(root_node.load(std::memory_order_acquire), key, version);
+    while (cur_node->level > level) {
+        node* child_node = child_for(cur_node, key, prefix);
+        if (child_node == nullptr || !cur_node->lock.validate(version)) {
+            // Read the node again, not the whole path
+            cur_node = move_right(cur_node, key, version);
+            continue;
+        }
+        if (path != nullptr) {
+            path[cur_node->level] = cur_node;
+        }
+        cur_node = move_right(child_node, key, version);
+    }
+    return cur_node;
+}
+
+/**
+ * The child of an inner node holding key, whose prefix is given, the
+ * last one for a null key. Null if the node was caught half written
+ */
+dbindex::blinktree::node* dbindex::blinktree::blinktreeindex::child_for(node* inner_node,
+        const std::string* key, std::uint64_t prefix) {
+    std::size_t count = entries_of(inner_node);
+    if (key == nullptr) {
+        return count == 0 ? inner_node->first_child_node.load(std::memory_order_acquire)
+                : inner_node->values[count - 1].child_node.load(std::memory_order_acquire);
+    }
+    node* child_node = inner_node->first_child_node.load(std::memory_order_acquire);
+    for (std::size_t pos = 0; pos < count; pos++) {
+        std::uint64_t entry_prefix = inner_node->values[pos].key_prefix.load(std::memory_order_relaxed);
+        if (entry_prefix > prefix) {
+            break;
+        }
+        if (entry_prefix == prefix) {
+            bucket_entry* entry = inner_node->values[pos].entry.load(std::memory_order_acquire);
+            if (entry == nullptr) {
+                return nullptr;
+            }
+            if (bytecomparer(entry, *key) > 0) {
+                break;
+            }
+        }
+        child_node = inner_node->values[pos].child_node.load(std::memory_order_acquire);
+    }
+    return child_node;
+}
+
+/**
+ * Finds the index of the first key of the leaf not below key, whose
+ * prefix is given, and its entry if it is key. False if the leaf was
+ * caught half written
+ */
+bool dbindex::blinktree::blinktreeindex::search_leaf(node* leaf_node,
+        const std::string& key, std::uint64_t prefix, std::size_t& index, bucket_entry*& found) {
+    std::size_t count = entries_of(leaf_node);
+    found = nullptr;
+    for (index = 0; index < count; index++) {
+        std::uint64_t entry_prefix = leaf_node->values[index].key_prefix.load(std::memory_order_relaxed);
+        if (entry_prefix < prefix) {
+            continue;
+        }
+        if (entry_prefix > prefix) {
+            break;
+        }
+        bucket_entry* entry = leaf_node->values[index].entry.load(std::memory_order_acquire);
+        if (entry == nullptr) {
+            return false;
+        }
+        auto comparison_result = bytecomparer(entry, key);
+        if (comparison_result >= 0) {
+            if (comparison_result == 0) {
+                found = entry;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+bool dbindex::blinktree::blinktreeindex::get(const std::string& key,
+        std::string& value) {
+    utils::epoch_manager::guard epoch_guard;
+    std::uint64_t prefix = key_prefix_of(key.data(), key.size());
+    std::uint64_t version;
+    std::size_t index;
+    bucket_entry* found;
+    node* leaf_node = find_node(&key, 0, version, nullptr);
+    while (!search_leaf(leaf_node, key, prefix, index, found)
+            || !leaf_node->lock.validate(version)) {
+        leaf_node = move_right(leaf_node, &key, version);
+    }
+    if (found != nullptr) {
+        //Found copy and return
+        found->read_value(value);
+    }
+    return found != nullptr;
+}
+
+// Locks the node covering key, a_node or one right of it
+dbindex::blinktree::node* dbindex::blinktree::blinktreeindex::lock_covering(node* a_node,
+        const std::string& key) {
+    for (;;) {
+        std::uint64_t version;
+        a_node = move_right(a_node, &key, version);
+        if (a_node->lock.upgrade(version)) {
+            return a_node;
+        }
+    }
+}
+
+/**
+ * Like the hash indexes, ignores keys that are not present
+ */
+void dbindex::blinktree::blinktreeindex::update(const std::string& key,
+        const std::string& value) {
+    utils::epoch_manager::guard epoch_guard;
+    std::uint64_t version;
+    std::size_t index;
+    bucket_entry* found;
+    node* leaf_node = lock_covering(find_node(&key, 0, version, nullptr), key);
+    search_leaf(leaf_node, key, key_prefix_of(key.data(), key.size()), index, found);
+    if (found != nullptr) {
+        leaf_node->values[index].entry.store(bucket_entry::create(0, key, value),
+                std::memory_order_release);
+    }
+    leaf_node->lock.unlock();
+    if (found != nullptr) {
+        utils::epoch_manager::instance().retire(found);
+    }
+}
+
+void dbindex::blinktree::blinktreeindex::insert(const std::string& key,
+        const std::string& value) {
+    utils::epoch_manager::guard epoch_guard;
+    node* path[max_height] = {};
+    std::uint64_t version;
+    std::size_t index;
+    bucket_entry* found;
+    node* leaf_node = lock_covering(find_node(&key, 0, version, path), key);
+    search_leaf(leaf_node, key, key_prefix_of(key.data(), key.size()), index, found);
+    if (found != nullptr) {
+        leaf_node->values[index].entry.store(bucket_entry::create(0, key, value),
+                std::memory_order_release);
+        leaf_node->lock.unlock();
+        utils::epoch_manager::instance().retire(found);
+        return;
+    }
+    entry_count++;
+    insert_into(leaf_node, key, bucket_entry::create(0, key, value), nullptr, path);
+}
+
+/**
+ * Adds entry, with child_node in inner nodes, to the locked a_node and
+ * unlocks it. A full node is split first, and the separator is then
+ * posted to its parent the same way.
+ */
+void dbindex::blinktree::blinktreeindex::insert_into(node* a_node, const std::string& key,
+        bucket_entry* entry, node* child_node, node** path) {
+    if (a_node->num_entries.load(std::memory_order_relaxed) < keys_per_node) {
+        place_entry(a_node, key, entry, child_node);
+        a_node->lock.unlock();
+        return;
+    }
+    bucket_entry* separator;
+    node* right_node = split_node(a_node, key, entry, child_node, separator);
+    a_node->lock.unlock();
+
+    std::string separator_key = separator->key();
+    node* parent_node = lock_parent(a_node, separator_key, separator, right_node, path);
+    if (parent_node != nullptr) {
+        insert_into(parent_node, separator_key, separator, right_node, path);
+    }
+}
+
+/**
+ * Moves the upper half of the full, locked a_node to a new node right of
+ * it and adds entry to the half it belongs in. A leaf keeps the first key
+ * of the new node as its high key and hands up a copy, an inner node
+ * hands up its middle entry, whose child becomes the first one of the new
+ * node. The new node is complete before a_node links to it, and before
+ * the next leaf links back to it, so readers see either the whole split
+ * or none of it.
+ */
+dbindex::blinktree::node* dbindex::blinktree::blinktreeindex::split_node(node* a_node,
+        const std::string& key, bucket_entry* entry, node* child_node, bucket_entry*& separator) {
+    bool is_leaf_node = a_node->level == 0;
+    auto right_node = new node(a_node->level);
+    std::size_t left_count = keys_per_node / 2;
+    std::size_t first_moved = left_count;
+    if (is_leaf_node) {
+        separator = copy_key(a_node->values[left_count].entry.load(std::memory_order_relaxed));
+    } else {
+        separator = a_node->values[left_count].entry.load(std::memory_order_relaxed);
+        right_node->first_child_node.store(
+                a_node->values[left_count].child_node.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        first_moved++;
+    }
+    for (std::size_t i = first_moved; i < keys_per_node; i++) {
+        move_val(right_node->values[i - first_moved], a_node->values[i]);
+    }
+    right_node->num_entries.store(keys_per_node - first_moved, std::memory_order_relaxed);
+    right_node->high_key.store(a_node->high_key.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    node* next_node = a_node->right_link.load(std::memory_order_relaxed);
+    right_node->right_link.store(next_node, std::memory_order_relaxed);
+    bool goes_right = bytecomparer(separator, key) <= 0;
+    if (goes_right) {
+        place_entry(right_node, key, entry, child_node);
+    }
+    if (is_leaf_node) {
+        right_node->prev.store(a_node, std::memory_order_relaxed);
+        if (next_node != nullptr) {
+            next_node->prev.store(right_node, std::memory_order_release);
+        }
+    }
+
+    for (std::size_t i = left_count; i < keys_per_node; i++) {
+        set_val(a_node->values[i], nullptr, nullptr);
+    }
+    a_node->num_entries.store(left_count, std::memory_order_relaxed);
+    a_node->high_key.store(copy_key(separator), std::memory_order_release);
+    if (!goes_right) {
+        place_entry(a_node, key, entry, child_node);
+    }
+    a_node->right_link.store(right_node, std::memory_order_release);
+    return right_node;
+}
+
+/**
+ * Locks the parent covering separator_key of a_node, which split off
+ * right_node. That is the node a_node was reached from or one right of
+ * it, or, if the tree was lower back then, one found from the root. A
+ * split of the root grows a new root above it instead, returning null,
+ * and splits of its right siblings wait for that.
+ */
+dbindex::blinktree::node* dbindex::blinktree::blinktreeindex::lock_parent(node* a_node,
+        const std::string& separator_key, bucket_entry* separator, node* right_node, node** path) {
+    std::size_t level = a_node->level + 1;
+    for (;;) {
+        if (root_node.load(std::memory_order_acquire)->level >= level) {
+            node* parent_node = path[level];
+            if (parent_node == nullptr) {
+                std::uint64_t version;
+                parent_node = find_node(&separator_key, level, version, nullptr);
+            }
+            return lock_covering(parent_node, separator_key);
+        }
+        {
+            std::lock_guard<std::mutex> lock(root_mutex);
+            if (root_node.load(std::memory_order_relaxed) == a_node) {
+                auto new_root = new node(level);
+                new_root->first_child_node.store(a_node, std::memory_order_relaxed);
+                set_val(new_root->values[0], separator, right_node);
+                new_root->num_entries.store(1, std::memory_order_relaxed);
+                root_node.store(new_root, std::memory_order_release);
+                return nullptr;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * Removing leaves the node in place even if it gets empty, see the class
+ * comment
+ */
+void dbindex::blinktree::blinktreeindex::remove(const std::string& key) {
+    utils::epoch_manager::guard epoch_guard;
+    std::uint64_t version;
+    std::size_t index;
+    bucket_entry* found;
+    node* leaf_node = lock_covering(find_node(&key, 0, version, nullptr), key);
+    search_leaf(leaf_node, key, key_prefix_of(key.data(), key.size()), index, found);
+    if (found != nullptr) {
+        remove_entry(leaf_node, index);
+    }
+    leaf_node->lock.unlock();
+    if (found != nullptr) {
+        utils::epoch_manager::instance().retire(found);
+        entry_count--;
+    }
+}
+
+/**
+ * Passes the keys from start_key to end_key, both included, to op in
+ * ascending order, or descending for reverse scans, until op stops the
+ * scan. A leaf caught changing is read again, keys that moved right of it
+ * are found through its right-link. Going left, the prev hint is followed
+ * by moving right until reaching the leaf that links to the one just
+ * passed.
+ */
+void dbindex::blinktree::blinktreeindex::scan(const std::string& start_key,
+        const std::string* end_key, abstract_push_op& op, bool reverse_scan) {
+    utils::epoch_manager::guard epoch_guard;
+    std::string last_key;
+    bool passed_any = false;
+    std::string value;
+    bucket_entry* batch[keys_per_node];
+    std::uint64_t version;
+    node* leaf_node = find_node(reverse_scan ? end_key : &start_key, 0, version, nullptr);
+    node* from_node = nullptr;
+    for (;;) {
+        std::size_t count = entries_of(leaf_node);
+        bool torn = false;
+        for (std::size_t i = 0; i < count; i++) {
+            batch[i] = leaf_node->values[i].entry.load(std::memory_order_acquire);
+            torn |= batch[i] == nullptr;
+        }
+        bucket_entry* high_key = leaf_node->high_key.load(std::memory_order_acquire);
+        node* right_node = leaf_node->right_link.load(std::memory_order_acquire);
+        node* prev_node = leaf_node->prev.load(std::memory_order_acquire);
+        if (torn || !leaf_node->lock.validate(version)) {
+            leaf_node->lock.read_lock(version);
+            continue;
+        }
+        // Going left, the keys up to the leaf passed may have moved right, or the hint was behind
+        bool move_on = reverse_scan && (from_node != nullptr ? right_node != from_node
+                : beyond(end_key, high_key));
+        if (move_on) {
+            leaf_node = right_node;
+            leaf_node->lock.read_lock(version);
+            continue;
+        }
+
+        for (std::size_t i = 0; i < count; i++) {
+            auto target_element = batch[reverse_scan ? count - 1 - i : i];
+            if (reverse_scan) {
+                if (passed_any ? bytecomparer(target_element, last_key) >= 0
+                        : end_key != nullptr && bytecomparer(target_element, *end_key) > 0) {
+                    continue;
+                }
+                if (bytecomparer(target_element, start_key) < 0) {
+                    return;
+                }
+            } else {
+                if (passed_any ? bytecomparer(target_element, last_key) <= 0
+                        : bytecomparer(target_element, start_key) < 0) {
+                    continue;
+                }
+                if (end_key != nullptr && bytecomparer(target_element, *end_key) > 0) {
+                    return;
+                }
+            }
+            last_key.assign(target_element->key_data(), target_element->key_length);
+            passed_any = true;
+            target_element->read_value(value);
+            if (!op.invoke(target_element->key_data(), target_element->key_length, value)) {
+                //Terminate scan
+                return;
+            }
+        }
+
+        if (reverse_scan) {
+            if (prev_node == nullptr) {
+                return;
+            }
+            from_node = leaf_node;
+            leaf_node = prev_node;
+        } else {
+            if (right_node == nullptr
+                    || (end_key != nullptr && bytecomparer(high_key, *end_key) > 0)) {
+                return;
+            }
+            leaf_node = right_node;
+        }
+        leaf_node->lock.read_lock(version);
+    }
+}
+
+void dbindex::blinktree::blinktreeindex::range_scan(
+        const std::string& start_key, const std::string* end_key,
+        abstract_push_op& op) {
+    scan(start_key, end_key, op, false);
+}
+
+void dbindex::blinktree::blinktreeindex::reverse_range_scan(
+        const std::string& start_key, const std::string* end_key,
+        abstract_push_op& op) {
+    scan(start_key, end_key, op, true);
+}
+
+size_t dbindex::blinktree::blinktreeindex::size() {
+    return entry_count.load();
+}
+
+std::string dbindex::blinktree::blinktreeindex::to_string() {
+    return "blinktreeindex";
+}
+
+std::size_t dbindex::blinktree::blinktreeindex::height() {
+    return root_node.load()->level + 1;
+}
+
+std::size_t dbindex::blinktree::blinktreeindex::node_count() {
+    std::size_t count = 0;
+    for (node* level_node = root_node.load(); level_node != nullptr;
+            level_node = level_node->first_child_node.load()) {
+        for (node* a_node = level_node; a_node != nullptr; a_node = a_node->right_link.load()) {
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,157 @@
+#ifndef SRC_ORDERED_INDEX_BLINKTREEINDEX_H_
+#define SRC_ORDERED_INDEX_BLINKTREEINDEX_H_
+
+#include "../abstract_index.h"
+#include "../hash_index/bucket_entry.h"
+#include "../util/optimistic_lock.h"
+#include "key_compare.h"
+#include <atomic>
+#include <mutex>
+
+namespace dbindex {
+    namespace blinktree {
+
+        constexpr std::size_t keys_per_node = 10;
+        // Deeper than any tree of nodes split in halves can get
+        constexpr std::size_t max_height = 48;
+
+        /**
+         * Entries are immutable like in the B+tree. Leaves hold the key and
+         * value of an entry, inner nodes a separator key of their own and
+         * the child holding the keys from it up to the next separator.
+         */
+        struct node_val {
+            std::atomic<std::uint64_t> key_prefix { 0 };
+            std::atomic<bucket_entry*> entry { nullptr };
+            std::atomic<struct node*> child_node { nullptr };
+        };
+
+        /*
+         * A node holds the keys below its high key, null on the last node of
+         * a level, and links to the node right of it on its level, which
+         * holds the keys from the high key on. Leaves also link to the leaf
+         * left of them for reverse scans, which is only a hint: it may be a
+         * node further left, never one to the right.
+         */
+        struct node {
+            utils::optimistic_lock lock;
+            node_val values[keys_per_node];
+            std::atomic<std::size_t> num_entries { 0 };
+            // Keys below the first separator of an inner node
+            std::atomic<node*> first_child_node { nullptr };
+            std::atomic<bucket_entry*> high_key { nullptr };
+            std::atomic<node*> right_link { nullptr };
+            std::atomic<node*> prev { nullptr };
+            // Leaves are level 0
+            const std::size_t level;
+
+            explicit node(std::size_t _level) : level(_level) {}
+        };
+
+        /**
+         * B-link tree after Lehman and Yao, "Efficient Locking for
+         * Concurrent Operations on B-Trees": a B+tree whose nodes all have
+         * a high key and a right-link to their right sibling. A full node
+         * splits by moving
+         * its upper half to a new node right of it and lowering its high
+         * key, in one step under its own lock, and only then posts the
+         * separator to its parent under the parent's lock. Until the
+         * parent knows the new node, and for anyone who read the parent
+         * before, the keys moved there are found by moving right from the
+         * node that split: whoever reaches a node with a key at or above
+         * its high key follows the right-link. So a split never holds more
+         * than one lock and never blocks anyone going down the tree.
+         *
+         * Readers lock nothing. They note the version of a node, read it
+         * and validate the version, reading that node again if a writer got
+         * in between rather than starting over from the root. Writers go
+         * down the same way, remembering the node they left each level
+         * from, lock the leaf, move right while their key is at or above
+         * its high key, and post separators to the remembered parents,
+         * moving right there too. The root grows when its level splits.
+         *
+         * Like in the paper, removing never merges nodes: leaves can get
+         * empty and stay in the tree. That is what lets readers go on from
+         * any node they reached, as nodes live as long as the tree. Only
+         * replaced and removed entries are retired to the epoch_manager,
+         * readers hold an epoch guard. Keys are unique, inserting an
+         * existing key replaces its value.
+         */
+        class blinktreeindex: public abstract_index {
+            std::atomic<node*> root_node;
+            std::atomic<std::size_t> entry_count { 0 };
+            // Taken only to grow a new root
+            std::mutex root_mutex;
+
+            node* find_node(const std::string* key, std::size_t level,
+                    std::uint64_t& version, node** path);
+
+            node* move_right(node* a_node, const std::string* key, std::uint64_t& version);
+
+            node* child_for(node* inner_node, const std::string* key, std::uint64_t prefix);
+
+            bool search_leaf(node* leaf_node, const std::string& key,
+                    std::uint64_t prefix, std::size_t& index, bucket_entry*& found);
+
+            node* lock_covering(node* a_node, const std::string& key);
+
+            void insert_into(node* a_node, const std::string& key, bucket_entry* entry,
+                    node* child_node, node** path);
+
+            node* split_node(node* a_node, const std::string& key, bucket_entry* entry,
+                    node* child_node, bucket_entry*& separator);
+
+            node* lock_parent(node* a_node, const std::string& separator_key,
+                    bucket_entry* separator, node* right_node, node** path);
+
+            void free_level(node* leftmost_node);
+
+            void scan(const std::string& start_key, const std::string* end_key,
+                    abstract_push_op& op, bool reverse_scan);
+
+            inline int bytecomparer(const bucket_entry* entry, const std::string& key) {
+                return compare_key(entry, key);
+            }
+
+            // A null key stands for one past all keys, a null high key for the end of a level
+            inline bool beyond(const std::string* key, const bucket_entry* high_key) {
+                return high_key != nullptr && (key == nullptr || compare_key(high_key, *key) <= 0);
+            }
+
+        public:
+
+            blinktreeindex();
+
+            ~blinktreeindex();
+
+            bool get(const std::string& key, std::string& value) override;
+
+            void update(const std::string& key, const std::string& value)
+                    override;
+
+            void insert(const std::string& key, const std::string& value)
+                    override;
+
+            void remove(const std::string& key) override;
+
+            void range_scan(const std::string& start_key,
+                    const std::string* end_key, abstract_push_op&) override;
+
+            void reverse_range_scan(const std::string& start_key,
+                    const std::string* end_key, abstract_push_op&) override;
+
+            size_t size() override;
+
+            std::string to_string() override;
+
+            // Levels from the root to the leaves
+            std::size_t height();
+
+            // Leaf and inner nodes in the tree, while no writer runs
+            std::size_t node_count();
+
+        };
+    }
+}
+
+#endif /* SRC_ORDERED_INDEX_BLINKTREEINDEX_H_ */
@@ -29,154 +29,740 @@
 
 #include "bplustreeindex.h"
 
-#include "../util/exception.h"
+#include "../util/epoch_manager.h"
+
+namespace {
+    using dbindex::bucket_entry;
+    using dbindex::key_prefix_of;
+    using dbindex::bplustree::keys_per_node;
+    using dbindex::bplustree::node;
+    using dbindex::bplustree::node_val;
+
+    // Entries of a node as a reader sees them, possibly half written
+    std::size_t entries_of(const node* a_node) {
+        std::size_t count = a_node->num_entries.load(std::memory_order_relaxed);
+        return count < keys_per_node ? count : keys_per_node;
+    }
+
+    // The functions below are for writers, holding the locks of the nodes
+
+    // Child index of an inner node, the one past the last entry being right_child_node
+    std::atomic<node*>& child_at(node* inner_node, std::size_t index) {
+        if (index < inner_node->num_entries.load(std::memory_order_relaxed)) {
+            return inner_node->values[index].left_child_node;
+        }
+        return inner_node->right_child_node;
+    }
+
+    std::size_t position_of(node* inner_node, node* child_node) {
+        std::size_t count = inner_node->num_entries.load(std::memory_order_relaxed);
+        std::size_t pos = 0;
+        while (pos < count
+                && inner_node->values[pos].left_child_node.load(std::memory_order_relaxed) != child_node) {
+            pos++;
+        }
+        return pos;
+    }
+
+    void set_entry(node_val& to, bucket_entry* entry) {
+        to.key_prefix.store(entry != nullptr ? key_prefix_of(entry->key_data(), entry->key_length) : 0,
+                std::memory_order_relaxed);
+        to.entry.store(entry, std::memory_order_release);
+    }
+
+    void set_val(node_val& to, bucket_entry* entry, node* left_child_node) {
+        set_entry(to, entry);
+        to.left_child_node.store(left_child_node, std::memory_order_release);
+    }
+
+    void move_val(node_val& to, const node_val& from) {
+        to.key_prefix.store(from.key_prefix.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.entry.store(from.entry.load(std::memory_order_relaxed), std::memory_order_release);
+        to.left_child_node.store(from.left_child_node.load(std::memory_order_relaxed),
+                std::memory_order_release);
+    }
+
+    // Opens a gap at index of the count entries
+    void shift_right(node* a_node, std::size_t index, std::size_t count) {
+        for (std::size_t i = count; i > index; i--) {
+            move_val(a_node->values[i], a_node->values[i - 1]);
+        }
+    }
+
+    // Closes the gap at index of the count entries, clearing the last one
+    void shift_left(node* a_node, std::size_t index, std::size_t count) {
+        for (std::size_t i = index + 1; i < count; i++) {
+            move_val(a_node->values[i - 1], a_node->values[i]);
+        }
+        set_val(a_node->values[count - 1], nullptr, nullptr);
+    }
+
+    /*
+     * Places separator with left_node as its left child at pos of an
+     * inner node, whose pointer to left_node, the left child of entry pos
+     * or right_child_node, then points to right_node.
+     */
+    void place_separator(node* inner_node, std::size_t pos, bucket_entry* separator,
+            node* left_node, node* right_node) {
+        std::size_t count = inner_node->num_entries.load(std::memory_order_relaxed);
+        shift_right(inner_node, pos, count);
+        set_val(inner_node->values[pos], separator, left_node);
+        if (pos < count) {
+            inner_node->values[pos + 1].left_child_node.store(right_node, std::memory_order_release);
+        } else {
+            inner_node->right_child_node.store(right_node, std::memory_order_release);
+        }
+        inner_node->num_entries.store(count + 1, std::memory_order_relaxed);
+    }
+
+    /*
+     * Removes the entry at index of an inner node together with its right
+     * child, which was merged into the left child of the entry
+     */
+    void remove_separator(node* inner_node, std::size_t index) {
+        std::size_t count = inner_node->num_entries.load(std::memory_order_relaxed);
+        child_at(inner_node, index + 1).store(
+                inner_node->values[index].left_child_node.load(std::memory_order_relaxed),
+                std::memory_order_release);
+        shift_left(inner_node, index, count);
+        inner_node->num_entries.store(count - 1, std::memory_order_relaxed);
+    }
+
+    // A copy of the key of the first entry of a leaf, which may be removed while the separator stays
+    bucket_entry* separator_for(const node* leaf_node) {
+        return bucket_entry::create(0,
+                leaf_node->values[0].entry.load(std::memory_order_relaxed)->key(), "");
+    }
+}
+
+dbindex::bplustree::bplustreeindex::bplustreeindex() : root_node(new node(true)) {
+}
+
+dbindex::bplustree::bplustreeindex::~bplustreeindex() {
+    free_subtree(root_node.load());
+}
+
+void dbindex::bplustree::bplustreeindex::free_subtree(node* a_node) {
+    for (std::size_t i = 0; i < a_node->num_entries.load(); i++) {
+        delete a_node->values[i].entry.load();
+        if (!a_node->is_leaf_node) {
+            free_subtree(a_node->values[i].left_child_node.load());
+        }
+    }
+    if (!a_node->is_leaf_node) {
+        free_subtree(a_node->right_child_node.load());
+    }
+    delete a_node;
+}
 
 /**
- * Returns the leaf node that can contain the value
+ * Goes down optimistically to the leaf that can contain key, the last
+ * leaf for a null key, and notes its version. Null if a writer got in the
+ * way and the caller has to start over
  */
 dbindex::bplustree::node* dbindex::bplustree::bplustreeindex::find_leaf_node_with_key(
-        const std::string& key, node* start_node) {
-    if (start_node == nullptr || start_node->is_leaf_node) {
-        return start_node;
+        const std::string* key, std::uint64_t& version) {
+    std::uint64_t prefix = key != nullptr ? key_prefix_of(key->data(), key->size()) : 0;
+    node* cur_node = root_node.load(std::memory_order_acquire);
+    if (!cur_node->lock.read_lock(version)
+            || cur_node != root_node.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    while (!cur_node->is_leaf_node) {
+        std::size_t pos;
+        std::uint64_t child_version;
+        node* child_node = child_for(cur_node, key, prefix, pos);
+        if (child_node == nullptr || !child_node->lock.read_lock(child_version)
+                || !cur_node->lock.validate(version)) {
+            return nullptr;
+        }
+        cur_node = child_node;
+        version = child_version;
     }
+    return cur_node;
+}
 
-    for (std::size_t i = 0; i < start_node->num_entries; i++) {
-        auto comparison_result = bytecomparer(key, start_node->values[i].key);
-        if (comparison_result < 0) {
-            //Look at the left subtree
-            return find_leaf_node_with_key(key,
-                    start_node->values[i].left_child_node);
+/**
+ * The child of an inner node to look for key, whose prefix is given, in,
+ * the last one for a null key, and its position. Null if the node was
+ * caught half written
+ */
+dbindex::bplustree::node* dbindex::bplustree::bplustreeindex::child_for(
+        node* inner_node, const std::string* key, std::uint64_t prefix, std::size_t& pos) {
+    std::size_t count = entries_of(inner_node);
+    for (pos = 0; key != nullptr && pos < count; pos++) {
+        std::uint64_t entry_prefix = inner_node->values[pos].key_prefix.load(std::memory_order_relaxed);
+        if (entry_prefix < prefix) {
+            continue;
+        }
+        if (entry_prefix == prefix) {
+            bucket_entry* entry = inner_node->values[pos].entry.load(std::memory_order_acquire);
+            if (entry == nullptr) {
+                return nullptr;
+            }
+            if (bytecomparer(entry, *key) <= 0) {
+                continue;
+            }
         }
+        //Look at the left subtree
+        return inner_node->values[pos].left_child_node.load(std::memory_order_acquire);
     }
     //Did not find it in the left child entries per node_val must look at the rightmost entry
-    return find_leaf_node_with_key(key, start_node->right_child_node);
+    return inner_node->right_child_node.load(std::memory_order_acquire);
 }
 
-bool dbindex::bplustree::bplustreeindex::get(const std::string& key,
-        std::string& value) {
-    auto leaf_node_with_key = find_leaf_node_with_key(key, root_node);
-    if (leaf_node_with_key == nullptr) {
-        return false;
+/**
+ * Finds the index of the first key of the leaf not below key, whose
+ * prefix is given, and its entry if it is key. False if the leaf was
+ * caught half written
+ */
+bool dbindex::bplustree::bplustreeindex::search_leaf(node* leaf_node,
+        const std::string& key, std::uint64_t prefix, std::size_t& index, bucket_entry*& found) {
+    std::size_t count = entries_of(leaf_node);
+    found = nullptr;
+    for (index = 0; index < count; index++) {
+        std::uint64_t entry_prefix = leaf_node->values[index].key_prefix.load(std::memory_order_relaxed);
+        if (entry_prefix < prefix) {
+            continue;
+        }
+        if (entry_prefix > prefix) {
+            break;
+        }
+        bucket_entry* entry = leaf_node->values[index].entry.load(std::memory_order_acquire);
+        if (entry == nullptr) {
+            return false;
+        }
+        auto comparison_result = bytecomparer(entry, key);
+        if (comparison_result >= 0) {
+            if (comparison_result == 0) {
+                found = entry;
+            }
+            break;
+        }
     }
+    return true;
+}
 
-    for (std::size_t i = 0; i < leaf_node_with_key->num_entries; i++) {
-        auto& target_element = leaf_node_with_key->values[i];
-        auto comparison_result = bytecomparer(key, target_element.key);
-        if (comparison_result == 0) {
+bool dbindex::bplustree::bplustreeindex::get(const std::string& key,
+        std::string& value) {
+    utils::epoch_manager::guard epoch_guard;
+    for (;;) {
+        std::uint64_t version;
+        std::size_t index;
+        bucket_entry* found;
+        auto leaf_node_with_key = find_leaf_node_with_key(&key, version);
+        if (leaf_node_with_key == nullptr
+                || !search_leaf(leaf_node_with_key, key, key_prefix_of(key.data(), key.size()), index, found)
+                || !leaf_node_with_key->lock.validate(version)) {
+            continue;
+        }
+        if (found != nullptr) {
             //Found copy and return
-            value.assign(target_element.value);
-            return true;
+            found->read_value(value);
         }
+        return found != nullptr;
     }
-    return false;
 }
 
-void dbindex::bplustree::bplustreeindex::update(const std::string& key,
-        const std::string& value) {
-    auto leaf_node_with_key = find_leaf_node_with_key(key, root_node);
-    if (leaf_node_with_key == nullptr) {
-        throw std::invalid_argument("Key not found");
+// Replaces the entry at index of a leaf with one holding the new value, false if the leaf changed
+bool dbindex::bplustree::bplustreeindex::replace_entry(node* leaf_node,
+        std::uint64_t version, std::size_t index, const std::string& key,
+        const std::string& value, bucket_entry* old_entry) {
+    if (!leaf_node->lock.upgrade(version)) {
+        return false;
     }
+    leaf_node->values[index].entry.store(bucket_entry::create(0, key, value),
+            std::memory_order_release);
+    leaf_node->lock.unlock();
+    utils::epoch_manager::instance().retire(old_entry);
+    return true;
+}
 
-    for (std::size_t i = 0; i < leaf_node_with_key->num_entries; i++) {
-        auto& target_element = leaf_node_with_key->values[i];
-        auto comparison_result = bytecomparer(key, target_element.key);
-        if (comparison_result == 0) {
-            target_element.value.assign(value);
+/**
+ * Like the hash indexes, ignores keys that are not present
+ */
+void dbindex::bplustree::bplustreeindex::update(const std::string& key,
+        const std::string& value) {
+    utils::epoch_manager::guard epoch_guard;
+    for (;;) {
+        std::uint64_t version;
+        std::size_t index;
+        bucket_entry* found;
+        auto leaf_node_with_key = find_leaf_node_with_key(&key, version);
+        if (leaf_node_with_key == nullptr
+                || !search_leaf(leaf_node_with_key, key, key_prefix_of(key.data(), key.size()), index, found)) {
+            continue;
+        }
+        if (found == nullptr) {
+            if (leaf_node_with_key->lock.validate(version)) {
+                return;
+            }
+            continue;
+        }
+        if (replace_entry(leaf_node_with_key, version, index, key, value, found)) {
             return;
         }
     }
-    throw std::invalid_argument("Key not found");
 }
 
 void dbindex::bplustree::bplustreeindex::insert(const std::string& key,
         const std::string& value) {
-    throw util::not_implemented_exception();
+    utils::epoch_manager::guard epoch_guard;
+    while (!try_insert(key, value)) {
+    }
+}
+
+/**
+ * One attempt at inserting, false if it has to start over. Full nodes on
+ * the way down are split first, which also starts over, so the parent of
+ * a node being split always has room for the separator.
+ */
+bool dbindex::bplustree::bplustreeindex::try_insert(const std::string& key,
+        const std::string& value) {
+    std::uint64_t prefix = key_prefix_of(key.data(), key.size());
+    std::uint64_t version;
+    node* cur_node = root_node.load(std::memory_order_acquire);
+    if (!cur_node->lock.read_lock(version)
+            || cur_node != root_node.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    node* parent_node = nullptr;
+    std::uint64_t parent_version = 0;
+    while (!cur_node->is_leaf_node) {
+        if (entries_of(cur_node) == keys_per_node) {
+            split_node(parent_node, parent_version, cur_node, version);
+            return false;
+        }
+        std::size_t pos;
+        std::uint64_t child_version;
+        node* child_node = child_for(cur_node, &key, prefix, pos);
+        if (child_node == nullptr || !child_node->lock.read_lock(child_version)
+                || !cur_node->lock.validate(version)) {
+            return false;
+        }
+        parent_node = cur_node;
+        parent_version = version;
+        cur_node = child_node;
+        version = child_version;
+    }
+
+    std::size_t index;
+    bucket_entry* found;
+    if (!search_leaf(cur_node, key, prefix, index, found)) {
+        return false;
+    }
+    if (found != nullptr) {
+        return replace_entry(cur_node, version, index, key, value, found);
+    }
+    if (entries_of(cur_node) == keys_per_node) {
+        split_node(parent_node, parent_version, cur_node, version);
+        return false;
+    }
+
+    if (!cur_node->lock.upgrade(version)) {
+        return false;
+    }
+    std::size_t count = cur_node->num_entries.load(std::memory_order_relaxed);
+    shift_right(cur_node, index, count);
+    set_val(cur_node->values[index], bucket_entry::create(0, key, value), nullptr);
+    cur_node->num_entries.store(count + 1, std::memory_order_relaxed);
+    cur_node->lock.unlock();
+    entry_count++;
+    return true;
+}
+
+/**
+ * Splits the full a_node into two halves if neither it nor its parent,
+ * null for the root, changed since their versions were noted. A leaf
+ * copies the first key of the right half up and is linked to the new
+ * leaf, whose next leaf is locked for its prev link. An inner node pushes
+ * its middle key up. Splitting the root grows a new root above it.
+ */
+void dbindex::bplustree::bplustreeindex::split_node(node* parent_node,
+        std::uint64_t parent_version, node* a_node, std::uint64_t version) {
+    if (parent_node != nullptr && !parent_node->lock.upgrade(parent_version)) {
+        return;
+    }
+    if (!a_node->lock.upgrade(version)) {
+        if (parent_node != nullptr) {
+            parent_node->lock.unlock();
+        }
+        return;
+    }
+    node* next_node = a_node->is_leaf_node ? a_node->next.load(std::memory_order_relaxed) : nullptr;
+    if (next_node != nullptr && !next_node->lock.try_lock()) {
+        a_node->lock.unlock();
+        if (parent_node != nullptr) {
+            parent_node->lock.unlock();
+        }
+        return;
+    }
+
+    auto right_node = new node(a_node->is_leaf_node);
+    bucket_entry* separator;
+    if (a_node->is_leaf_node) {
+        std::size_t left_count = keys_per_node / 2;
+        for (std::size_t i = left_count; i < keys_per_node; i++) {
+            move_val(right_node->values[i - left_count], a_node->values[i]);
+        }
+        right_node->num_entries.store(keys_per_node - left_count, std::memory_order_relaxed);
+        right_node->prev.store(a_node, std::memory_order_relaxed);
+        right_node->next.store(next_node, std::memory_order_relaxed);
+        for (std::size_t i = left_count; i < keys_per_node; i++) {
+            set_val(a_node->values[i], nullptr, nullptr);
+        }
+        a_node->num_entries.store(left_count, std::memory_order_relaxed);
+        separator = separator_for(right_node);
+        if (next_node != nullptr) {
+            next_node->prev.store(right_node, std::memory_order_release);
+        }
+        a_node->next.store(right_node, std::memory_order_release);
+    } else {
+        // The middle entry moves up, its left child becoming the rightmost one of the left half
+        std::size_t middle = keys_per_node / 2;
+        separator = a_node->values[middle].entry.load(std::memory_order_relaxed);
+        for (std::size_t i = middle + 1; i < keys_per_node; i++) {
+            move_val(right_node->values[i - middle - 1], a_node->values[i]);
+        }
+        right_node->right_child_node.store(
+                a_node->right_child_node.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        right_node->num_entries.store(keys_per_node - middle - 1, std::memory_order_relaxed);
+        a_node->right_child_node.store(
+                a_node->values[middle].left_child_node.load(std::memory_order_relaxed),
+                std::memory_order_release);
+        for (std::size_t i = middle; i < keys_per_node; i++) {
+            set_val(a_node->values[i], nullptr, nullptr);
+        }
+        a_node->num_entries.store(middle, std::memory_order_relaxed);
+    }
+
+    if (parent_node != nullptr) {
+        place_separator(parent_node, position_of(parent_node, a_node), separator, a_node, right_node);
+    } else {
+        auto new_root = new node(false);
+        set_val(new_root->values[0], separator, a_node);
+        new_root->right_child_node.store(right_node, std::memory_order_relaxed);
+        new_root->num_entries.store(1, std::memory_order_relaxed);
+        root_node.store(new_root, std::memory_order_release);
+    }
+
+    if (next_node != nullptr) {
+        next_node->lock.unlock();
+    }
+    a_node->lock.unlock();
+    if (parent_node != nullptr) {
+        parent_node->lock.unlock();
+    }
 }
 
 void dbindex::bplustree::bplustreeindex::remove(const std::string& key) {
-    std::string empty_value { "" };
-    update(key, empty_value);
-}
-
-void dbindex::bplustree::bplustreeindex::scan_till_key(node* cur_leaf_node,
-        size_t index_in_leaf_node, abstract_push_op& op,
-        const std::string* end_key, bool reverse_scan) {
-    size_t step_by = reverse_scan ? -1 : 1;
-
-    while (cur_leaf_node != nullptr) {
-        //Simulate both forward and backward loop with step_by
-        for (std::size_t i = index_in_leaf_node;
-                i < cur_leaf_node->num_entries && i >= 0; i += step_by) {
-            auto& target_element = cur_leaf_node->values[i];
-            auto comparison_result = bytecomparer(target_element.value,
-                    end_key);
-            if (reverse_scan) {
-                if (comparison_result < 0) {
-                    return;
-                }
-            } else {
-                if (comparison_result > 0) {
-                    return;
-                }
-            }
-            if (!op.invoke(target_element.key.data(), target_element.key.size(),
-                    target_element.value)) {
-                //Terminate scan
-                return;
-            }
+    utils::epoch_manager::guard epoch_guard;
+    while (!try_remove(key)) {
+    }
+}
+
+/**
+ * One attempt at removing, false if it has to start over. Children at
+ * their minimum on the way down are refilled first, leaves only if they
+ * hold the key, which also starts over, so the removal and any merge
+ * below a node never leave it underfull.
+ */
+bool dbindex::bplustree::bplustreeindex::try_remove(const std::string& key) {
+    std::uint64_t prefix = key_prefix_of(key.data(), key.size());
+    std::uint64_t version;
+    node* cur_node = root_node.load(std::memory_order_acquire);
+    if (!cur_node->lock.read_lock(version)
+            || cur_node != root_node.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    std::size_t index;
+    bucket_entry* found;
+    while (!cur_node->is_leaf_node) {
+        std::size_t pos;
+        std::uint64_t child_version;
+        node* child_node = child_for(cur_node, &key, prefix, pos);
+        if (child_node == nullptr || !child_node->lock.read_lock(child_version)
+                || !cur_node->lock.validate(version)) {
+            return false;
         }
-        //Get to the next leaf node
-        if (reverse_scan) {
-            cur_leaf_node = cur_leaf_node->prev;
-            index_in_leaf_node = cur_leaf_node->num_entries - 1;
+        bool at_minimum;
+        if (child_node->is_leaf_node) {
+            if (!search_leaf(child_node, key, prefix, index, found)) {
+                return false;
+            }
+            at_minimum = found != nullptr && entries_of(child_node) <= min_leaf_entries;
         } else {
-            cur_leaf_node = cur_leaf_node->next;
-            index_in_leaf_node = 0;
+            at_minimum = entries_of(child_node) <= min_inner_entries;
+        }
+        if (at_minimum) {
+            rebalance_child(cur_node, version, pos, child_node, child_version);
+            return false;
         }
+        cur_node = child_node;
+        version = child_version;
     }
+
+    if (!search_leaf(cur_node, key, prefix, index, found)) {
+        return false;
+    }
+    if (found == nullptr) {
+        return cur_node->lock.validate(version);
+    }
+    if (!cur_node->lock.upgrade(version)) {
+        return false;
+    }
+    std::size_t count = cur_node->num_entries.load(std::memory_order_relaxed);
+    shift_left(cur_node, index, count);
+    cur_node->num_entries.store(count - 1, std::memory_order_relaxed);
+    cur_node->lock.unlock();
+    utils::epoch_manager::instance().retire(found);
+    entry_count--;
+    return true;
 }
 
-void dbindex::bplustree::bplustreeindex::range_scan(
-        const std::string& start_key, const std::string* end_key,
-        abstract_push_op& op) {
-    auto leaf_node_with_key = find_leaf_node_with_key(start_key, root_node);
+/**
+ * Refills child_node at pos of parent_node if neither changed since their
+ * versions were noted: it borrows an entry from its left sibling, or the
+ * right one for the first child, while that has more than the minimum,
+ * and otherwise merges with it into the left one. Leaves move an entry
+ * and copy the new first key of the right one up, inner nodes rotate it
+ * through the separator. A merge takes the separator out of the parent
+ * and, for leaves, locks the next leaf for its prev link. A root left
+ * without entries gives way to its only child.
+ */
+void dbindex::bplustree::bplustreeindex::rebalance_child(node* parent_node,
+        std::uint64_t parent_version, std::size_t pos, node* child_node,
+        std::uint64_t child_version) {
+    if (!parent_node->lock.upgrade(parent_version)) {
+        return;
+    }
+    if (!child_node->lock.upgrade(child_version)) {
+        parent_node->lock.unlock();
+        return;
+    }
+    // The separator between child_node and its sibling, and which of them is left
+    std::size_t separator = pos > 0 ? pos - 1 : pos;
+    auto left_node = child_at(parent_node, separator).load(std::memory_order_relaxed);
+    auto right_node = child_at(parent_node, separator + 1).load(std::memory_order_relaxed);
+    auto sibling_node = left_node == child_node ? right_node : left_node;
+    if (!sibling_node->lock.try_lock()) {
+        child_node->lock.unlock();
+        parent_node->lock.unlock();
+        return;
+    }
 
-    if (leaf_node_with_key == nullptr) {
+    bool is_leaf_node = child_node->is_leaf_node;
+    auto separator_entry = parent_node->values[separator].entry.load(std::memory_order_relaxed);
+    std::size_t left_count = left_node->num_entries.load(std::memory_order_relaxed);
+    std::size_t right_count = right_node->num_entries.load(std::memory_order_relaxed);
+    std::size_t sibling_count = sibling_node == left_node ? left_count : right_count;
+    if (sibling_count > (is_leaf_node ? min_leaf_entries : min_inner_entries)) {
+        if (sibling_node == left_node) {
+            shift_right(right_node, 0, right_count);
+            if (is_leaf_node) {
+                move_val(right_node->values[0], left_node->values[left_count - 1]);
+            } else {
+                // The separator comes down in front, the last key of the left sibling goes up
+                set_val(right_node->values[0], separator_entry,
+                        left_node->right_child_node.load(std::memory_order_relaxed));
+                left_node->right_child_node.store(
+                        left_node->values[left_count - 1].left_child_node.load(std::memory_order_relaxed),
+                        std::memory_order_release);
+            }
+            right_node->num_entries.store(right_count + 1, std::memory_order_relaxed);
+            auto new_separator = is_leaf_node ? separator_for(right_node)
+                    : left_node->values[left_count - 1].entry.load(std::memory_order_relaxed);
+            set_entry(parent_node->values[separator], new_separator);
+            set_val(left_node->values[left_count - 1], nullptr, nullptr);
+            left_node->num_entries.store(left_count - 1, std::memory_order_relaxed);
+        } else {
+            if (is_leaf_node) {
+                move_val(left_node->values[left_count], right_node->values[0]);
+            } else {
+                // The separator comes down behind, the first key of the right sibling goes up
+                set_val(left_node->values[left_count], separator_entry,
+                        left_node->right_child_node.load(std::memory_order_relaxed));
+                left_node->right_child_node.store(
+                        right_node->values[0].left_child_node.load(std::memory_order_relaxed),
+                        std::memory_order_release);
+                set_entry(parent_node->values[separator],
+                        right_node->values[0].entry.load(std::memory_order_relaxed));
+            }
+            left_node->num_entries.store(left_count + 1, std::memory_order_relaxed);
+            shift_left(right_node, 0, right_count);
+            right_node->num_entries.store(right_count - 1, std::memory_order_relaxed);
+            if (is_leaf_node) {
+                set_entry(parent_node->values[separator], separator_for(right_node));
+            }
+        }
+        if (is_leaf_node) {
+            utils::epoch_manager::instance().retire(separator_entry);
+        }
+        sibling_node->lock.unlock();
+        child_node->lock.unlock();
+        parent_node->lock.unlock();
         return;
     }
 
-    while (leaf_node_with_key != nullptr) {
-        for (std::size_t i = 0; i < leaf_node_with_key->num_entries; i++) {
-            auto& cur_element = leaf_node_with_key->values[i];
-            auto comparison_result = bytecomparer(start_key, cur_element.key);
-            if (comparison_result >= 0) {
-                scan_till_key(leaf_node_with_key, i, op, end_key);
+    node* next_node = is_leaf_node ? right_node->next.load(std::memory_order_relaxed) : nullptr;
+    if (next_node != nullptr && !next_node->lock.try_lock()) {
+        sibling_node->lock.unlock();
+        child_node->lock.unlock();
+        parent_node->lock.unlock();
+        return;
+    }
+
+    // Merging into the left node, inner nodes take the separator along
+    if (!is_leaf_node) {
+        set_val(left_node->values[left_count++], separator_entry,
+                left_node->right_child_node.load(std::memory_order_relaxed));
+        left_node->right_child_node.store(
+                right_node->right_child_node.load(std::memory_order_relaxed), std::memory_order_release);
+    }
+    for (std::size_t i = 0; i < right_count; i++) {
+        move_val(left_node->values[left_count++], right_node->values[i]);
+    }
+    left_node->num_entries.store(left_count, std::memory_order_relaxed);
+    if (is_leaf_node) {
+        left_node->next.store(next_node, std::memory_order_release);
+        if (next_node != nullptr) {
+            next_node->prev.store(left_node, std::memory_order_release);
+            next_node->lock.unlock();
+        }
+        utils::epoch_manager::instance().retire(separator_entry);
+    }
+    remove_separator(parent_node, separator);
+    right_node->lock.unlock_obsolete();
+    utils::epoch_manager::instance().retire(right_node);
+    left_node->lock.unlock();
+
+    if (parent_node->num_entries.load(std::memory_order_relaxed) == 0
+            && parent_node == root_node.load(std::memory_order_relaxed)) {
+        root_node.store(left_node, std::memory_order_release);
+        parent_node->lock.unlock_obsolete();
+        utils::epoch_manager::instance().retire(parent_node);
+    } else {
+        parent_node->lock.unlock();
+    }
+}
+
+/**
+ * Passes the keys from start_key to end_key, both included, to op in
+ * ascending order, or descending for reverse scans, until op stops the
+ * scan. Leaves are coupled like the levels of a descent: the next one is
+ * noted before the current one is validated, and must still link back to
+ * it. A restart resumes after the last key passed on.
+ */
+void dbindex::bplustree::bplustreeindex::scan(const std::string& start_key,
+        const std::string* end_key, abstract_push_op& op, bool reverse_scan) {
+    utils::epoch_manager::guard epoch_guard;
+    std::string last_key;
+    bool passed_any = false;
+    std::string value;
+    bucket_entry* batch[keys_per_node];
+    for (;;) {
+        std::uint64_t version;
+        const std::string* descend_key = passed_any ? &last_key : reverse_scan ? end_key : &start_key;
+        auto leaf_node = find_leaf_node_with_key(descend_key, version);
+        node* from_node = nullptr;
+        while (leaf_node != nullptr) {
+            std::size_t count = entries_of(leaf_node);
+            bool torn = false;
+            for (std::size_t i = 0; i < count; i++) {
+                batch[i] = leaf_node->values[i].entry.load(std::memory_order_acquire);
+                torn |= batch[i] == nullptr;
+            }
+            node* back_node = (reverse_scan ? leaf_node->next : leaf_node->prev).load(std::memory_order_acquire);
+            node* next_node = (reverse_scan ? leaf_node->prev : leaf_node->next).load(std::memory_order_acquire);
+            if (torn || (from_node != nullptr && back_node != from_node)
+                    || !leaf_node->lock.validate(version)) {
+                break;
+            }
+
+            for (std::size_t i = 0; i < count; i++) {
+                auto target_element = batch[reverse_scan ? count - 1 - i : i];
+                if (reverse_scan) {
+                    if (passed_any ? bytecomparer(target_element, last_key) >= 0
+                            : bytecomparer(target_element, end_key) > 0) {
+                        continue;
+                    }
+                    if (bytecomparer(target_element, start_key) < 0) {
+                        return;
+                    }
+                } else {
+                    if (passed_any ? bytecomparer(target_element, last_key) <= 0
+                            : bytecomparer(target_element, start_key) < 0) {
+                        continue;
+                    }
+                    if (bytecomparer(target_element, end_key) > 0) {
+                        return;
+                    }
+                }
+                last_key.assign(target_element->key_data(), target_element->key_length);
+                passed_any = true;
+                target_element->read_value(value);
+                if (!op.invoke(target_element->key_data(), target_element->key_length, value)) {
+                    //Terminate scan
+                    return;
+                }
+            }
+
+            if (next_node == nullptr) {
                 return;
             }
+            std::uint64_t next_version;
+            if (!next_node->lock.read_lock(next_version) || !leaf_node->lock.validate(version)) {
+                break;
+            }
+            from_node = leaf_node;
+            leaf_node = next_node;
+            version = next_version;
         }
     }
 }
 
+void dbindex::bplustree::bplustreeindex::range_scan(
+        const std::string& start_key, const std::string* end_key,
+        abstract_push_op& op) {
+    scan(start_key, end_key, op, false);
+}
+
 void dbindex::bplustree::bplustreeindex::reverse_range_scan(
         const std::string& start_key, const std::string* end_key,
         abstract_push_op& op) {
-    auto leaf_node_with_key = find_leaf_node_with_key(start_key, root_node);
+    scan(start_key, end_key, op, true);
+}
 
-    if (leaf_node_with_key == nullptr) {
-        return;
-    }
+size_t dbindex::bplustree::bplustreeindex::size() {
+    return entry_count.load();
+}
 
-    while (leaf_node_with_key != nullptr) {
-        for (std::size_t i = leaf_node_with_key->num_entries - 1; i >= 0; i--) {
-            auto& cur_element = leaf_node_with_key->values[i];
-            auto comparison_result = bytecomparer(cur_element.key, start_key);
-            if (comparison_result <= 0) {
-                scan_till_key(leaf_node_with_key, i, op, end_key);
-                return;
-            }
+std::string dbindex::bplustree::bplustreeindex::to_string() {
+    return "bplustreeindex";
+}
+
+std::size_t dbindex::bplustree::bplustreeindex::count_nodes(node* a_node) {
+    std::size_t count = 1;
+    if (!a_node->is_leaf_node) {
+        for (std::size_t i = 0; i < a_node->num_entries.load(); i++) {
+            count += count_nodes(a_node->values[i].left_child_node.load());
         }
+        count += count_nodes(a_node->right_child_node.load());
     }
+    return count;
+}
 
+std::size_t dbindex::bplustree::bplustreeindex::node_count() {
+    return count_nodes(root_node.load());
 }
 
+std::size_t dbindex::bplustree::bplustreeindex::height() {
+    std::size_t levels = 1;
+    for (node* cur_node = root_node.load(); !cur_node->is_leaf_node;
+            cur_node = cur_node->right_child_node.load()) {
+        levels++;
+    }
+    return levels;
+}
@@ -30,7 +30,11 @@
 #define SRC_ORDERED_INDEX_BPLUSTREEINDEX_H_
 
 #include "../abstract_index.h"
-#include <cstring>
+#include "../hash_index/bucket_entry.h"
+#include "../util/optimistic_lock.h"
+#include "key_compare.h"
+#include <atomic>
+#include <vector>
 
 namespace dbindex {
     namespace bplustree {
@@ -39,51 +43,114 @@ namespace dbindex {
         //Forward declare to break cyclic dependency
 
         constexpr std::size_t keys_per_node = 10;
-
+        // Below this many entries a node other than the root borrows or merges. A
+        // leaf at the minimum merges with one at the minimum into a full leaf, an
+        // inner node also takes the separator between them along.
+        constexpr std::size_t min_leaf_entries = keys_per_node / 2;
+        constexpr std::size_t min_inner_entries = (keys_per_node - 1) / 2;
+
+        /**
+         * Entries are immutable, so that optimistic readers never see a key
+         * or value being modified. Leaves hold the key and value of an
+         * entry, inner nodes a separator key of their own.
+         */
         struct node_val {
-            std::string key;
-            std::string value;
-            node* left_child_node { nullptr };
+            std::atomic<std::uint64_t> key_prefix { 0 };
+            std::atomic<bucket_entry*> entry { nullptr };
+            std::atomic<node*> left_child_node { nullptr };
         };
 
         struct node {
+            utils::optimistic_lock lock;
             node_val values[keys_per_node];
-            std::size_t num_entries { 0 };
-            node* right_child_node { nullptr };
-            node* prev { nullptr };
-            node* next { nullptr };
-            bool is_leaf_node { false };
-            bool is_full { false };
+            std::atomic<std::size_t> num_entries { 0 };
+            std::atomic<node*> right_child_node { nullptr };
+            std::atomic<node*> prev { nullptr };
+            std::atomic<node*> next { nullptr };
+            const bool is_leaf_node;
+
+            explicit node(bool _is_leaf_node) : is_leaf_node(_is_leaf_node) {}
         };
 
+        /**
+         * B+tree with the entries in the leaves, which are linked both ways
+         * for the scans. An inner node routes keys smaller than the key of
+         * entry i to its left child and all others to right_child_node. A
+         * full leaf splits into two halves and copies the first key of the
+         * right half up to its parent, a full inner node pushes its middle
+         * key up, and splitting the root grows the tree by a level.
+         * Removing works the other way round: a node with fewer than the
+         * minimum entries borrows one from a sibling or merges with it, and
+         * a root left with a single child is replaced by it. An empty tree
+         * is a single empty leaf.
+         *
+         * Keys are unique, inserting an existing key replaces its value.
+         *
+         * Concurrency is optimistic lock coupling: every node has a version
+         * lock, readers go down the tree and along the leaves noting
+         * versions without writing anything, validate each node before
+         * moving on and restart when a writer got in between. Writers lock
+         * only the nodes they modify. Inserts split full nodes and removes
+         * refill nodes at their minimum on the way down, so a change never
+         * spreads past the parent: an insert splitting a node locks it and
+         * its parent, a remove refilling one locks it, its parent and the
+         * sibling, and leaf splits and merges also the next leaf, whose prev
+         * link changes. Scans resume after the last key they passed on when
+         * they restart. Nodes and entries taken out of the tree are retired
+         * to the epoch_manager, readers hold an epoch guard.
+         */
         class bplustreeindex: public abstract_index {
-            node* root_node { nullptr };
+            std::atomic<node*> root_node;
+            std::atomic<std::size_t> entry_count { 0 };
+
+            node* find_leaf_node_with_key(const std::string* key, std::uint64_t& version);
+
+            node* child_for(node* inner_node, const std::string* key,
+                    std::uint64_t prefix, std::size_t& pos);
+
+            bool search_leaf(node* leaf_node, const std::string& key,
+                    std::uint64_t prefix, std::size_t& index, bucket_entry*& found);
+
+            bool try_insert(const std::string& key, const std::string& value);
+
+            bool try_remove(const std::string& key);
+
+            bool replace_entry(node* leaf_node, std::uint64_t version, std::size_t index,
+                    const std::string& key, const std::string& value, bucket_entry* old_entry);
+
+            void split_node(node* parent_node, std::uint64_t parent_version,
+                    node* a_node, std::uint64_t version);
 
-            node* find_leaf_node_with_key(const std::string& key, node* a_node);
+            void rebalance_child(node* parent_node, std::uint64_t parent_version,
+                    std::size_t pos, node* child_node, std::uint64_t child_version);
 
-            void scan_till_key(node* leaf_node, size_t index_in_leaf_node,
-                    abstract_push_op&, const std::string* end_key, bool reverse_scan = false);
+            void free_subtree(node* a_node);
 
-            inline int bytecomparer(const std::string& key1,
-                    const std::string& key2) {
-                auto min_key_length =
-                        key1.size() < key2.size() ? key1.size() : key2.size();
-                return std::memcmp(key1.data(), key2.data(), min_key_length);
+            std::size_t count_nodes(node* a_node);
+
+            void scan(const std::string& start_key, const std::string* end_key,
+                    abstract_push_op& op, bool reverse_scan);
+
+            inline int bytecomparer(const bucket_entry* entry,
+                    const std::string& key) {
+                return compare_key(entry, key);
             }
 
-            inline int bytecomparer(const std::string& key1,
-                    const std::string* key2) {
-                if (key2 == nullptr) {
+            inline int bytecomparer(const bucket_entry* entry,
+                    const std::string* key) {
+                if (key == nullptr) {
                     //Nullptr represents last key present
                     return -1;
                 }
-                auto min_key_length =
-                        key1.size() < key2->size() ? key1.size() : key2->size();
-                return std::memcmp(key1.data(), key2->data(), min_key_length);
+                return bytecomparer(entry, *key);
             }
 
         public:
 
+            bplustreeindex();
+
+            ~bplustreeindex();
+
             bool get(const std::string& key, std::string& value) override;
 
             void update(const std::string& key, const std::string& value)
@@ -100,6 +167,16 @@ namespace dbindex {
             void reverse_range_scan(const std::string& start_key,
                     const std::string* end_key, abstract_push_op&) override;
 
+            size_t size() override;
+
+            std::string to_string() override;
+
+            // Levels from the root to the leaves, while no writer runs
+            std::size_t height();
+
+            // Leaf and inner nodes in the tree, while no writer runs
+            std::size_t node_count();
+
         };
     }
 }
@@ -0,0 +1,707 @@
+#include "bwtreeindex.h"
+
+#include "../util/epoch_manager.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    using dbindex::bucket_entry;
+    using dbindex::compare_key;
+    using dbindex::key_prefix_of;
+    using namespace dbindex::bwtree;
+
+    enum class route_result { here, down, right };
+
+    // Orders entries like compare_key orders an entry and a key
+    bool entry_less(const bucket_entry* a, const bucket_entry* b) {
+        auto min_key_length = a->key_length < b->key_length ? a->key_length : b->key_length;
+        int comparison_result = std::memcmp(a->key_data(), b->key_data(), min_key_length);
+        return comparison_result < 0 || (comparison_result == 0 && a->key_length < b->key_length);
+    }
+
+    /*
+     * Whether the position of key, or the one just before it for
+     * before_key, is at or above bound. A null key is past all keys.
+     */
+    bool reaches(const std::string& bound, const std::string* key, bool before_key) {
+        if (key == nullptr) {
+            return true;
+        }
+        int comparison_result = bound.compare(*key);
+        return before_key ? comparison_result < 0 : comparison_result <= 0;
+    }
+
+    // Like reaches, deciding on the key prefixes of bound and key when they differ
+    bool reaches(std::uint64_t bound_prefix, const std::string& bound, const std::string* key,
+            std::uint64_t key_prefix, bool before_key) {
+        if (key != nullptr && bound_prefix != key_prefix) {
+            return bound_prefix < key_prefix;
+        }
+        return reaches(bound, key, before_key);
+    }
+
+    /**
+     * Where key goes from the page read as head: right to next_id, past
+     * bound, down to the child next_id, whose keys start at bound if that
+     * is not null, or here for a leaf holding it. split is the split delta
+     * that sent key right, if one did. key_prefix is the key prefix of key.
+     */
+    route_result route(const record* head, const std::string* key, std::uint64_t key_prefix,
+            bool before_key, page_id& next_id, const std::string*& bound, const split_delta*& split) {
+        split = nullptr;
+        bound = nullptr;
+        for (const record* a_record = head; ; a_record = a_record->next) {
+            switch (a_record->type) {
+            case record_type::insert_delta:
+            case record_type::remove_delta:
+                break;
+            case record_type::split_delta: {
+                auto delta = static_cast<const split_delta*>(a_record);
+                if (reaches(delta->separator_prefix, delta->separator, key, key_prefix, before_key)) {
+                    next_id = delta->right_page;
+                    bound = &delta->separator;
+                    split = delta;
+                    return route_result::right;
+                }
+                break;
+            }
+            case record_type::index_entry_delta: {
+                auto delta = static_cast<const index_entry_delta*>(a_record);
+                if (reaches(delta->separator_prefix, delta->separator, key, key_prefix, before_key)
+                        && !(delta->has_next_separator && reaches(delta->next_separator, key, before_key))) {
+                    next_id = delta->child;
+                    bound = &delta->separator;
+                    return route_result::down;
+                }
+                break;
+            }
+            case record_type::leaf_base:
+            case record_type::inner_base: {
+                auto base = static_cast<const base_record*>(a_record);
+                if (base->has_high_key
+                        && reaches(base->high_key_prefix, base->high_key, key, key_prefix, before_key)) {
+                    next_id = base->right_page;
+                    bound = &base->high_key;
+                    return route_result::right;
+                }
+                if (a_record->type == record_type::leaf_base) {
+                    return route_result::here;
+                }
+                auto inner = static_cast<const inner_base*>(a_record);
+                // The number of separators key reaches
+                std::size_t index = 0;
+                std::size_t remaining = inner->separators.size();
+                while (remaining > 0) {
+                    std::size_t half = remaining / 2;
+                    if (reaches(inner->separator_prefixes[index + half], inner->separators[index + half],
+                            key, key_prefix, before_key)) {
+                        index += half + 1;
+                        remaining -= half + 1;
+                    } else {
+                        remaining = half;
+                    }
+                }
+                next_id = inner->children[index];
+                bound = index > 0 ? &inner->separators[index - 1] : nullptr;
+                return route_result::down;
+            }
+            }
+        }
+    }
+
+    void delete_record(record* a_record) {
+        switch (a_record->type) {
+        case record_type::leaf_base:
+            delete static_cast<leaf_base*>(a_record);
+            break;
+        case record_type::inner_base:
+            delete static_cast<inner_base*>(a_record);
+            break;
+        case record_type::insert_delta:
+            delete static_cast<insert_delta*>(a_record);
+            break;
+        case record_type::remove_delta:
+            delete static_cast<remove_delta*>(a_record);
+            break;
+        case record_type::split_delta:
+            delete static_cast<split_delta*>(a_record);
+            break;
+        case record_type::index_entry_delta:
+            delete static_cast<index_entry_delta*>(a_record);
+            break;
+        }
+    }
+
+    // The records of a chain replaced by a consolidation, its entries live on
+    void free_chain(void* head) {
+        record* a_record = static_cast<record*>(head);
+        while (a_record != nullptr) {
+            record* next = a_record->next;
+            delete_record(a_record);
+            a_record = next;
+        }
+    }
+
+    // A page's chain together with its entries, for the destructor
+    void free_page(record* head) {
+        for (record* a_record = head; a_record != nullptr; a_record = a_record->next) {
+            if (a_record->type == record_type::insert_delta) {
+                delete static_cast<insert_delta*>(a_record)->entry;
+            } else if (a_record->type == record_type::leaf_base) {
+                for (auto entry : static_cast<leaf_base*>(a_record)->entries) {
+                    delete entry;
+                }
+            }
+        }
+        free_chain(head);
+    }
+
+    // The deltas of a chain, oldest first, and its base
+    record* unwind(record* head, std::vector<record*>& deltas) {
+        deltas.clear();
+        record* a_record = head;
+        for (; a_record->next != nullptr; a_record = a_record->next) {
+            deltas.push_back(a_record);
+        }
+        std::reverse(deltas.begin(), deltas.end());
+        return a_record;
+    }
+
+    // Fills in the key prefixes of a consolidated base
+    void set_prefixes(leaf_base* leaf) {
+        leaf->high_key_prefix = key_prefix_of(leaf->high_key.data(), leaf->high_key.size());
+        leaf->prefixes.clear();
+        for (auto entry : leaf->entries) {
+            leaf->prefixes.push_back(key_prefix_of(entry->key_data(), entry->key_length));
+        }
+    }
+
+    void set_prefixes(inner_base* inner) {
+        inner->high_key_prefix = key_prefix_of(inner->high_key.data(), inner->high_key.size());
+        inner->separator_prefixes.clear();
+        for (auto& separator : inner->separators) {
+            inner->separator_prefixes.push_back(key_prefix_of(separator.data(), separator.size()));
+        }
+    }
+}
+
+page_id dbindex::bwtree::mapping_table::allocate(record* a_record) {
+    page_id id = next_id.fetch_add(1);
+    if ((id >> chunk_bits) >= max_chunks) {
+        throw std::runtime_error("bwtreeindex: mapping table full");
+    }
+    auto& chunk = chunks[id >> chunk_bits];
+    std::atomic<record*>* slots = chunk.load(std::memory_order_acquire);
+    if (slots == nullptr) {
+        auto fresh_slots = new std::atomic<record*>[chunk_size]();
+        if (chunk.compare_exchange_strong(slots, fresh_slots)) {
+            slots = fresh_slots;
+        } else {
+            delete[] fresh_slots;
+        }
+    }
+    slots[id & (chunk_size - 1)].store(a_record, std::memory_order_release);
+    return id;
+}
+
+dbindex::bwtree::bwtreeindex::bwtreeindex() : root_page(pages.allocate(new leaf_base())) {
+}
+
+dbindex::bwtree::bwtreeindex::~bwtreeindex() {
+    for (page_id id = null_page + 1; id < pages.end(); id++) {
+        record* head = pages[id].load();
+        if (head != nullptr) {
+            free_page(head);
+        }
+    }
+}
+
+/**
+ * Goes down to the page at level holding key, or the position just before
+ * it for before_key, the last page of the level for a null key. head is
+ * the record it was read as and low_key, if given, the first key it holds,
+ * empty for the first page of a level. path gets the page each level
+ * above was left from. Splits passed that are not posted yet get posted.
+ */
+page_id dbindex::bwtree::bwtreeindex::find_page(const std::string* key, bool before_key,
+        std::uint32_t level, tree_path& path, record*& head, std::string* low_key) {
+    page_id id = root_page.load(std::memory_order_acquire);
+    std::uint64_t key_prefix = key != nullptr ? key_prefix_of(key->data(), key->size()) : 0;
+    if (low_key != nullptr) {
+        low_key->clear();
+    }
+    for (;;) {
+        head = pages[id].load(std::memory_order_acquire);
+        page_id next_id;
+        const std::string* bound;
+        const split_delta* split;
+        auto result = route(head, key, key_prefix, before_key, next_id, bound, split);
+        if (result == route_result::right) {
+            if (split != nullptr) {
+                post_split(id, split, path);
+            }
+        } else if (result == route_result::here || head->level == level) {
+            return id;
+        } else {
+            path.ids[head->level] = id;
+        }
+        if (low_key != nullptr && bound != nullptr) {
+            *low_key = *bound;
+        }
+        id = next_id;
+    }
+}
+
+// The entry of key, whose key prefix is prefix, in the leaf read as head, which holds key
+bucket_entry* dbindex::bwtree::bwtreeindex::search_leaf(record* head, const std::string& key,
+        std::uint64_t prefix) {
+    for (record* a_record = head; ; a_record = a_record->next) {
+        switch (a_record->type) {
+        case record_type::insert_delta: {
+            auto delta = static_cast<insert_delta*>(a_record);
+            if (delta->key_prefix == prefix && bytecomparer(delta->entry, key) == 0) {
+                return delta->entry;
+            }
+            break;
+        }
+        case record_type::remove_delta: {
+            auto delta = static_cast<remove_delta*>(a_record);
+            if (delta->key_prefix == prefix && delta->key == key) {
+                return nullptr;
+            }
+            break;
+        }
+        case record_type::leaf_base: {
+            auto leaf = static_cast<leaf_base*>(a_record);
+            // Only entries with the same key prefix need their key compared
+            auto first = std::lower_bound(leaf->prefixes.begin(), leaf->prefixes.end(), prefix);
+            for (std::size_t i = first - leaf->prefixes.begin();
+                    i < leaf->prefixes.size() && leaf->prefixes[i] == prefix; i++) {
+                int comparison_result = bytecomparer(leaf->entries[i], key);
+                if (comparison_result >= 0) {
+                    return comparison_result == 0 ? leaf->entries[i] : nullptr;
+                }
+            }
+            return nullptr;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+// Replaces the page read as head by delta, which is on top of head, or rereads head
+bool dbindex::bwtree::bwtreeindex::install(page_id id, record*& head, record* delta) {
+    return pages[id].compare_exchange_strong(head, delta, std::memory_order_acq_rel);
+}
+
+bool dbindex::bwtree::bwtreeindex::get(const std::string& key,
+        std::string& value) {
+    utils::epoch_manager::guard epoch_guard;
+    tree_path path = {};
+    record* head;
+    find_page(&key, false, 0, path, head);
+    bucket_entry* found = search_leaf(head, key, key_prefix_of(key.data(), key.size()));
+    if (found != nullptr) {
+        //Found copy and return
+        found->read_value(value);
+    }
+    return found != nullptr;
+}
+
+/**
+ * Like the hash indexes, ignores keys that are not present
+ */
+void dbindex::bwtree::bwtreeindex::update(const std::string& key,
+        const std::string& value) {
+    utils::epoch_manager::guard epoch_guard;
+    tree_path path = {};
+    bucket_entry* entry = nullptr;
+    for (;;) {
+        record* head;
+        page_id id = find_page(&key, false, 0, path, head);
+        if (search_leaf(head, key, key_prefix_of(key.data(), key.size())) == nullptr) {
+            delete entry;
+            return;
+        }
+        if (entry == nullptr) {
+            entry = bucket_entry::create(0, key, value);
+        }
+        auto delta = new insert_delta(entry, head);
+        if (install(id, head, delta)) {
+            if (delta->chain_length >= max_delta_chain) {
+                consolidate(id, delta, path);
+            }
+            return;
+        }
+        delete delta;
+    }
+}
+
+void dbindex::bwtree::bwtreeindex::insert(const std::string& key,
+        const std::string& value) {
+    utils::epoch_manager::guard epoch_guard;
+    tree_path path = {};
+    bucket_entry* entry = bucket_entry::create(0, key, value);
+    for (;;) {
+        record* head;
+        page_id id = find_page(&key, false, 0, path, head);
+        bool replaces = search_leaf(head, key, key_prefix_of(key.data(), key.size())) != nullptr;
+        auto delta = new insert_delta(entry, head);
+        if (install(id, head, delta)) {
+            if (!replaces) {
+                entry_count++;
+            }
+            if (delta->chain_length >= max_delta_chain) {
+                consolidate(id, delta, path);
+            }
+            return;
+        }
+        delete delta;
+    }
+}
+
+void dbindex::bwtree::bwtreeindex::remove(const std::string& key) {
+    utils::epoch_manager::guard epoch_guard;
+    tree_path path = {};
+    for (;;) {
+        record* head;
+        page_id id = find_page(&key, false, 0, path, head);
+        if (search_leaf(head, key, key_prefix_of(key.data(), key.size())) == nullptr) {
+            return;
+        }
+        auto delta = new remove_delta(key, head);
+        if (install(id, head, delta)) {
+            entry_count--;
+            if (delta->chain_length >= max_delta_chain) {
+                consolidate(id, delta, path);
+            }
+            return;
+        }
+        delete delta;
+    }
+}
+
+/**
+ * The entries of the leaf read as head, sorted, and its bounds. dropped,
+ * if given, gets the entries of the chain that are replaced, removed or
+ * moved to a right page, which a consolidation retires.
+ */
+void dbindex::bwtree::bwtreeindex::leaf_view(record* head, std::vector<bucket_entry*>& entries,
+        base_record& bounds, std::vector<bucket_entry*>* dropped) {
+    std::vector<record*> deltas;
+    auto base = static_cast<leaf_base*>(unwind(head, deltas));
+    entries = base->entries;
+    bounds.has_high_key = base->has_high_key;
+    bounds.high_key = base->high_key;
+    bounds.right_page = base->right_page;
+    for (record* a_record : deltas) {
+        if (a_record->type == record_type::insert_delta) {
+            auto entry = static_cast<insert_delta*>(a_record)->entry;
+            auto position = std::lower_bound(entries.begin(), entries.end(), entry, entry_less);
+            if (position != entries.end() && !entry_less(entry, *position)) {
+                if (dropped != nullptr) {
+                    dropped->push_back(*position);
+                }
+                *position = entry;
+            } else {
+                entries.insert(position, entry);
+            }
+        } else if (a_record->type == record_type::remove_delta) {
+            auto& key = static_cast<remove_delta*>(a_record)->key;
+            auto position = std::lower_bound(entries.begin(), entries.end(), key,
+                    [this](const bucket_entry* entry, const std::string& k) { return bytecomparer(entry, k) < 0; });
+            if (position != entries.end() && bytecomparer(*position, key) == 0) {
+                if (dropped != nullptr) {
+                    dropped->push_back(*position);
+                }
+                entries.erase(position);
+            }
+        } else if (a_record->type == record_type::split_delta) {
+            auto split = static_cast<split_delta*>(a_record);
+            bounds.has_high_key = true;
+            bounds.high_key = split->separator;
+            bounds.right_page = split->right_page;
+            auto moved = std::lower_bound(entries.begin(), entries.end(), split->separator,
+                    [this](const bucket_entry* entry, const std::string& k) { return bytecomparer(entry, k) < 0; });
+            if (dropped != nullptr) {
+                dropped->insert(dropped->end(), moved, entries.end());
+            }
+            entries.erase(moved, entries.end());
+        }
+    }
+}
+
+// The separators, children and bounds of the inner page read as head
+void dbindex::bwtree::bwtreeindex::inner_view(record* head, inner_base& view) {
+    std::vector<record*> deltas;
+    auto base = static_cast<inner_base*>(unwind(head, deltas));
+    view.separators = base->separators;
+    view.children = base->children;
+    view.has_high_key = base->has_high_key;
+    view.high_key = base->high_key;
+    view.right_page = base->right_page;
+    for (record* a_record : deltas) {
+        if (a_record->type == record_type::index_entry_delta) {
+            auto delta = static_cast<index_entry_delta*>(a_record);
+            auto position = std::lower_bound(view.separators.begin(), view.separators.end(), delta->separator);
+            if (position == view.separators.end() || *position != delta->separator) {
+                view.children.insert(view.children.begin() + (position - view.separators.begin()) + 1,
+                        delta->child);
+                view.separators.insert(position, delta->separator);
+            }
+        } else if (a_record->type == record_type::split_delta) {
+            auto split = static_cast<split_delta*>(a_record);
+            view.has_high_key = true;
+            view.high_key = split->separator;
+            view.right_page = split->right_page;
+            auto moved = std::lower_bound(view.separators.begin(), view.separators.end(), split->separator);
+            view.children.erase(view.children.begin() + (moved - view.separators.begin()) + 1,
+                    view.children.end());
+            view.separators.erase(moved, view.separators.end());
+        }
+    }
+}
+
+/**
+ * Replaces the chain of the page read as head by a new base, retiring the
+ * old records and the entries no longer in the page. A page over
+ * max_page_entries instead splits: its upper half goes to a new right
+ * page, leaves copying their entries so that every entry belongs to one
+ * page, and a split delta on the page hands them over. Losing the CAS to
+ * another change leaves the page for the next consolidation.
+ */
+void dbindex::bwtree::bwtreeindex::consolidate(page_id id, record* head, tree_path& path) {
+    if (head->next == nullptr) {
+        return;
+    }
+    base_record* consolidated;
+    base_record* right_base = nullptr;
+    std::string separator;
+    std::vector<bucket_entry*> dropped;
+    if (head->level == 0) {
+        auto leaf = new leaf_base();
+        leaf_view(head, leaf->entries, *leaf, &dropped);
+        set_prefixes(leaf);
+        if (leaf->entries.size() > max_page_entries) {
+            auto right_leaf = new leaf_base();
+            std::string value;
+            for (std::size_t i = leaf->entries.size() / 2; i < leaf->entries.size(); i++) {
+                leaf->entries[i]->read_value(value);
+                right_leaf->entries.push_back(bucket_entry::create(0, leaf->entries[i]->key(), value));
+            }
+            set_prefixes(right_leaf);
+            separator = right_leaf->entries[0]->key();
+            right_base = right_leaf;
+        }
+        consolidated = leaf;
+    } else {
+        auto inner = new inner_base(head->level);
+        inner_view(head, *inner);
+        set_prefixes(inner);
+        if (inner->separators.size() > max_page_entries) {
+            // The middle separator goes up, its right child becomes the first one of the right page
+            auto right_inner = new inner_base(head->level);
+            std::size_t middle = inner->separators.size() / 2;
+            separator = inner->separators[middle];
+            right_inner->separators.assign(inner->separators.begin() + middle + 1, inner->separators.end());
+            right_inner->children.assign(inner->children.begin() + middle + 1, inner->children.end());
+            set_prefixes(right_inner);
+            right_base = right_inner;
+        }
+        consolidated = inner;
+    }
+
+    if (right_base == nullptr) {
+        if (install(id, head, consolidated)) {
+            utils::epoch_manager::instance().retire(head, free_chain);
+            for (auto entry : dropped) {
+                utils::epoch_manager::instance().retire(entry);
+            }
+        } else {
+            delete_record(consolidated);
+        }
+        return;
+    }
+
+    right_base->has_high_key = consolidated->has_high_key;
+    right_base->high_key = consolidated->high_key;
+    right_base->high_key_prefix = consolidated->high_key_prefix;
+    right_base->right_page = consolidated->right_page;
+    page_id right_id = pages.allocate(right_base);
+    auto split = new split_delta(separator, right_id, consolidated->has_high_key,
+            consolidated->high_key, head);
+    delete_record(consolidated);
+    if (install(id, head, split)) {
+        post_split(id, split, path);
+        return;
+    }
+    pages[right_id].store(nullptr, std::memory_order_relaxed);
+    free_page(right_base);
+    delete split;
+}
+
+/**
+ * Posts split, a split delta of the page id, to the parent holding its
+ * separator unless it is there already: the page id was left from on the
+ * way down or one right of it, or one found from the root if the tree was
+ * lower back then. A split of the root grows a new root instead. A split
+ * on the top level besides the root waits for the new root the root's
+ * split is about to grow.
+ */
+void dbindex::bwtree::bwtreeindex::post_split(page_id id, const split_delta* split, tree_path& path) {
+    std::uint32_t level = split->level + 1;
+    for (;;) {
+        page_id root_id = root_page.load(std::memory_order_acquire);
+        if (pages[root_id].load(std::memory_order_acquire)->level < level) {
+            if (root_id != id) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto new_root = new inner_base(level);
+            new_root->separators.push_back(split->separator);
+            new_root->children.push_back(id);
+            new_root->children.push_back(split->right_page);
+            set_prefixes(new_root);
+            page_id new_root_id = pages.allocate(new_root);
+            if (root_page.compare_exchange_strong(root_id, new_root_id, std::memory_order_acq_rel)) {
+                return;
+            }
+            pages[new_root_id].store(nullptr, std::memory_order_relaxed);
+            delete new_root;
+            continue;
+        }
+
+        record* head;
+        page_id parent_id = path.ids[level];
+        if (parent_id == null_page) {
+            parent_id = find_page(&split->separator, false, level, path, head);
+        }
+        for (;;) {
+            head = pages[parent_id].load(std::memory_order_acquire);
+            page_id next_id;
+            const std::string* bound;
+            const split_delta* parent_split;
+            if (route(head, &split->separator, split->separator_prefix, false, next_id, bound,
+                    parent_split) == route_result::right) {
+                parent_id = next_id;
+                continue;
+            }
+            if (next_id == split->right_page) {
+                return;
+            }
+            auto delta = new index_entry_delta(*split, head);
+            if (install(parent_id, head, delta)) {
+                if (delta->chain_length >= max_delta_chain) {
+                    consolidate(parent_id, delta, path);
+                }
+                return;
+            }
+            delete delta;
+        }
+    }
+}
+
+/**
+ * Passes the keys from start_key to end_key, both included, to op in
+ * ascending order, or descending for reverse scans, until op stops the
+ * scan. Each leaf is taken as one snapshot. Ascending scans go on to the
+ * right page, descending ones go down again to the position just before
+ * the first key of the leaf they passed.
+ */
+void dbindex::bwtree::bwtreeindex::scan(const std::string& start_key,
+        const std::string* end_key, abstract_push_op& op, bool reverse_scan) {
+    utils::epoch_manager::guard epoch_guard;
+    std::string last_key;
+    bool passed_any = false;
+    std::string value;
+    std::vector<bucket_entry*> entries;
+    base_record bounds(record_type::leaf_base, 0);
+    std::string low_key;
+    std::string descend_key;
+    tree_path path = {};
+    record* head;
+    if (reverse_scan) {
+        find_page(end_key, false, 0, path, head, &low_key);
+    } else {
+        find_page(&start_key, false, 0, path, head);
+    }
+    for (;;) {
+        leaf_view(head, entries, bounds, nullptr);
+        std::size_t count = entries.size();
+        for (std::size_t i = 0; i < count; i++) {
+            auto target_element = entries[reverse_scan ? count - 1 - i : i];
+            if (reverse_scan) {
+                if (passed_any ? bytecomparer(target_element, last_key) >= 0
+                        : end_key != nullptr && bytecomparer(target_element, *end_key) > 0) {
+                    continue;
+                }
+                if (bytecomparer(target_element, start_key) < 0) {
+                    return;
+                }
+            } else {
+                if (passed_any ? bytecomparer(target_element, last_key) <= 0
+                        : bytecomparer(target_element, start_key) < 0) {
+                    continue;
+                }
+                if (end_key != nullptr && bytecomparer(target_element, *end_key) > 0) {
+                    return;
+                }
+            }
+            last_key.assign(target_element->key_data(), target_element->key_length);
+            passed_any = true;
+            target_element->read_value(value);
+            if (!op.invoke(target_element->key_data(), target_element->key_length, value)) {
+                //Terminate scan
+                return;
+            }
+        }
+
+        if (reverse_scan) {
+            if (low_key.empty() || low_key.compare(start_key) <= 0) {
+                return;
+            }
+            descend_key.swap(low_key);
+            find_page(&descend_key, true, 0, path, head, &low_key);
+        } else {
+            if (!bounds.has_high_key || (end_key != nullptr && bounds.high_key.compare(*end_key) > 0)) {
+                return;
+            }
+            head = pages[bounds.right_page].load(std::memory_order_acquire);
+        }
+    }
+}
+
+void dbindex::bwtree::bwtreeindex::range_scan(
+        const std::string& start_key, const std::string* end_key,
+        abstract_push_op& op) {
+    scan(start_key, end_key, op, false);
+}
+
+void dbindex::bwtree::bwtreeindex::reverse_range_scan(
+        const std::string& start_key, const std::string* end_key,
+        abstract_push_op& op) {
+    scan(start_key, end_key, op, true);
+}
+
+size_t dbindex::bwtree::bwtreeindex::size() {
+    return entry_count.load();
+}
+
+std::string dbindex::bwtree::bwtreeindex::to_string() {
+    return "bwtreeindex";
+}
+
+std::size_t dbindex::bwtree::bwtreeindex::height() {
+    utils::epoch_manager::guard epoch_guard;
+    return pages[root_page.load()].load()->level + 1;
+}
+
+std::size_t dbindex::bwtree::bwtreeindex::page_count() {
+    std::size_t count = 0;
+    for (page_id id = null_page + 1; id < pages.end(); id++) {
+        count += pages[id].load() != nullptr;
+    }
+    return count;
+}
@@ -0,0 +1,267 @@
+#ifndef SRC_ORDERED_INDEX_BWTREEINDEX_H_
+#define SRC_ORDERED_INDEX_BWTREEINDEX_H_
+
+#include "../abstract_index.h"
+#include "../hash_index/bucket_entry.h"
+#include "key_compare.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dbindex {
+    namespace bwtree {
+
+        typedef std::uint64_t page_id;
+        constexpr page_id null_page = 0;
+
+        // A page is consolidated once this many deltas are on top of its base
+        constexpr std::uint32_t max_delta_chain = 8;
+        // A page with more entries than this is split when consolidated
+        constexpr std::size_t max_page_entries = 32;
+        constexpr std::size_t max_height = 32;
+
+        enum class record_type : std::uint8_t {
+            leaf_base, inner_base, insert_delta, remove_delta, split_delta, index_entry_delta
+        };
+
+        /*
+         * A page is its current record in the mapping table: a chain of
+         * delta records, newest first, ending in a base record. Records
+         * never change once they are reachable, a page changes by a CAS of
+         * its slot from the record it was read as to a new one.
+         */
+        struct record {
+            const record_type type;
+            // Leaves are level 0
+            const std::uint32_t level;
+            // Deltas from this record down to the base
+            const std::uint32_t chain_length;
+            record* const next;
+
+            record(record_type _type, std::uint32_t _level, record* _next) : type(_type), level(_level),
+                chain_length(_next != nullptr ? _next->chain_length + 1 : 0), next(_next) {}
+        };
+
+        /*
+         * Bases hold the keys below high_key, all keys on the last page of
+         * a level, whose right_page is null. The keys from high_key on are
+         * on right_page, like in a B-link tree.
+         */
+        struct base_record : record {
+            bool has_high_key;
+            std::string high_key;
+            std::uint64_t high_key_prefix;
+            page_id right_page;
+
+            base_record(record_type _type, std::uint32_t _level) : record(_type, _level, nullptr),
+                has_high_key(false), high_key_prefix(0), right_page(null_page) {}
+        };
+
+        // Sorted entries owned by the leaf, and their key prefixes to search without following them
+        struct leaf_base : base_record {
+            std::vector<bucket_entry*> entries;
+            std::vector<std::uint64_t> prefixes;
+
+            leaf_base() : base_record(record_type::leaf_base, 0) {}
+        };
+
+        // children[i] holds the keys from separators[i-1] up to separators[i]
+        struct inner_base : base_record {
+            std::vector<std::string> separators;
+            std::vector<std::uint64_t> separator_prefixes;
+            std::vector<page_id> children;
+
+            explicit inner_base(std::uint32_t _level) : base_record(record_type::inner_base, _level) {}
+        };
+
+        // Adds or replaces the entry of its key, owned by the leaf
+        struct insert_delta : record {
+            bucket_entry* const entry;
+            const std::uint64_t key_prefix;
+
+            insert_delta(bucket_entry* _entry, record* _next) :
+                record(record_type::insert_delta, _next->level, _next), entry(_entry),
+                key_prefix(key_prefix_of(_entry->key_data(), _entry->key_length)) {}
+        };
+
+        struct remove_delta : record {
+            const std::string key;
+            const std::uint64_t key_prefix;
+
+            remove_delta(const std::string& _key, record* _next) :
+                record(record_type::remove_delta, _next->level, _next), key(_key),
+                key_prefix(key_prefix_of(_key.data(), _key.size())) {}
+        };
+
+        /*
+         * First half of a split: the keys from separator on moved to
+         * right_page, which held the keys up to next_separator, or to the
+         * end of the level without one
+         */
+        struct split_delta : record {
+            const std::string separator;
+            const std::uint64_t separator_prefix;
+            const page_id right_page;
+            const bool has_next_separator;
+            const std::string next_separator;
+
+            split_delta(const std::string& _separator, page_id _right_page, bool _has_next_separator,
+                    const std::string& _next_separator, record* _next) :
+                record(record_type::split_delta, _next->level, _next), separator(_separator),
+                separator_prefix(key_prefix_of(_separator.data(), _separator.size())),
+                right_page(_right_page), has_next_separator(_has_next_separator),
+                next_separator(_next_separator) {}
+        };
+
+        // Second half of a split, posted to the parent: the keys from separator to next_separator are on child
+        struct index_entry_delta : record {
+            const std::string separator;
+            const std::uint64_t separator_prefix;
+            const page_id child;
+            const bool has_next_separator;
+            const std::string next_separator;
+
+            index_entry_delta(const split_delta& split, record* _next) :
+                record(record_type::index_entry_delta, _next->level, _next), separator(split.separator),
+                separator_prefix(split.separator_prefix), child(split.right_page),
+                has_next_separator(split.has_next_separator), next_separator(split.next_separator) {}
+        };
+
+        /**
+         * Maps page ids to the current record of their page. Slots come in
+         * chunks allocated on first use, so the table grows without ever
+         * moving a slot. Ids are not reused.
+         */
+        class mapping_table {
+        public:
+            static constexpr std::size_t chunk_bits = 16;
+            static constexpr std::size_t chunk_size = std::size_t(1) << chunk_bits;
+            static constexpr std::size_t max_chunks = 1 << 14;
+
+            mapping_table() : next_id(null_page + 1) {
+                for (std::size_t i = 0; i < max_chunks; i++) {
+                    chunks[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+            mapping_table(const mapping_table&) = delete;
+            mapping_table& operator=(const mapping_table&) = delete;
+
+            ~mapping_table() {
+                for (std::size_t i = 0; i < max_chunks; i++) {
+                    delete[] chunks[i].load();
+                }
+            }
+
+            std::atomic<record*>& operator[](page_id id) {
+                return chunks[id >> chunk_bits].load(std::memory_order_acquire)[id & (chunk_size - 1)];
+            }
+
+            // A new page holding a_record
+            page_id allocate(record* a_record);
+
+            // One past the last allocated id
+            page_id end() const {
+                return next_id.load();
+            }
+
+        private:
+            std::atomic<std::atomic<record*>*> chunks[max_chunks];
+            std::atomic<page_id> next_id;
+        };
+
+        /**
+         * Bw-tree after Levandoski, Lomet and Sengupta, "The Bw-Tree: A
+         * B-tree for New Hardware Platforms". Nodes are logical pages that
+         * refer to each other by id through the mapping_table, and nothing
+         * is ever locked: every change prepends a delta record to a page
+         * and installs it with a CAS of the page's slot, retrying on
+         * failure. Readers take a page's current record as a snapshot and
+         * never wait.
+         *
+         * A page whose chain reaches max_delta_chain deltas is consolidated
+         * into a new base, which replaces the whole chain with one CAS. A
+         * consolidated page with more than max_page_entries entries splits
+         * instead, in two steps. First a split delta on the page hands
+         * the upper keys to a new right page. Then an index entry delta on
+         * the parent routes them there directly, or a new root does when
+         * the root split. In between, the keys are found through the right
+         * page link, like in a B-link tree. Any thread that comes across a
+         * split not yet posted to the parent posts it.
+         *
+         * Pages are never merged, so empty leaves stay in the tree, and
+         * page ids of pages split off by a losing CAS are not reused.
+         * Records and entries replaced by a consolidation are retired to
+         * the epoch_manager, every operation holds an epoch guard. Keys are
+         * unique, inserting an existing key replaces its value.
+         */
+        class bwtreeindex: public abstract_index {
+            mapping_table pages;
+            std::atomic<page_id> root_page;
+            std::atomic<std::size_t> entry_count { 0 };
+
+            // Ids of the pages passed on the way down, by level
+            struct tree_path {
+                page_id ids[max_height];
+            };
+
+            page_id find_page(const std::string* key, bool before_key, std::uint32_t level,
+                    tree_path& path, record*& head, std::string* low_key = nullptr);
+
+            bucket_entry* search_leaf(record* head, const std::string& key, std::uint64_t prefix);
+
+            bool install(page_id id, record*& head, record* delta);
+
+            void consolidate(page_id id, record* head, tree_path& path);
+
+            void post_split(page_id id, const split_delta* split, tree_path& path);
+
+            void leaf_view(record* head, std::vector<bucket_entry*>& entries,
+                    base_record& bounds, std::vector<bucket_entry*>* dropped);
+
+            void inner_view(record* head, inner_base& view);
+
+            void scan(const std::string& start_key, const std::string* end_key,
+                    abstract_push_op& op, bool reverse_scan);
+
+            inline int bytecomparer(const bucket_entry* entry, const std::string& key) {
+                return compare_key(entry, key);
+            }
+
+        public:
+
+            bwtreeindex();
+
+            ~bwtreeindex();
+
+            bool get(const std::string& key, std::string& value) override;
+
+            void update(const std::string& key, const std::string& value)
+                    override;
+
+            void insert(const std::string& key, const std::string& value)
+                    override;
+
+            void remove(const std::string& key) override;
+
+            void range_scan(const std::string& start_key,
+                    const std::string* end_key, abstract_push_op&) override;
+
+            void reverse_range_scan(const std::string& start_key,
+                    const std::string* end_key, abstract_push_op&) override;
+
+            size_t size() override;
+
+            std::string to_string() override;
+
+            // Levels from the root to the leaves
+            std::size_t height();
+
+            // Pages in the tree, while no writer runs
+            std::size_t page_count();
+
+        };
+    }
+}
+
+#endif /* SRC_ORDERED_INDEX_BWTREEINDEX_H_ */
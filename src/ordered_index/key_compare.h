@@ -0,0 +1,34 @@
+#ifndef SRC_ORDERED_INDEX_KEY_COMPARE_H_
+#define SRC_ORDERED_INDEX_KEY_COMPARE_H_
+
+#include "../hash_index/bucket_entry.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace dbindex {
+    /*
+     * The first 8 bytes of a key, zero padded, as a big endian number.
+     * Keys with different prefixes compare like them, so most comparisons
+     * in a tree node need not follow the entry pointers.
+     */
+    inline std::uint64_t key_prefix_of(const char* key, std::size_t length) {
+        std::uint64_t prefix = 0;
+        for (std::size_t i = 0; i < sizeof(prefix); i++) {
+            prefix = prefix << 8 | (i < length ? (unsigned char)key[i] : 0);
+        }
+        return prefix;
+    }
+
+    // Orders as memcmp on the common prefix, a prefix before its extensions
+    inline int compare_key(const bucket_entry* entry, const std::string& key) {
+        auto min_key_length = entry->key_length < key.size() ? entry->key_length : key.size();
+        int comparison_result = std::memcmp(entry->key_data(), key.data(), min_key_length);
+        if (comparison_result != 0 || entry->key_length == key.size()) {
+            return comparison_result;
+        }
+        return entry->key_length < key.size() ? -1 : 1;
+    }
+}
+
+#endif /* SRC_ORDERED_INDEX_KEY_COMPARE_H_ */
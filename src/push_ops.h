@@ -58,8 +58,10 @@ public:
         return (++range_scanned > len) ? false : true;
     }
 
+    // Starts a new scan of at most _len entries
     void set_len(size_t _len) {
         len = _len;
+        range_scanned = 0;
     }
 };
 
@@ -0,0 +1,73 @@
+#ifndef SRC_UTIL_CACHE_ALIGNED_H_
+#define SRC_UTIL_CACHE_ALIGNED_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "../macros.h"
+
+namespace utils {
+
+/**
+ * Base of types whose heap allocations start on a cache line. Under C++11
+ * plain new only guarantees the alignment of max_align_t and ignores an
+ * alignas(CACHE_LINE_SIZE) of the type, so a type that counts on its
+ * alignment derives from this to get it from new and new[] as well.
+ *
+ * The base is empty and adds nothing to the layout of the derived type.
+ */
+struct cache_aligned {
+    static void* operator new(std::size_t size) {
+        return allocate(size);
+    }
+    static void* operator new[](std::size_t size) {
+        return allocate(size);
+    }
+    static void operator delete(void* p) noexcept {
+        std::free(p);
+    }
+    static void operator delete[](void* p) noexcept {
+        std::free(p);
+    }
+
+    static void* allocate(std::size_t size) {
+        void* p;
+        if (posix_memalign(&p, CACHE_LINE_SIZE, size) != 0) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+};
+
+/**
+ * Allocator for containers of cache line aligned types. std::allocator
+ * goes through the global new and aligns no better than plain new does.
+ */
+template<typename T>
+struct cache_aligned_allocator {
+    typedef T value_type;
+
+    cache_aligned_allocator() {}
+    template<typename U>
+    cache_aligned_allocator(const cache_aligned_allocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(cache_aligned::allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t) {
+        std::free(p);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const cache_aligned_allocator<T>&, const cache_aligned_allocator<U>&) {
+    return true;
+}
+template<typename T, typename U>
+bool operator!=(const cache_aligned_allocator<T>&, const cache_aligned_allocator<U>&) {
+    return false;
+}
+
+}
+#endif /* SRC_UTIL_CACHE_ALIGNED_H_ */
@@ -0,0 +1,114 @@
+#ifndef SRC_UTIL_DISTRIBUTED_RW_LOCK_H_
+#define SRC_UTIL_DISTRIBUTED_RW_LOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <sched.h>
+
+#include "../macros.h"
+#include "rw_spinlock.h"
+
+namespace utils {
+
+/**
+ * Reader-writer lock with a reader counter per core, each in its own cache
+ * line, for locks taken shared far more often than exclusively. A reader
+ * only writes the counter of the core it runs on, so readers on different
+ * cores never contend. A writer announces itself, then waits for the
+ * counters to add up to zero, which makes it expensive and the lock about
+ * slot_count cache lines large.
+ *
+ * A reader that moved to another core releases on the counter of that
+ * core, only the sum of all counters is meaningful. Readers that find a
+ * writer announced back off, so a writer is not starved by readers.
+ *
+ * Lockable and SharedLockable, like boost::shared_mutex.
+ */
+class distributed_rw_lock {
+public:
+    static constexpr std::uint32_t slot_count = 64;
+
+    distributed_rw_lock() : writer(false) {
+        for (std::uint32_t i = 0; i < slot_count; i++) {
+            slots[i].readers = 0;
+        }
+    }
+    distributed_rw_lock(const distributed_rw_lock&) = delete;
+    distributed_rw_lock& operator=(const distributed_rw_lock&) = delete;
+
+    void lock() {
+        spin_wait backoff;
+        bool expected = false;
+        while (!writer.compare_exchange_weak(expected, true, std::memory_order_seq_cst)) {
+            expected = false;
+            backoff.wait();
+        }
+        while (reader_count() != 0) {
+            backoff.wait();
+        }
+    }
+
+    bool try_lock() {
+        bool expected = false;
+        if (!writer.compare_exchange_strong(expected, true, std::memory_order_seq_cst)) {
+            return false;
+        }
+        if (reader_count() != 0) {
+            writer.store(false, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+
+    void unlock() {
+        writer.store(false, std::memory_order_release);
+    }
+
+    void lock_shared() {
+        spin_wait backoff;
+        while (!try_lock_shared()) {
+            while (writer.load(std::memory_order_relaxed)) {
+                backoff.wait();
+            }
+        }
+    }
+
+    bool try_lock_shared() {
+        std::atomic<std::int32_t>& counter = slots[local_slot()].readers;
+        // Both seq_cst: either the writer sees this reader or the reader sees the writer
+        counter.fetch_add(1, std::memory_order_seq_cst);
+        if (!writer.load(std::memory_order_seq_cst)) {
+            return true;
+        }
+        counter.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    void unlock_shared() {
+        slots[local_slot()].readers.fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) reader_slot {
+        std::atomic<std::int32_t> readers;
+    };
+
+    reader_slot slots[slot_count];
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> writer;
+
+    static std::uint32_t local_slot() {
+        int cpu = sched_getcpu();
+        return cpu < 0 ? 0 : (std::uint32_t)cpu % slot_count;
+    }
+
+    std::int32_t reader_count() {
+        std::int32_t count = 0;
+        for (std::uint32_t i = 0; i < slot_count; i++) {
+            count += slots[i].readers.load(std::memory_order_seq_cst);
+        }
+        return count;
+    }
+};
+
+}
+#endif /* SRC_UTIL_DISTRIBUTED_RW_LOCK_H_ */
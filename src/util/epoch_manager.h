@@ -0,0 +1,246 @@
+#ifndef SRC_UTIL_EPOCH_MANAGER_H_
+#define SRC_UTIL_EPOCH_MANAGER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "../macros.h"
+
+namespace utils {
+
+/**
+ * Epoch based memory reclamation. Readers that traverse shared structures
+ * without locks wrap the traversal in a guard, writers retire objects after
+ * unlinking them. A retired object is only freed once no reader that could
+ * still hold a reference to it is inside a guard.
+ *
+ * Every thread owns a cache line sized slot, registered on first use or
+ * explicitly with a thread_registration, holding the epoch it entered at
+ * and its own list of retired objects. Retiring never takes a lock, and
+ * every reclaim_interval retirements a thread advances the global epoch
+ * and frees what no active reader can see any more. The list of a thread
+ * that exits is handed over to the next reclaim of any thread.
+ */
+class epoch_manager {
+public:
+    static constexpr std::uint32_t max_threads      = 256;
+    static constexpr std::uint32_t reclaim_interval = 64;
+
+    class guard {
+    public:
+        guard() : manager(epoch_manager::instance()) {
+            manager.enter();
+        }
+        ~guard() {
+            manager.exit();
+        }
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+    private:
+        epoch_manager& manager;
+    };
+
+    /**
+     * Holds a slot for the calling thread for its scope. Threads register
+     * implicitly on their first guard or retire, this makes it explicit,
+     * e.g. to hand over the retired objects of a worker when it finishes
+     * instead of when the thread exits.
+     */
+    class thread_registration {
+    public:
+        thread_registration() {
+            epoch_manager::instance().register_thread();
+        }
+        ~thread_registration() {
+            epoch_manager::instance().unregister_thread();
+        }
+        thread_registration(const thread_registration&) = delete;
+        thread_registration& operator=(const thread_registration&) = delete;
+    };
+
+    static epoch_manager& instance() {
+        static epoch_manager manager;
+        return manager;
+    }
+
+    void register_thread() {
+        local_slot();
+    }
+
+    // Must not be called inside a guard
+    void unregister_thread() {
+        slot_registration& registration = local_registration();
+        if (registration.slot) {
+            release_slot(registration.slot);
+            registration.slot = nullptr;
+        }
+    }
+
+    void enter() {
+        thread_slot& slot = local_slot();
+        if (slot.depth++ == 0) {
+            slot.epoch.store(global_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            // The announcement must be visible before any shared pointer is read.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void exit() {
+        thread_slot& slot = local_slot();
+        if (--slot.depth == 0) {
+            slot.epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Hands over an object that is no longer reachable from the shared
+     * structure. It is deleted once all current readers have left.
+     */
+    template<typename T>
+    void retire(T* ptr) {
+        retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    void retire(void* ptr, void (*deleter)(void*)) {
+        thread_slot& slot = local_slot();
+        slot.retired.push_back(retired_object{global_epoch.load(), ptr, deleter});
+        if (++slot.retired_since_reclaim == reclaim_interval) {
+            reclaim(slot);
+        }
+    }
+
+    // Frees what can be freed of the calling thread's and exited threads' retired objects
+    void reclaim() {
+        reclaim(local_slot());
+    }
+
+    // Retired objects not freed yet, of the calling thread and exited threads
+    size_t pending() {
+        std::lock_guard<std::mutex> orphan_lock(orphan_mutex);
+        return local_slot().retired.size() + orphans.size();
+    }
+
+    ~epoch_manager() {
+        for (std::uint32_t i = 0; i < max_threads; i++) {
+            free_all(slots[i].retired);
+        }
+        free_all(orphans);
+    }
+
+private:
+    struct retired_object {
+        std::uint64_t epoch;
+        void* ptr;
+        void (*deleter)(void*);
+    };
+
+    struct alignas(CACHE_LINE_SIZE) thread_slot {
+        std::atomic<std::uint64_t> epoch{0}; // 0 while outside any guard
+        std::atomic<bool> in_use{false};
+        // Owner only
+        std::uint32_t depth{0};              // Guard nesting
+        std::uint32_t retired_since_reclaim{0};
+        std::vector<retired_object> retired;
+    };
+
+    struct slot_registration {
+        thread_slot* slot = nullptr;
+        ~slot_registration() {
+            if (slot) {
+                epoch_manager::instance().release_slot(slot);
+            }
+        }
+    };
+
+    std::atomic<std::uint64_t> global_epoch{1};
+    thread_slot slots[max_threads];
+
+    // Retired objects of threads that unregistered
+    std::mutex orphan_mutex;
+    std::vector<retired_object> orphans;
+    std::atomic<bool> has_orphans{false};
+
+    epoch_manager() {}
+
+    static slot_registration& local_registration() {
+        static thread_local slot_registration registration;
+        return registration;
+    }
+
+    thread_slot& local_slot() {
+        slot_registration& registration = local_registration();
+        if (!registration.slot) {
+            for (std::uint32_t i = 0; i < max_threads; i++) {
+                bool expected = false;
+                if (slots[i].in_use.compare_exchange_strong(expected, true)) {
+                    registration.slot = &slots[i];
+                    return slots[i];
+                }
+            }
+            throw std::runtime_error("epoch_manager: too many threads");
+        }
+        return *registration.slot;
+    }
+
+    void release_slot(thread_slot* slot) {
+        if (!slot->retired.empty()) {
+            std::lock_guard<std::mutex> orphan_lock(orphan_mutex);
+            orphans.insert(orphans.end(), slot->retired.begin(), slot->retired.end());
+            has_orphans.store(true, std::memory_order_release);
+        }
+        slot->retired.clear();
+        slot->retired.shrink_to_fit();
+        slot->retired_since_reclaim = 0;
+        slot->in_use.store(false, std::memory_order_release);
+    }
+
+    void reclaim(thread_slot& slot) {
+        slot.retired_since_reclaim = 0;
+        global_epoch.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::uint64_t min_epoch = std::numeric_limits<std::uint64_t>::max();
+        for (std::uint32_t i = 0; i < max_threads; i++) {
+            std::uint64_t epoch = slots[i].epoch.load();
+            if (epoch != 0 && epoch < min_epoch) {
+                min_epoch = epoch;
+            }
+        }
+
+        free_older(slot.retired, min_epoch);
+        if (has_orphans.load(std::memory_order_acquire)) {
+            std::unique_lock<std::mutex> orphan_lock(orphan_mutex, std::try_to_lock);
+            if (orphan_lock.owns_lock()) {
+                free_older(orphans, min_epoch);
+                has_orphans.store(!orphans.empty(), std::memory_order_release);
+            }
+        }
+    }
+
+    // Frees the objects retired before min_epoch
+    static void free_older(std::vector<retired_object>& retired, std::uint64_t min_epoch) {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < retired.size(); i++) {
+            if (retired[i].epoch < min_epoch) {
+                retired[i].deleter(retired[i].ptr);
+            } else {
+                retired[kept++] = retired[i];
+            }
+        }
+        retired.resize(kept);
+    }
+
+    static void free_all(std::vector<retired_object>& retired) {
+        for (auto& object : retired) {
+            object.deleter(object.ptr);
+        }
+        retired.clear();
+    }
+};
+
+}
+#endif /* SRC_UTIL_EPOCH_MANAGER_H_ */
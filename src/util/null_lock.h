@@ -0,0 +1,22 @@
+#ifndef SRC_UTIL_NULL_LOCK_H_
+#define SRC_UTIL_NULL_LOCK_H_
+
+namespace utils {
+
+/**
+ * Lockable and SharedLockable that does nothing, for structures that only
+ * a single thread ever touches, such as the partitions owned by one thread
+ * of a delegating index.
+ */
+class null_lock {
+public:
+    void lock() {}
+    bool try_lock() { return true; }
+    void unlock() {}
+    void lock_shared() {}
+    bool try_lock_shared() { return true; }
+    void unlock_shared() {}
+};
+
+}
+#endif /* SRC_UTIL_NULL_LOCK_H_ */
@@ -0,0 +1,169 @@
+#ifndef SRC_UTIL_NUMA_TOPOLOGY_H_
+#define SRC_UTIL_NUMA_TOPOLOGY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+namespace utils {
+
+/**
+ * NUMA nodes and the cores on them, read once from sysfs. Nodes are the
+ * online ones by their kernel ids, which need not be consecutive, and only
+ * cores the process may run on are listed, so a node can have none, like
+ * a memory only node. Without /sys/devices/system/node, e.g. in a
+ * container that hides it, or without any node the process may run on,
+ * all cores form a single node 0.
+ *
+ * pinning_order is the order threads are placed in: one hardware thread of
+ * every physical core of node 0, then of node 1 and so on, and the
+ * hyperthread siblings only after all physical cores are taken. Consecutive
+ * threads therefore share a node for as long as it has free cores.
+ */
+class numa_topology {
+public:
+    static const numa_topology& instance() {
+        static numa_topology topology;
+        return topology;
+    }
+
+    // One past the highest node id
+    std::uint32_t node_count() const {
+        return (std::uint32_t)node_cores.size();
+    }
+
+    // Ids of the nodes with cores the process may run on, ascending, never empty
+    const std::vector<std::uint32_t>& cpu_nodes() const {
+        return nodes_with_cores;
+    }
+
+    const std::vector<int>& cores_of_node(std::uint32_t node) const {
+        return node_cores[node];
+    }
+
+    std::uint32_t node_of_core(int core) const {
+        if (core < 0 || (size_t)core >= core_nodes.size()) {
+            return 0;
+        }
+        return core_nodes[core];
+    }
+
+    // Node of the core the calling thread runs on right now
+    std::uint32_t current_node() const {
+        return node_of_core(sched_getcpu());
+    }
+
+    const std::vector<int>& pinning_order() const {
+        return order;
+    }
+
+    // Parses a sysfs cpu list such as "0-3,8-11"
+    static std::vector<int> parse_cpu_list(const std::string& list) {
+        std::vector<int> cores;
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            if (range.empty() || range[0] == '\n') {
+                continue;
+            }
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int core = first; core <= last; core++) {
+                cores.push_back(core);
+            }
+        }
+        return cores;
+    }
+
+private:
+    std::vector<std::vector<int>> node_cores;
+    std::vector<std::uint32_t> nodes_with_cores;
+    std::vector<std::uint32_t> core_nodes;
+    std::vector<int> order;
+
+    numa_topology() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool has_affinity = sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0;
+
+        std::string online;
+        if (read_line("/sys/devices/system/node/online", online)) {
+            for (int node : parse_cpu_list(online)) {
+                std::string list;
+                if (!read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", list)) {
+                    continue;
+                }
+                if ((size_t)node >= node_cores.size()) {
+                    node_cores.resize(node + 1);
+                }
+                for (int core : parse_cpu_list(list)) {
+                    if (!has_affinity || (core < CPU_SETSIZE && CPU_ISSET(core, &allowed))) {
+                        node_cores[node].push_back(core);
+                    }
+                }
+            }
+        }
+        for (std::uint32_t node = 0; node < node_cores.size(); node++) {
+            if (!node_cores[node].empty()) {
+                nodes_with_cores.push_back(node);
+            }
+        }
+        if (nodes_with_cores.empty()) {
+            node_cores.clear();
+            nodes_with_cores.push_back(0);
+            std::vector<int> cores;
+            int core_count = std::max(1u, std::thread::hardware_concurrency());
+            for (int core = 0; core < core_count; core++) {
+                if (!has_affinity || CPU_ISSET(core, &allowed)) {
+                    cores.push_back(core);
+                }
+            }
+            node_cores.push_back(cores);
+        }
+
+        for (std::uint32_t node = 0; node < node_cores.size(); node++) {
+            for (int core : node_cores[node]) {
+                if ((size_t)core >= core_nodes.size()) {
+                    core_nodes.resize(core + 1, 0);
+                }
+                core_nodes[core] = node;
+            }
+        }
+
+        std::vector<int> siblings;
+        for (const std::vector<int>& cores : node_cores) {
+            for (int core : cores) {
+                (is_first_sibling(core) ? order : siblings).push_back(core);
+            }
+        }
+        order.insert(order.end(), siblings.begin(), siblings.end());
+        if (order.empty()) {
+            order.push_back(0);
+        }
+    }
+
+    // Whether core is the lowest numbered hardware thread of its physical core
+    static bool is_first_sibling(int core) {
+        std::string list;
+        if (!read_line("/sys/devices/system/cpu/cpu" + std::to_string(core) + "/topology/thread_siblings_list", list)) {
+            return true;
+        }
+        std::vector<int> siblings = parse_cpu_list(list);
+        return siblings.empty() || *std::min_element(siblings.begin(), siblings.end()) == core;
+    }
+
+    static bool read_line(const std::string& path, std::string& line) {
+        std::ifstream file(path);
+        return file.is_open() && std::getline(file, line);
+    }
+};
+
+}
+#endif /* SRC_UTIL_NUMA_TOPOLOGY_H_ */
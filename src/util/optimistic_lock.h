@@ -0,0 +1,77 @@
+#ifndef SRC_UTIL_OPTIMISTIC_LOCK_H_
+#define SRC_UTIL_OPTIMISTIC_LOCK_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "rw_spinlock.h"
+
+namespace utils {
+
+/**
+ * Version lock for optimistic lock coupling. Readers never write it: they
+ * note the version, read the guarded data and validate that the version
+ * did not change meanwhile, starting over if it did. Writers turn a noted
+ * version into the lock, which fails instead of waiting when someone else
+ * got there first, so a writer holding locks never waits for another one.
+ * Unlocking bumps the version, and a node taken out of its structure is
+ * unlocked as obsolete, failing every later reader and writer.
+ *
+ * Data read under the lock must itself be atomic, readers may see it
+ * half written before they fail validation.
+ */
+class optimistic_lock {
+public:
+    optimistic_lock() : version(0) {}
+    optimistic_lock(const optimistic_lock&) = delete;
+    optimistic_lock& operator=(const optimistic_lock&) = delete;
+
+    // Notes the version, waiting while a writer holds the lock. False if obsolete
+    bool read_lock(std::uint64_t& noted) const {
+        spin_wait backoff;
+        for (;;) {
+            noted = version.load(std::memory_order_acquire);
+            if (!(noted & locked_bit)) {
+                return !(noted & obsolete_bit);
+            }
+            backoff.wait();
+        }
+    }
+
+    // True if nobody wrote since the version was noted
+    bool validate(std::uint64_t noted) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version.load(std::memory_order_relaxed) == noted;
+    }
+
+    // Takes the lock if nobody wrote since the version was noted
+    bool upgrade(std::uint64_t noted) {
+        return version.compare_exchange_strong(noted, noted + locked_bit, std::memory_order_acq_rel);
+    }
+
+    // Takes the lock unless it is held or obsolete, without waiting
+    bool try_lock() {
+        std::uint64_t current = version.load(std::memory_order_relaxed);
+        if (current & (locked_bit | obsolete_bit)) {
+            return false;
+        }
+        return upgrade(current);
+    }
+
+    void unlock() {
+        version.fetch_add(locked_bit, std::memory_order_release);
+    }
+
+    void unlock_obsolete() {
+        version.fetch_add(locked_bit | obsolete_bit, std::memory_order_release);
+    }
+
+private:
+    static constexpr std::uint64_t obsolete_bit = 1;
+    static constexpr std::uint64_t locked_bit   = 2;
+
+    std::atomic<std::uint64_t> version;
+};
+
+}
+#endif /* SRC_UTIL_OPTIMISTIC_LOCK_H_ */
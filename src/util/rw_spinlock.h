@@ -0,0 +1,99 @@
+#ifndef SRC_UTIL_RW_SPINLOCK_H_
+#define SRC_UTIL_RW_SPINLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace utils {
+
+/**
+ * Backoff for spinning waiters. Pauses the core for the first rounds and
+ * yields after that, so that a lock holder that was descheduled gets to
+ * run when there are more threads than cores.
+ */
+class spin_wait {
+public:
+    static constexpr std::uint32_t spins_before_yield = 64;
+
+    void wait() {
+        if (++spins < spins_before_yield) {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#endif
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::uint32_t spins = 0;
+};
+
+/**
+ * Reader-writer spinlock in a single 32 bit word: a writer bit, a bit for a
+ * waiting writer and the reader count above them. A waiting writer keeps
+ * new readers out, so writers are not starved by a stream of readers, and
+ * a reader must therefore not take the lock shared twice.
+ *
+ * Lockable and SharedLockable, usable with boost::unique_lock and
+ * boost::shared_lock like boost::shared_mutex, at 4 instead of hundreds of
+ * bytes and a single atomic per acquire and release.
+ */
+class rw_spinlock {
+public:
+    rw_spinlock() : state(0) {}
+    rw_spinlock(const rw_spinlock&) = delete;
+    rw_spinlock& operator=(const rw_spinlock&) = delete;
+
+    void lock() {
+        spin_wait backoff;
+        while (!try_lock()) {
+            std::uint32_t s = state.load(std::memory_order_relaxed);
+            if (!(s & writer_waiting)) {
+                state.fetch_or(writer_waiting, std::memory_order_relaxed);
+            }
+            backoff.wait();
+        }
+    }
+
+    bool try_lock() {
+        std::uint32_t s = state.load(std::memory_order_relaxed);
+        // Taking the lock clears the waiting bit, other waiting writers set it again
+        return !(s & ~writer_waiting) && state.compare_exchange_strong(s, writer, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        state.fetch_and(~writer, std::memory_order_release);
+    }
+
+    void lock_shared() {
+        spin_wait backoff;
+        while (!try_lock_shared()) {
+            backoff.wait();
+        }
+    }
+
+    bool try_lock_shared() {
+        std::uint32_t s = state.load(std::memory_order_relaxed);
+        return !(s & (writer | writer_waiting)) &&
+               state.compare_exchange_strong(s, s + reader, std::memory_order_acquire);
+    }
+
+    void unlock_shared() {
+        state.fetch_sub(reader, std::memory_order_release);
+    }
+
+private:
+    static constexpr std::uint32_t writer         = 1;
+    static constexpr std::uint32_t writer_waiting = 2;
+    static constexpr std::uint32_t reader         = 4;
+
+    std::atomic<std::uint32_t> state;
+};
+
+}
+#endif /* SRC_UTIL_RW_SPINLOCK_H_ */
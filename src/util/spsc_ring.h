@@ -0,0 +1,81 @@
+#ifndef SRC_UTIL_SPSC_RING_H_
+#define SRC_UTIL_SPSC_RING_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "../macros.h"
+#include "cache_aligned.h"
+
+namespace utils {
+
+/**
+ * Bounded lock-free ring between exactly one producer and one consumer
+ * thread. Both move batches, publishing a whole batch with a single store
+ * of their index. Each side keeps its own index and a cached copy of the
+ * other side's in a cache line of its own, and only reloads the other
+ * index when the cached one says the ring is full or empty. Rings are
+ * allocated on cache lines, so that the two sides stay apart on the heap
+ * too.
+ */
+template<typename T, std::uint32_t capacity>
+class spsc_ring : public cache_aligned {
+    static_assert(capacity && !(capacity & (capacity-1)), "capacity must be a power of two");
+public:
+    spsc_ring() {}
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    // Producer only. Pushes all count items or, if they do not fit, none
+    bool try_push(const T* items, std::uint32_t count) {
+        std::uint32_t tail = producer.index.load(std::memory_order_relaxed);
+        if (tail - producer.cached_other + count > capacity) {
+            producer.cached_other = consumer.index.load(std::memory_order_acquire);
+            if (tail - producer.cached_other + count > capacity) {
+                return false;
+            }
+        }
+        for (std::uint32_t i = 0; i < count; i++) {
+            slots[(tail + i) & (capacity-1)] = items[i];
+        }
+        producer.index.store(tail + count, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(const T& item) {
+        return try_push(&item, 1);
+    }
+
+    // Consumer only. Pops up to max items, returns how many
+    std::uint32_t try_pop(T* items, std::uint32_t max) {
+        std::uint32_t head = consumer.index.load(std::memory_order_relaxed);
+        if (consumer.cached_other == head) {
+            consumer.cached_other = producer.index.load(std::memory_order_acquire);
+            if (consumer.cached_other == head) {
+                return 0;
+            }
+        }
+        std::uint32_t count = consumer.cached_other - head;
+        if (count > max) {
+            count = max;
+        }
+        for (std::uint32_t i = 0; i < count; i++) {
+            items[i] = slots[(head + i) & (capacity-1)];
+        }
+        consumer.index.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) side {
+        std::atomic<std::uint32_t> index{0}; // Written by this side only
+        std::uint32_t cached_other = 0;      // Last seen index of the other side
+    };
+
+    side producer;
+    side consumer;
+    T slots[capacity];
+};
+
+}
+#endif /* SRC_UTIL_SPSC_RING_H_ */
@@ -1,9 +1,13 @@
 #ifndef SRC_UTIL_THREAD_UTIL_H_
 #define SRC_UTIL_THREAD_UTIL_H_
 
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
 #include <pthread.h>
 
+#include "numa_topology.h"
+
 namespace utils {
 
 static inline int stick_thread_to_core(pthread_t thread, int core_id) {
@@ -14,6 +18,33 @@ static inline int stick_thread_to_core(pthread_t thread, int core_id) {
 	return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset);
 }
 
+/**
+ * Core for the thread_index'th worker of a benchmark or test: physical cores
+ * node by node, then their hyperthread siblings, wrapping around when there
+ * are more threads than cores. See numa_topology::pinning_order.
+ */
+static inline int core_for_thread(std::uint32_t thread_index) {
+	const std::vector<int>& order = numa_topology::instance().pinning_order();
+	return order[thread_index % order.size()];
+}
+
+/*
+ * Lets thread run on any core of node, for work whose memory should live
+ * there. Like pthread_setaffinity_np returns 0 or an error number, EINVAL
+ * for a node without cores the process may run on.
+ */
+static inline int stick_thread_to_node(pthread_t thread, std::uint32_t node) {
+	const numa_topology& topology = numa_topology::instance();
+	if (node >= topology.node_count() || topology.cores_of_node(node).empty())
+		return EINVAL;
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	for (int core : topology.cores_of_node(node))
+		CPU_SET(core, &cpuset);
+
+	return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset);
+}
+
 struct timing_obj {
 	std::chrono::_V2::system_clock::time_point start;
 	std::chrono::_V2::system_clock::time_point end;
@@ -0,0 +1,78 @@
+#ifndef SRC_UTIL_WORKER_POOL_H_
+#define SRC_UTIL_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/**
+ * Fixed set of threads running submitted tasks in submission order. Meant
+ * for helpers that join work the submitting thread is doing itself, so a
+ * task that only starts after the work is finished must find nothing left
+ * to do instead of relying on running in time.
+ */
+class worker_pool {
+public:
+    explicit worker_pool(std::uint32_t worker_count) : stopping(false) {
+        for (std::uint32_t i = 0; i < worker_count; i++) {
+            workers.emplace_back(&worker_pool::run, this);
+        }
+    }
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+
+    ~worker_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    std::uint32_t size() const {
+        return (std::uint32_t)workers.size();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wakeup.notify_one();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<std::function<void()>> tasks;
+    bool stopping;
+
+    void run() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+}
+#endif /* SRC_UTIL_WORKER_POOL_H_ */
@@ -18,17 +18,17 @@ namespace dbindex {
 	constexpr std::uint8_t initial_bucket_size = 2;
 	constexpr std::uint32_t _directory_size = 4;
 
-	void insert_array_concurrent(array_hash_table<_directory_size>& hash_table, std::string *keys, std::uint32_t amount) {
+	void insert_array_concurrent(array_hash_table<>& hash_table, std::string *keys, std::uint32_t amount) {
 		// Calculating the hashing
 		for(std::uint32_t j = 0; j < amount; j++) {
 			hash_table.insert(keys[j], keys[j]);
 		}
 	}
 
-	class array_hash_table_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, array_hash_table<_directory_size>> {
+	class array_hash_table_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, array_hash_table<>> {
 	private:
 		mod_hash<hash_value_t, (1<<31)> hash{};
-		array_hash_table<_directory_size> hash_table{hash};
+		array_hash_table<> hash_table{hash, _directory_size};
 		concat_push_op concat_push{};
 
 	public:
@@ -40,12 +40,12 @@ namespace dbindex {
 			CPPUNIT_ASSERT(is_table_empty());
 
 			std::uint8_t  p = 10;
-			for (std::uint64_t i = 0; i < (1<<p)*hash_table.get_directory_size(); i++) {
+			for (std::uint64_t i = 0; i < (1<<p)*_directory_size; i++) {
 					hash_table.insert(std::to_string(i), " 1");
 	  		}
-			CPPUNIT_ASSERT(hash_table.size() == (1<<p)*hash_table.get_directory_size());
+			CPPUNIT_ASSERT(hash_table.size() == (1<<p)*_directory_size);
 			// hash_table.print_array_hash_table();
-			for (std::uint64_t i = 0; i < (1<<p)*hash_table.get_directory_size(); i++)
+			for (std::uint64_t i = 0; i < (1<<p)*_directory_size; i++)
   			{
 				hash_table.remove(std::to_string(i));
   			}
@@ -59,18 +59,65 @@ namespace dbindex {
 			CPPUNIT_ASSERT(is_table_empty());
 
 			std::uint8_t  p = 8;
-			for (std::uint64_t i = 0; i < (1<<p)*hash_table.get_directory_size(); i++) {
-					hash_table.insert(std::to_string(i*hash_table.get_directory_size()), " 1");
+			for (std::uint64_t i = 0; i < (1<<p)*_directory_size; i++) {
+					hash_table.insert(std::to_string(i*_directory_size), " 1");
 	  		}
-			CPPUNIT_ASSERT(hash_table.size() == (1<<p)*hash_table.get_directory_size());
+			CPPUNIT_ASSERT(hash_table.size() == (1<<p)*_directory_size);
 			// hash_table.print_array_hash_table();
-			for (std::uint64_t i = 0; i < (1<<p)*hash_table.get_directory_size(); i++)
+			for (std::uint64_t i = 0; i < (1<<p)*_directory_size; i++)
   			{
-				hash_table.remove(std::to_string(i*hash_table.get_directory_size()));
+				hash_table.remove(std::to_string(i*_directory_size));
   			}
 			CPPUNIT_ASSERT(hash_table.size() == 0);
 		}
 
+		void test_grow() {
+			std::cout << "TEST_GROW" << std::endl;
+			CPPUNIT_ASSERT(hash_table.get_directory_size() == _directory_size);
+
+			std::uint32_t amount = 1<<12;
+			for (std::uint32_t i = 0; i < amount; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.size() == amount);
+			CPPUNIT_ASSERT(hash_table.get_directory_size() >= amount/4);
+
+			std::string value;
+			for (std::uint32_t i = 0; i < amount; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value));
+				CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+			CPPUNIT_ASSERT(!hash_table.get(std::to_string(amount), value));
+
+			for (std::uint32_t i = 0; i < amount; i += 2)
+				hash_table.remove(std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.size() == amount/2);
+			for (std::uint32_t i = 0; i < amount; i++)
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value) == (i % 2 == 1));
+		}
+
+		void test_concurrent_grow() {
+			std::cout << "TEST_CONCURRENT_GROW" << std::endl;
+			constexpr std::uint32_t thread_count = 4;
+			constexpr std::uint32_t amount = 1<<12;
+
+			std::vector<std::string> keys(thread_count*amount);
+			for (std::uint32_t i = 0; i < keys.size(); i++)
+				keys[i] = std::to_string(i);
+
+			std::vector<std::thread> threads;
+			for (std::uint32_t t = 0; t < thread_count; t++)
+				threads.emplace_back(insert_array_concurrent, std::ref(hash_table), &keys[t*amount], amount);
+			for (auto& thread : threads)
+				thread.join();
+
+			CPPUNIT_ASSERT(hash_table.size() == keys.size());
+			std::string value;
+			for (auto& key : keys) {
+				CPPUNIT_ASSERT(hash_table.get(key, value));
+				CPPUNIT_ASSERT(value == key);
+			}
+		}
+
 		static CppUnit::Test* suite()
 		{
 			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "array_hash_table_suite" );
@@ -91,6 +138,13 @@ namespace dbindex {
                        		"test_insert_delete_skew",
                        		&array_hash_table_test::test_insert_delete_skew ) );
 
+			suite_of_tests->addTest( new CppUnit::TestCaller<array_hash_table_test>(
+                       		"test_grow",
+                       		&array_hash_table_test::test_grow ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<array_hash_table_test>(
+                       		"test_concurrent_grow",
+                       		&array_hash_table_test::test_concurrent_grow ) );
+
 			suite_of_tests->addTest( new CppUnit::TestCaller<array_hash_table_test>(
                 	       "test_scan",
                     	   &array_hash_table_test::test_scan ) );
@@ -0,0 +1,73 @@
+#ifndef TEST_BLINKTREEINDEX_TEST_H
+#define TEST_BLINKTREEINDEX_TEST_H
+
+#include "../test/common_ordered_index_test.h"
+#include "../src/ordered_index/blinktreeindex.h"
+
+namespace dbindex {
+	class blinktreeindex_test : public common_ordered_index_test<blinktree::blinktreeindex> {
+	public:
+		void test_splits() {
+			std::cout << "TEST_SPLITS" << std::endl;
+			CPPUNIT_ASSERT(tree.height() == 1 && tree.node_count() == 1);
+
+			// A leaf holds keys_per_node keys, one more splits it and grows a root
+			std::default_random_engine generator{};
+			std::vector<std::string> keys = shuffled_keys(5000, generator);
+			for (std::uint32_t i = 0; i < blinktree::keys_per_node; i++)
+				tree.insert(keys[i], keys[i]);
+			CPPUNIT_ASSERT(tree.height() == 1);
+			tree.insert(keys[blinktree::keys_per_node], keys[blinktree::keys_per_node]);
+			CPPUNIT_ASSERT(tree.height() == 2 && tree.node_count() == 3);
+
+			for (std::uint32_t i = blinktree::keys_per_node + 1; i < keys.size(); i++)
+				tree.insert(keys[i], keys[i]);
+			// Nodes are about half full at least, 5000 keys fit in 5 levels
+			CPPUNIT_ASSERT(tree.height() >= 4 && tree.height() <= 5);
+			// The right-links and prev hints visit every leaf in order
+			check_filled(keys);
+		}
+
+		void test_empty_leaves() {
+			std::cout << "TEST_EMPTY_LEAVES" << std::endl;
+			std::default_random_engine generator{};
+			std::vector<std::string> keys = shuffled_keys(5000, generator);
+			for (auto& key : keys)
+				tree.insert(key, key);
+			std::size_t height = tree.height();
+			std::size_t node_count = tree.node_count();
+			std::shuffle(keys.begin(), keys.end(), generator);
+
+			// Removing never merges, the nodes stay and scans pass over the empty leaves
+			std::string value;
+			for (std::uint32_t i = 0; i < keys.size(); i++) {
+				tree.remove(keys[i]);
+				CPPUNIT_ASSERT(!tree.get(keys[i], value));
+				CPPUNIT_ASSERT(tree.size() == keys.size() - i - 1);
+				check_rest(keys, i + 1);
+			}
+			CPPUNIT_ASSERT(tree.height() == height && tree.node_count() == node_count);
+
+			// Removing what is not there changes nothing, and the empty leaves fill again
+			tree.remove(keys[0]);
+			for (auto& key : keys)
+				tree.insert(key, key);
+			CPPUNIT_ASSERT(tree.height() == height && tree.node_count() == node_count);
+			check_filled(keys);
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "blinktreeindex_suite" );
+			add_common_tests<blinktreeindex_test>(suite_of_tests);
+			suite_of_tests->addTest( new CppUnit::TestCaller<blinktreeindex_test>(
+                       		"test_splits",
+                       		&blinktreeindex_test::test_splits ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<blinktreeindex_test>(
+                       		"test_empty_leaves",
+                       		&blinktreeindex_test::test_empty_leaves ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_BLINKTREEINDEX_TEST_H */
@@ -0,0 +1,75 @@
+#ifndef TEST_BPLUSTREEINDEX_TEST_H
+#define TEST_BPLUSTREEINDEX_TEST_H
+
+#include "../test/common_ordered_index_test.h"
+#include "../src/ordered_index/bplustreeindex.h"
+
+namespace dbindex {
+	class bplustreeindex_test : public common_ordered_index_test<bplustree::bplustreeindex> {
+	public:
+		void test_splits() {
+			std::cout << "TEST_SPLITS" << std::endl;
+			CPPUNIT_ASSERT(tree.height() == 1 && tree.node_count() == 1);
+
+			// A leaf holds keys_per_node keys, one more splits it and grows a root
+			std::default_random_engine generator{};
+			std::vector<std::string> keys = shuffled_keys(5000, generator);
+			for (std::uint32_t i = 0; i < bplustree::keys_per_node; i++)
+				tree.insert(keys[i], keys[i]);
+			CPPUNIT_ASSERT(tree.height() == 1);
+			tree.insert(keys[bplustree::keys_per_node], keys[bplustree::keys_per_node]);
+			CPPUNIT_ASSERT(tree.height() == 2);
+
+			for (std::uint32_t i = bplustree::keys_per_node + 1; i < keys.size(); i++)
+				tree.insert(keys[i], keys[i]);
+			// Nodes are about half full at least, 5000 keys fit in 5 levels
+			CPPUNIT_ASSERT(tree.height() >= 4 && tree.height() <= 5);
+			// The next and prev links visit every leaf in order
+			check_filled(keys);
+		}
+
+		void test_merges() {
+			std::cout << "TEST_MERGES" << std::endl;
+			std::default_random_engine generator{};
+			std::vector<std::string> keys = shuffled_keys(5000, generator);
+			for (auto& key : keys)
+				tree.insert(key, key);
+			std::shuffle(keys.begin(), keys.end(), generator);
+
+			// Removing borrows and merges until the root is a single leaf, which is left empty
+			std::string value;
+			for (std::uint32_t i = 0; i < keys.size(); i++) {
+				tree.remove(keys[i]);
+				CPPUNIT_ASSERT(!tree.get(keys[i], value));
+				CPPUNIT_ASSERT(tree.size() == keys.size() - i - 1);
+				// Nodes besides the root are about half full at least
+				CPPUNIT_ASSERT(tree.node_count() <= tree.size() / 4 + tree.height());
+				if (tree.size() > 0 && tree.size() < bplustree::keys_per_node)
+					CPPUNIT_ASSERT(tree.height() == 1);
+				check_rest(keys, i + 1);
+			}
+			CPPUNIT_ASSERT(tree.height() == 1);
+			CPPUNIT_ASSERT(tree.node_count() == 1);
+
+			// Removing what is not there changes nothing, and the empty tree fills again
+			tree.remove(keys[0]);
+			tree.insert(keys[0], keys[0]);
+			CPPUNIT_ASSERT(tree.size() == 1 && tree.height() == 1);
+			CPPUNIT_ASSERT(tree.get(keys[0], value) && value == keys[0]);
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "bplustreeindex_suite" );
+			add_common_tests<bplustreeindex_test>(suite_of_tests);
+			suite_of_tests->addTest( new CppUnit::TestCaller<bplustreeindex_test>(
+                       		"test_splits",
+                       		&bplustreeindex_test::test_splits ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<bplustreeindex_test>(
+                       		"test_merges",
+                       		&bplustreeindex_test::test_merges ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_BPLUSTREEINDEX_TEST_H */
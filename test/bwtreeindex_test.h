@@ -0,0 +1,114 @@
+#ifndef TEST_BWTREEINDEX_TEST_H
+#define TEST_BWTREEINDEX_TEST_H
+
+#include "../test/common_ordered_index_test.h"
+#include "../src/ordered_index/bwtreeindex.h"
+
+namespace dbindex {
+	class bwtreeindex_test : public common_ordered_index_test<bwtree::bwtreeindex> {
+	public:
+		void test_splits() {
+			std::cout << "TEST_SPLITS" << std::endl;
+			CPPUNIT_ASSERT(tree.height() == 1 && tree.page_count() == 1);
+
+			// Deltas pile up until a consolidation finds the leaf too full and splits it
+			std::default_random_engine generator{};
+			std::vector<std::string> keys = shuffled_keys(5000, generator);
+			for (std::uint32_t i = 0; i <= bwtree::max_page_entries; i++)
+				tree.insert(keys[i], keys[i]);
+			CPPUNIT_ASSERT(tree.height() == 1);
+			for (std::uint32_t i = bwtree::max_page_entries + 1; i < bwtree::max_page_entries + bwtree::max_delta_chain; i++)
+				tree.insert(keys[i], keys[i]);
+			CPPUNIT_ASSERT(tree.height() == 2 && tree.page_count() == 3);
+
+			for (std::uint32_t i = bwtree::max_page_entries + bwtree::max_delta_chain; i < keys.size(); i++)
+				tree.insert(keys[i], keys[i]);
+			// Pages hold about half of max_page_entries at least
+			CPPUNIT_ASSERT(tree.height() == 3);
+			CPPUNIT_ASSERT(tree.page_count() <= 2 * keys.size() / bwtree::max_page_entries + 10);
+			// Right pages lead through every leaf in order, and descents back to the leaf before
+			check_filled(keys);
+		}
+
+		void test_empty_leaves() {
+			std::cout << "TEST_EMPTY_LEAVES" << std::endl;
+			std::default_random_engine generator{};
+			std::vector<std::string> keys = shuffled_keys(5000, generator);
+			for (auto& key : keys)
+				tree.insert(key, key);
+			std::size_t height = tree.height();
+			std::size_t page_count = tree.page_count();
+			std::shuffle(keys.begin(), keys.end(), generator);
+
+			// Removing never merges, the pages stay and scans pass over the empty leaves
+			std::string value;
+			for (std::uint32_t i = 0; i < keys.size(); i++) {
+				tree.remove(keys[i]);
+				CPPUNIT_ASSERT(!tree.get(keys[i], value));
+				CPPUNIT_ASSERT(tree.size() == keys.size() - i - 1);
+				check_rest(keys, i + 1);
+			}
+			CPPUNIT_ASSERT(tree.height() == height && tree.page_count() == page_count);
+
+			// Removing what is not there changes nothing, and the empty leaves fill again
+			tree.remove(keys[0]);
+			for (auto& key : keys)
+				tree.insert(key, key);
+			CPPUNIT_ASSERT(tree.height() == height && tree.page_count() == page_count);
+			check_filled(keys);
+		}
+
+		void test_concurrent_growth() {
+			std::cout << "TEST_CONCURRENT_GROWTH" << std::endl;
+			std::uint32_t key_amount = 1<<14;
+			std::uint8_t  num_threads = 4;
+			std::vector<std::string> keys{key_amount};
+			for (std::uint32_t i = 0; i < key_amount; i++)
+				keys[i] = std::to_string((std::uint64_t)i * 7919 % 1000003);
+
+			// Splits up to the root race each other, readers find every key inserted before
+			std::vector<std::thread> threads;
+			std::vector<bool> is_valid(num_threads, true);
+			for (std::uint8_t t = 0; t < num_threads; t++) {
+				threads.emplace_back([&, t]() {
+					std::string value;
+					for (std::uint32_t i = t; i < key_amount; i += num_threads) {
+						tree.insert(keys[i], keys[i]);
+						if (i % 64 == t) {
+							for (std::uint32_t j = t; j <= i; j += num_threads * 17) {
+								bool found = tree.get(keys[j], value) && value == keys[j];
+								is_valid[t] = is_valid[t] && found;
+							}
+						}
+					}
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+
+			for (std::uint8_t t = 0; t < num_threads; t++)
+				CPPUNIT_ASSERT(is_valid[t]);
+			CPPUNIT_ASSERT(tree.size() == key_amount);
+			std::sort(keys.begin(), keys.end());
+			CPPUNIT_ASSERT(scan("", NULL, false) == keys);
+			CPPUNIT_ASSERT(scan("", NULL, true) == std::vector<std::string>(keys.rbegin(), keys.rend()));
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "bwtreeindex_suite" );
+			add_common_tests<bwtreeindex_test>(suite_of_tests);
+			suite_of_tests->addTest( new CppUnit::TestCaller<bwtreeindex_test>(
+                       		"test_splits",
+                       		&bwtreeindex_test::test_splits ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<bwtreeindex_test>(
+                       		"test_empty_leaves",
+                       		&bwtreeindex_test::test_empty_leaves ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<bwtreeindex_test>(
+                       		"test_concurrent_growth",
+                       		&bwtreeindex_test::test_concurrent_growth ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_BWTREEINDEX_TEST_H */
@@ -156,14 +156,12 @@ namespace dbindex {
 		void test_insert_delete_many() {
 			std::cout << "TEST_INSERT_DELETE_MANY" << std::endl;
 			CPPUNIT_ASSERT(hash_table.size() == 0);
-			std::uint64_t i = 0;
 			std::uint8_t  p = 12;
-			for (std::uint8_t i = 1; i <= (std::uint32_t)1<<p; i++) {
+			for (std::uint64_t i = 0; i < ((std::uint64_t)1<<p); i++) {
 				hash_table.insert(std::to_string(i+(1<<8)), "10");
 			}
-			CPPUNIT_ASSERT(hash_table.size() == (std::uint32_t)1<<p);
-			for (i = 0; i < (std::uint32_t)1<<p; i++)
-			{
+			CPPUNIT_ASSERT(hash_table.size() == ((std::uint64_t)1<<p));
+			for (std::uint64_t i = 0; i < ((std::uint64_t)1<<p); i++) {
 				hash_table.remove(std::to_string(i+(1<<8)));
 			}
 			CPPUNIT_ASSERT(hash_table.size() == 0);
@@ -265,7 +263,7 @@ namespace dbindex {
 			
 			for(std::uint32_t t = 0; t < num_threads; t++) {
 				threads[t] = std::thread(insert_concurrent, std::ref(hash_table), &keys[t*amount], amount);
-				utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+				utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 			}
 			for(std::uint32_t t = 0; t < num_threads; t++) {
 				threads[t].join();
@@ -286,7 +284,7 @@ namespace dbindex {
 			
 			for(std::uint32_t t = 0; t < num_threads; t++) {
 				threads[t] = std::thread(insert_concurrent, std::ref(hash_table), &keys[t*amount], amount);
-				utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+				utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 			}
 			for(std::uint32_t t = 0; t < num_threads; t++) {
 				threads[t].join();
@@ -316,7 +314,7 @@ namespace dbindex {
 			// Initial insertion phase - Concurrent faster tests
 			for(std::uint8_t t = 0; t < num_threads-1U; t++) {
 				threads[t] = std::thread(insert_concurrent_fixed, std::ref(hash_table), &keys[t*pre_amount], pre_amount, initial_value);
-				utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+				utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 			}
 			for(std::uint8_t t = 0; t < num_threads-1U; t++) {
 				threads[t].join();
@@ -325,11 +323,11 @@ namespace dbindex {
 			// Actual updating and reading: num_threads-1 update threads, 1 read thread
 			for(std::uint8_t t = 1; t < num_threads; t++) {
 				threads[t] = std::thread(update_concurrent_from_vec, std::ref(hash_table), &keys[(t-1)*pre_amount], pre_amount, valid_values);
-				utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+				utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 			}
 			// Reader thread
 			threads[0] = std::thread(read_concurrent_random, std::ref(hash_table), &keys[0], pre_amount*(num_threads-1), valid_values, std::ref(is_valid));
-			utils::stick_thread_to_core(threads[0].native_handle(), 1);
+			utils::stick_thread_to_core(threads[0].native_handle(), utils::core_for_thread(0));
 
 			for(std::uint8_t t = 0; t < num_threads; t++) {
 				threads[t].join();
@@ -371,7 +369,7 @@ namespace dbindex {
 			// Initial insertion phase - Concurrent faster tests
 			for(std::uint8_t t = 0; t < num_threads; t++) {
 				threads[t] = std::thread(insert_concurrent_fixed, std::ref(hash_table), &keys[t*pre_amount], pre_amount, initial_value);
-				utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+				utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 			}
 			for(std::uint8_t t = 0; t < num_threads; t++) {
 				threads[t].join();
@@ -383,7 +381,7 @@ namespace dbindex {
 				std::vector<std::string>::const_iterator last =  keys.begin() + (t+1)*pre_amount;
 				std::vector<std::string> used_keys(first, last);
 				threads[t] = std::thread(scan_concurrent_random_from_vec, std::ref(hash_table), used_keys, scan_amount, valid_values, std::ref(is_valid));
-				utils::stick_thread_to_core(threads[t].native_handle(), (t*2)+1);
+				utils::stick_thread_to_core(threads[t].native_handle(), utils::core_for_thread(t));
 			}
 
 			for(std::uint8_t t = 0; t < num_threads; t++) {
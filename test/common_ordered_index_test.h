@@ -0,0 +1,220 @@
+#ifndef TEST_COMMON_ORDERED_INDEX_TEST_H
+#define TEST_COMMON_ORDERED_INDEX_TEST_H
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include "../src/abstract_index.h"
+#include "../test/common_hash_table_test.h"
+#include "../src/hash_functions/mod_hash.h"
+#include "../src/push_ops.h"
+#include <algorithm>
+#include <atomic>
+#include <random>
+
+namespace dbindex {
+	/*
+	 * The checks every ordered index passes on top of those of
+	 * common_hash_table_test: scans in key order between inclusive bounds,
+	 * and scans that stay consistent while writers change the tree. The
+	 * trees ignore the hash common_hash_table_test is handed.
+	 */
+	template <typename index_type>
+	class common_ordered_index_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, index_type> {
+	protected:
+		mod_hash<hash_value_t, (1<<31)> hash{};
+		index_type tree{};
+
+		struct key_push_op : public abstract_push_op {
+			std::vector<std::string> keys;
+			size_t limit;
+			key_push_op(size_t _limit) : limit(_limit) {}
+			bool invoke(const char *keyp, size_t keylen, const std::string &value) {
+				keys.emplace_back(keyp, keylen);
+				return keys.size() < limit;
+			}
+		};
+
+		std::vector<std::string> scan(const std::string& start_key, const std::string* end_key, bool reverse, size_t limit = ~(size_t)0) {
+			key_push_op po{limit};
+			if (reverse)
+				tree.reverse_range_scan(start_key, end_key, po);
+			else
+				tree.range_scan(start_key, end_key, po);
+			return po.keys;
+		}
+
+		// The numbers below amount as keys, in an order that splits nodes all over the tree
+		static std::vector<std::string> shuffled_keys(std::uint32_t amount, std::default_random_engine& generator) {
+			std::vector<std::string> keys;
+			for (std::uint32_t i = 0; i < amount; i++)
+				keys.push_back(std::to_string(i));
+			std::shuffle(keys.begin(), keys.end(), generator);
+			return keys;
+		}
+
+		/*
+		 * For a tree holding exactly keys, as their own values: every key is
+		 * found, a present key is replaced, and scans visit them all in order.
+		 * Sorts keys.
+		 */
+		void check_filled(std::vector<std::string>& keys) {
+			CPPUNIT_ASSERT(tree.size() == keys.size());
+			std::string value;
+			for (auto& key : keys) {
+				CPPUNIT_ASSERT(tree.get(key, value));
+				CPPUNIT_ASSERT(value == key);
+			}
+			CPPUNIT_ASSERT(!tree.get(std::to_string(keys.size()), value));
+
+			// Inserting a present key replaces its value
+			tree.insert(keys[0], "replaced");
+			CPPUNIT_ASSERT(tree.size() == keys.size());
+			CPPUNIT_ASSERT(tree.get(keys[0], value) && value == "replaced");
+			tree.insert(keys[0], keys[0]);
+
+			std::sort(keys.begin(), keys.end());
+			CPPUNIT_ASSERT(scan("", NULL, false) == keys);
+			CPPUNIT_ASSERT(scan("", NULL, true) == std::vector<std::string>(keys.rbegin(), keys.rend()));
+		}
+
+		// The keys after the first removed ones are all found and scanned in order, every few removals
+		void check_rest(const std::vector<std::string>& keys, std::uint32_t removed) {
+			if (removed % 500 != 1 && keys.size() - removed >= 20)
+				return;
+			std::vector<std::string> rest(keys.begin() + removed, keys.end());
+			std::sort(rest.begin(), rest.end());
+			std::string value;
+			for (auto& key : rest)
+				CPPUNIT_ASSERT(tree.get(key, value) && value == key);
+			CPPUNIT_ASSERT(scan("", NULL, false) == rest);
+			CPPUNIT_ASSERT(scan("", NULL, true) == std::vector<std::string>(rest.rbegin(), rest.rend()));
+		}
+
+	public:
+		common_ordered_index_test() : common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, index_type>(hash, tree) {}
+
+		void test_scan_bounds() {
+			std::cout << "TEST_SCAN_BOUNDS" << std::endl;
+			std::vector<std::string> keys;
+			for (char c = 'b'; c <= 'x'; c += 2) {
+				keys.push_back(std::string(1, c));
+				keys.push_back(std::string(2, c));
+			}
+			for (auto& key : keys)
+				tree.insert(key, key);
+			std::sort(keys.begin(), keys.end());
+
+			// Bounds between keys, on keys and outside of them, a key before its extensions
+			std::vector<std::string> bounds{"", "a", "b", "bb", "bc", "c", "k", "kk", "kkk", "x", "xx", "y"};
+			for (auto& start_key : bounds) {
+				for (auto& end_key : bounds) {
+					std::vector<std::string> expected;
+					for (auto& key : keys) {
+						if (key >= start_key && key <= end_key)
+							expected.push_back(key);
+					}
+					CPPUNIT_ASSERT(scan(start_key, &end_key, false) == expected);
+					std::reverse(expected.begin(), expected.end());
+					CPPUNIT_ASSERT(scan(start_key, &end_key, true) == expected);
+				}
+			}
+
+			// Scans stop when the push op says so
+			CPPUNIT_ASSERT(scan("c", NULL, false, 3) == std::vector<std::string>({"d", "dd", "f"}));
+			CPPUNIT_ASSERT(scan("c", NULL, true, 3) == std::vector<std::string>({"xx", "x", "vv"}));
+		}
+
+		void test_concurrent_churn() {
+			std::cout << "TEST_CONCURRENT_CHURN" << std::endl;
+			std::uint32_t key_amount = 1<<12;
+			std::uint8_t  num_writers = 3;
+			std::vector<std::string> keys{key_amount};
+			for (std::uint32_t i = 0; i < key_amount; i++) {
+				keys[i] = std::to_string(i + key_amount);
+				if (i % 2 == 0)
+					tree.insert(keys[i], keys[i]);
+			}
+
+			// Writers insert and remove the odd keys, reshaping the tree under the scans
+			std::atomic<std::uint32_t> writers_done{0};
+			std::vector<std::thread> writers;
+			for (std::uint8_t w = 0; w < num_writers; w++) {
+				writers.emplace_back([&, w]() {
+					for (std::uint32_t round = 0; round < 4; round++) {
+						for (std::uint32_t i = 1 + 2*w; i < key_amount; i += 2*num_writers)
+							tree.insert(keys[i], keys[i]);
+						for (std::uint32_t i = 1 + 2*w; i < key_amount; i += 2*num_writers)
+							tree.remove(keys[i]);
+					}
+					writers_done++;
+				});
+			}
+
+			// Every scan sees the even keys, present throughout, in order and once
+			bool is_valid = true;
+			std::default_random_engine generator{};
+			std::uniform_int_distribution<std::uint32_t> start_distribution{0, key_amount-1};
+			while (writers_done.load() < num_writers) {
+				std::uint32_t start = start_distribution(generator);
+				std::uint32_t end = std::min(start + 200, key_amount-1);
+				bool reverse = start % 2 == 1;
+				std::vector<std::string> result = scan(keys[start], &keys[end], reverse);
+				if (reverse)
+					std::reverse(result.begin(), result.end());
+				is_valid &= std::is_sorted(result.begin(), result.end()) &&
+				            std::adjacent_find(result.begin(), result.end()) == result.end();
+				for (std::uint32_t i = (start+1)/2*2; i <= end; i += 2)
+					is_valid &= std::binary_search(result.begin(), result.end(), keys[i]);
+			}
+			for (auto& writer : writers)
+				writer.join();
+
+			CPPUNIT_ASSERT(is_valid);
+			CPPUNIT_ASSERT(tree.size() == key_amount/2);
+			CPPUNIT_ASSERT(scan("", NULL, false).size() == key_amount/2);
+		}
+
+		// Adds the tests above and those of common_hash_table_test to the suite of fixture
+		template <typename fixture>
+		static void add_common_tests(CppUnit::TestSuite* suite_of_tests) {
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+            	           "test_insert",
+            	           	&fixture::test_insert ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                	       "test_delete",
+                    	   &fixture::test_delete ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                	       "test_update",
+                    	   &fixture::test_update ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                	       "test_scan",
+                    	   &fixture::test_scan ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                       		"test_insert_delete_many",
+                       		&fixture::test_insert_delete_many ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                       		"test_scan_bounds",
+                       		&fixture::test_scan_bounds ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                       		"test_concurrent_different",
+                       		&fixture::test_concurrent_different ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                       		"test_concurrent_all",
+                       		&fixture::test_concurrent_all ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                       		"test_concurrent_updates_known",
+                       		&fixture::test_concurrent_updates_known ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                       		"test_concurrent_scans",
+                       		&fixture::test_concurrent_scans ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<fixture>(
+                       		"test_concurrent_churn",
+                       		&fixture::test_concurrent_churn ) );
+		}
+	};
+}
+#endif /* TEST_COMMON_ORDERED_INDEX_TEST_H */
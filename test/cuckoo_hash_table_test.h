@@ -0,0 +1,128 @@
+#ifndef TEST_CUCKOO_HASH_TABLE_TEST_H
+#define TEST_CUCKOO_HASH_TABLE_TEST_H
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include "../src/abstract_index.h"
+#include "../test/common_hash_table_test.h"
+#include "../src/hash_index/cuckoo_hash_table.h"
+#include "../src/hash_functions/mod_hash.h"
+#include "../src/push_ops.h"
+#include <thread>
+
+namespace dbindex {
+	constexpr std::uint32_t cuckoo_bucket_count = 16;
+	constexpr std::uint32_t cuckoo_lock_count   = 4;
+
+	class cuckoo_hash_table_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, cuckoo_hash_table<cuckoo_bucket_count, cuckoo_lock_count>> {
+	private:
+		mod_hash<hash_value_t, (1<<31)> hash{};
+		cuckoo_hash_table<cuckoo_bucket_count, cuckoo_lock_count> hash_table{hash};
+		concat_push_op concat_push{};
+
+	public:
+		cuckoo_hash_table_test() : common_hash_table_test(hash, hash_table){}
+
+		void test_high_load() {
+			std::cout << "TEST_HIGH_LOAD" << std::endl;
+			const std::uint32_t capacity = cuckoo_bucket_count*4;
+			CPPUNIT_ASSERT(hash_table.capacity() == capacity);
+
+			// Filled beyond 90% without growing, moving entries to their other bucket
+			std::uint32_t amount = capacity * 15 / 16;
+			for (std::uint32_t i = 0; i < amount; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.capacity() == capacity);
+			CPPUNIT_ASSERT(hash_table.stash_entries() == 0);
+
+			std::string value;
+			for (std::uint32_t i = 0; i < amount; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value));
+				CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+
+			// Grows once full
+			for (std::uint32_t i = amount; i < 4*capacity; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.capacity() > capacity);
+			CPPUNIT_ASSERT(hash_table.size() == 4*capacity);
+			for (std::uint32_t i = 0; i < 4*capacity; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value));
+				CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+			CPPUNIT_ASSERT(!hash_table.get(std::to_string(4*capacity), value));
+		}
+
+		void test_colliding_keys() {
+			std::cout << "TEST_COLLIDING_KEYS" << std::endl;
+			// Non numeric keys of the same length share their hash value, and
+			// only two buckets, the rest goes to the stash
+			std::vector<std::string> keys;
+			for (char c = 'a'; c < 'a' + 20; c++)
+				keys.push_back(std::string("k") + c);
+
+			for (auto& key : keys)
+				hash_table.insert(key, key);
+			CPPUNIT_ASSERT(hash_table.size() == keys.size());
+			CPPUNIT_ASSERT(hash_table.stash_entries() == keys.size() - 8);
+			CPPUNIT_ASSERT(hash_table.capacity() == cuckoo_bucket_count*4);
+
+			std::string value;
+			for (auto& key : keys) {
+				hash_table.update(key, key + "'");
+				CPPUNIT_ASSERT(hash_table.get(key, value));
+				CPPUNIT_ASSERT(value == key + "'");
+			}
+			for (auto& key : keys)
+				hash_table.remove(key);
+			CPPUNIT_ASSERT(hash_table.size() == 0);
+			CPPUNIT_ASSERT(hash_table.stash_entries() == 0);
+			for (auto& key : keys)
+				CPPUNIT_ASSERT(!hash_table.get(key, value));
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "cuckoo_hash_table_suite" );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+            	           "test_insert",
+            	           	&cuckoo_hash_table_test::test_insert ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                	       "test_delete",
+                    	   &cuckoo_hash_table_test::test_delete ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                	       "test_update",
+                    	   &cuckoo_hash_table_test::test_update ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                	       "test_scan",
+                    	   &cuckoo_hash_table_test::test_scan ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                       		"test_insert_delete_many",
+                       		&cuckoo_hash_table_test::test_insert_delete_many ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                       		"test_high_load",
+                       		&cuckoo_hash_table_test::test_high_load ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                       		"test_colliding_keys",
+                       		&cuckoo_hash_table_test::test_colliding_keys ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                       		"test_concurrent_different",
+                       		&cuckoo_hash_table_test::test_concurrent_different ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                       		"test_concurrent_all",
+                       		&cuckoo_hash_table_test::test_concurrent_all ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                       		"test_concurrent_updates_known",
+                       		&cuckoo_hash_table_test::test_concurrent_updates_known ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<cuckoo_hash_table_test>(
+                       		"test_concurrent_scans",
+                       		&cuckoo_hash_table_test::test_concurrent_scans ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_CUCKOO_HASH_TABLE_TEST_H */
@@ -0,0 +1,100 @@
+#ifndef TEST_EPOCH_MANAGER_TEST_H
+#define TEST_EPOCH_MANAGER_TEST_H
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include "../src/util/epoch_manager.h"
+#include <atomic>
+#include <thread>
+
+namespace dbindex {
+	class epoch_manager_test : public CppUnit::TestFixture {
+	private:
+		struct counted {
+			static std::atomic<int> live;
+			counted()  { live++; }
+			~counted() { live--; }
+		};
+
+		utils::epoch_manager& manager = utils::epoch_manager::instance();
+
+		// Retires reclaim_interval objects, so the calling thread reclaims once
+		void retire_interval() {
+			for (std::uint32_t i = 0; i < utils::epoch_manager::reclaim_interval; i++)
+				manager.retire(new counted());
+		}
+
+	public:
+		void setUp() {
+			manager.reclaim();
+			manager.reclaim();
+			counted::live = 0;
+		}
+
+		void test_reader_blocks_reclaim() {
+			std::cout << "TEST_READER_BLOCKS_RECLAIM" << std::endl;
+			std::atomic<bool> entered{false};
+			std::atomic<bool> leave{false};
+			std::thread reader([&]() {
+				utils::epoch_manager::guard epoch_guard;
+				entered = true;
+				while (!leave)
+					std::this_thread::yield();
+			});
+			while (!entered)
+				std::this_thread::yield();
+
+			// Retired while the reader may still see them
+			retire_interval();
+			manager.reclaim();
+			CPPUNIT_ASSERT(counted::live == (int)utils::epoch_manager::reclaim_interval);
+
+			leave = true;
+			reader.join();
+			manager.reclaim();
+			CPPUNIT_ASSERT(counted::live == 0);
+			CPPUNIT_ASSERT(manager.pending() == 0);
+		}
+
+		void test_reclaim_while_running() {
+			std::cout << "TEST_RECLAIM_WHILE_RUNNING" << std::endl;
+			// Without readers, retiring frees earlier retirements without an explicit reclaim
+			for (std::uint32_t round = 0; round < 8; round++)
+				retire_interval();
+			CPPUNIT_ASSERT(counted::live <= 2 * (int)utils::epoch_manager::reclaim_interval);
+		}
+
+		void test_thread_exit() {
+			std::cout << "TEST_THREAD_EXIT" << std::endl;
+			// The retired objects of a thread outlive it and are freed by another
+			std::thread writer([&]() {
+				utils::epoch_manager::thread_registration registration;
+				manager.retire(new counted());
+			});
+			writer.join();
+			CPPUNIT_ASSERT(counted::live == 1);
+			manager.reclaim();
+			CPPUNIT_ASSERT(counted::live == 0);
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "epoch_manager_suite" );
+			suite_of_tests->addTest( new CppUnit::TestCaller<epoch_manager_test>(
+                       		"test_reader_blocks_reclaim",
+                       		&epoch_manager_test::test_reader_blocks_reclaim ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<epoch_manager_test>(
+                       		"test_reclaim_while_running",
+                       		&epoch_manager_test::test_reclaim_while_running ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<epoch_manager_test>(
+                       		"test_thread_exit",
+                       		&epoch_manager_test::test_thread_exit ) );
+			return suite_of_tests;
+		};
+	};
+
+	std::atomic<int> epoch_manager_test::counted::live{0};
+}
+#endif /* TEST_EPOCH_MANAGER_TEST_H */
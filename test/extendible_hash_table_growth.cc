@@ -0,0 +1,90 @@
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "../src/hash_functions/murmur_hash_32.h"
+#include "../src/hash_index/extendible_hash_table.h"
+#include "../src/hash_index/array_hash_table.h"
+#include "../src/hash_index/linear_hash_table.h"
+
+typedef std::uint32_t hash_value_t;
+
+/*
+ * Insert latency while the extendible hash table grows from empty, with the
+ * directory doubled in one step against doubling spread over later writes,
+ * and with buckets filling one or two cache lines. The array hash table,
+ * which migrates its buckets incrementally, and the linear hash table,
+ * which splits one bucket at a time, grow from the same size.
+ * Writes "<percentile>\t<nanoseconds>" per mode to results/.
+ */
+void measure_growth(dbindex::abstract_index& hash_table, std::string index_string, std::uint32_t key_count) {
+    using namespace std::chrono;
+
+    std::vector<std::string> keys(key_count);
+    for (std::uint32_t i = 0; i < key_count; i++) {
+        keys[i] = std::to_string(i);
+    }
+    std::vector<std::uint64_t> latencies(key_count);
+
+    high_resolution_clock::time_point run_start = high_resolution_clock::now();
+    for (std::uint32_t i = 0; i < key_count; i++) {
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+        hash_table.insert(keys[i], keys[i]);
+        latencies[i] = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+    }
+    std::uint64_t total = duration_cast<milliseconds>(high_resolution_clock::now() - run_start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    const double percentiles[] = {50, 90, 99, 99.9, 99.99, 100};
+
+    std::ofstream out_file;
+    std::string path = "results/growth_" + index_string + ".txt";
+    out_file.open(path);
+    std::cout << index_string << ", " << key_count << " inserts in " << total << " ms" << std::endl;
+    for (double p : percentiles) {
+        std::uint64_t latency = latencies[std::min<std::uint64_t>(key_count - 1, (std::uint64_t)(p / 100 * key_count))];
+        std::cout << "  p" << p << ": " << latency << " ns" << std::endl;
+        if (out_file.is_open()) {
+            out_file << p << "\t" << latency << "\n";
+        }
+    }
+    out_file.close();
+}
+
+int main(int argc, char *argv[]) {
+    constexpr std::uint8_t initial_global_depht = 2;
+    constexpr std::uint32_t migrate_slots = 64;
+
+    std::uint32_t key_count = 1<<20;
+    if (argc > 1)
+        key_count = std::stoul(argv[1]);
+
+    dbindex::murmur_hash_32<hash_value_t> hash;
+    {
+        dbindex::extendible_hash_table<initial_global_depht> hash_table(hash);
+        measure_growth(hash_table, "extendible_hash_table", key_count);
+    }
+    {
+        dbindex::extendible_hash_table<initial_global_depht, true, migrate_slots> hash_table(hash);
+        measure_growth(hash_table, "extendible_hash_table_incremental", key_count);
+    }
+    {
+        dbindex::extendible_hash_table<initial_global_depht, true, 0, dbindex::extendible_bucket_entries(1)> hash_table(hash);
+        measure_growth(hash_table, "extendible_hash_table_1_line", key_count);
+    }
+    {
+        dbindex::extendible_hash_table<initial_global_depht, true, 0, dbindex::extendible_bucket_entries(2)> hash_table(hash);
+        measure_growth(hash_table, "extendible_hash_table_2_lines", key_count);
+    }
+    {
+        dbindex::array_hash_table<> hash_table(hash, 1<<initial_global_depht);
+        measure_growth(hash_table, "array_hash_table", key_count);
+    }
+    {
+        dbindex::linear_hash_table<1<<initial_global_depht> hash_table(hash);
+        measure_growth(hash_table, "linear_hash_table", key_count);
+    }
+}
@@ -95,6 +95,75 @@ namespace dbindex {
 				hash_table.remove(std::to_string(i*hash_table.get_bucket_entries()));
 				}
 			CPPUNIT_ASSERT(hash_table.size() == 0);
+
+			// Emptied buddies merge back and the directory halves down to where it started
+			CPPUNIT_ASSERT(hash_table.get_global_depth() == 2);
+			CPPUNIT_ASSERT(hash_table.bucket_count() == 4);
+		}
+
+		void test_merge() {
+			std::cout << "TEST_MERGE" << std::endl;
+			std::uint32_t amount = 1<<10;
+			for (std::uint32_t i = 0; i < amount; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			std::uint8_t grown_depth = hash_table.get_global_depth();
+			size_t grown_buckets = hash_table.bucket_count();
+			CPPUNIT_ASSERT(grown_depth > 2);
+
+			// Keeping the first eighth of the keys halves the live data three times
+			for (std::uint32_t i = amount / 8; i < amount; i++)
+				hash_table.remove(std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.size() == amount / 8);
+			CPPUNIT_ASSERT(hash_table.get_global_depth() < grown_depth);
+			CPPUNIT_ASSERT(hash_table.bucket_count() * 4 <= grown_buckets);
+
+			std::string value;
+			for (std::uint32_t i = 0; i < amount; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value) == (i < amount / 8));
+				if (i < amount / 8)
+					CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+
+			// Merged buckets split again
+			for (std::uint32_t i = amount / 8; i < amount; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.get_global_depth() == grown_depth);
+			for (std::uint32_t i = 0; i < amount; i++)
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value) && value == std::to_string(i));
+		}
+
+		void test_overflow() {
+			std::cout << "TEST_OVERFLOW" << std::endl;
+			CPPUNIT_ASSERT(hash_table.get_global_depth() == 2);
+
+			// Non numeric keys hash to their length, no split can separate them
+			std::vector<std::string> keys;
+			for (std::uint32_t i = 0; i < hash_table.get_bucket_capacity(); i++)
+				keys.push_back(std::string(1, 'a'+i));
+			for (auto& key : keys)
+				hash_table.insert(key, key);
+			CPPUNIT_ASSERT(hash_table.get_global_depth() == 2);
+			CPPUNIT_ASSERT(hash_table.size() == hash_table.get_bucket_capacity());
+			CPPUNIT_ASSERT_THROW(hash_table.insert("z", "z"), std::string);
+
+			std::string value;
+			for (auto& key : keys) {
+				CPPUNIT_ASSERT(hash_table.get(key, value));
+				CPPUNIT_ASSERT(value == key);
+			}
+			hash_table.update(keys.back(), "updated");
+			CPPUNIT_ASSERT(hash_table.get(keys.back(), value) && value == "updated");
+			hash_table.remove(keys.front());
+			CPPUNIT_ASSERT(!hash_table.get(keys.front(), value));
+			CPPUNIT_ASSERT(hash_table.get(keys.back(), value) && value == "updated");
+			CPPUNIT_ASSERT(hash_table.size() == hash_table.get_bucket_capacity()-1u);
+
+			// Hash values only differing in high bits are chained instead of growing the directory
+			for (std::uint32_t i = 0; i < hash_table.get_bucket_capacity(); i++)
+				hash_table.insert(std::to_string(i<<20), " 1");
+			CPPUNIT_ASSERT(hash_table.get_global_depth() == 2);
+			for (std::uint32_t i = 0; i < hash_table.get_bucket_capacity(); i++)
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i<<20), value));
 		}
 
 		void test_spec() {
@@ -141,9 +210,16 @@ namespace dbindex {
                        		"test_double_split",
                        		&extendible_hash_table_test::test_double_split ) );
 
+			suite_of_tests->addTest( new CppUnit::TestCaller<extendible_hash_table_test>(
+                       		"test_overflow",
+                       		&extendible_hash_table_test::test_overflow ) );
+
 			suite_of_tests->addTest( new CppUnit::TestCaller<extendible_hash_table_test>(
                        		"test_insert_delete_many",
                        		&extendible_hash_table_test::test_insert_delete_many ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<extendible_hash_table_test>(
+                       		"test_merge",
+                       		&extendible_hash_table_test::test_merge ) );
 			
 			suite_of_tests->addTest( new CppUnit::TestCaller<extendible_hash_table_test>(
                        		"test_concurrent_different",
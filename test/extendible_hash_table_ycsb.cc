@@ -2,6 +2,8 @@
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 
 #include "../src/hash_functions/abstract_hash.h"
 #include "../src/hash_functions/mod_hash.h"
@@ -11,6 +13,15 @@
 #include "../src/hash_index/array_hash_table.h"
 #include "../src/hash_index/partitioned_array_hash_table.h"
 #include "../src/hash_index/extendible_hash_table.h"
+#include "../src/hash_index/swiss_hash_table.h"
+#include "../src/hash_index/cuckoo_hash_table.h"
+#include "../src/hash_index/split_ordered_hash_table.h"
+#include "../src/hash_index/robin_hood_hash_table.h"
+#include "../src/hash_index/hopscotch_hash_table.h"
+#include "../src/hash_index/linear_hash_table.h"
+#include "../src/ordered_index/bplustreeindex.h"
+#include "../src/ordered_index/blinktreeindex.h"
+#include "../src/ordered_index/bwtreeindex.h"
 #include "../src/benchmarks/ycsb/client.h"
 #include "../src/benchmarks/ycsb/core_workloads.h"
 
@@ -32,6 +43,8 @@ ycsb::workload_properties parse_workload_string(std::string workload_string) {
 
     if (workload_string.compare("workload_read") == 0)
         return ycsb::workload_read;
+    if (workload_string.compare("workload_read_uniform") == 0)
+        return ycsb::workload_read_uniform;
     if (workload_string.compare("workload_update") == 0)
         return ycsb::workload_update;
     if (workload_string.compare("workload_scan") == 0)
@@ -61,6 +74,8 @@ std::string workload_to_string(ycsb::workload_properties workload_x) {
 
     if (workload_x == ycsb::workload_read)
         return "workload_read";
+    if (workload_x == ycsb::workload_read_uniform)
+        return "workload_read_uniform";
     if (workload_x == ycsb::workload_update)
         return "workload_update";
     if (workload_x == ycsb::workload_scan)
@@ -74,6 +89,30 @@ std::string workload_to_string(ycsb::workload_properties workload_x) {
     return "workload_a";
 }
 
+template<typename value_t>
+void print_balance(const std::string& name, const std::vector<value_t>& per_partition) {
+    double total = 0;
+    value_t max = 0;
+    std::cout << name << " per partition:";
+    for (value_t v : per_partition) {
+        std::cout << " " << v;
+        total += v;
+        max = std::max(max, v);
+    }
+    double mean = total / per_partition.size();
+    std::cout << std::endl << "  max/mean: " << (mean > 0 ? max / mean : 0) << std::endl;
+}
+
+// How evenly the partitions are filled and used, and from which NUMA nodes they were called
+template<typename partitioned_index>
+void report_partitions(partitioned_index& index) {
+    print_balance("Entries", index.partition_sizes());
+    print_balance("Accesses", index.partition_accesses());
+    std::cout << "NUMA nodes: " << utils::numa_topology::instance().node_count()
+              << ", calls from the home node: " << index.calls_from_home_node()
+              << ", from other nodes: " << index.calls_from_other_nodes() << std::endl;
+}
+
 void test_workload_a(std::uint8_t thread_count, std::string workload_string, std::uint8_t hash_func_num, std::uint8_t hash_index_num) {
     using namespace std::chrono;
 
@@ -88,6 +127,9 @@ void test_workload_a(std::uint8_t thread_count, std::string workload_string, std
 
     dbindex::abstract_hash<std::uint32_t>* hash;
     dbindex::abstract_index* hash_table;
+    // Set for the partitioned indexes, which report how their partitions were filled and accessed
+    dbindex::partitioned_array_hash_table<prefix_bits, directory_size, dbindex::partition_routing::key_prefix, true>* partitioned = nullptr;
+    dbindex::partitioned_array_hash_table<prefix_bits, directory_size, dbindex::partition_routing::hash, true>* partitioned_hashed = nullptr;
 
     std::string hash_func_string;
     std::string hash_index_string;
@@ -118,7 +160,7 @@ void test_workload_a(std::uint8_t thread_count, std::string workload_string, std
     switch(hash_index_num) {
     case 0:
         hash_index_string = "array_hash_table";
-        hash_table = new dbindex::array_hash_table<directory_size>(*hash); 
+        hash_table = new dbindex::array_hash_table<>(*hash, directory_size); 
         break;
     case 1:
         hash_index_string = "extendible_hash_table";
@@ -126,7 +168,58 @@ void test_workload_a(std::uint8_t thread_count, std::string workload_string, std
         break;
     case 2:
         hash_index_string = "partitioned_array_hash_table";
-        hash_table = new dbindex::partitioned_array_hash_table<prefix_bits, directory_size>(*hash);
+        partitioned = new dbindex::partitioned_array_hash_table<prefix_bits, directory_size, dbindex::partition_routing::key_prefix, true>(*hash);
+        hash_table = partitioned;
+        break;
+    case 3:
+        hash_index_string = "extendible_hash_table_locked";
+        hash_table = new dbindex::extendible_hash_table<initial_global_depht, false>(*hash);
+        break;
+    case 4:
+        hash_index_string = "swiss_hash_table";
+        hash_table = new dbindex::swiss_hash_table<>(*hash);
+        break;
+    case 5:
+        hash_index_string = "cuckoo_hash_table";
+        hash_table = new dbindex::cuckoo_hash_table<>(*hash);
+        break;
+    case 6:
+        hash_index_string = "split_ordered_hash_table";
+        hash_table = new dbindex::split_ordered_hash_table<>(*hash);
+        break;
+    case 7:
+        hash_index_string = "robin_hood_hash_table";
+        hash_table = new dbindex::robin_hood_hash_table<>(*hash);
+        break;
+    case 8:
+        hash_index_string = "hopscotch_hash_table";
+        hash_table = new dbindex::hopscotch_hash_table<>(*hash);
+        break;
+    case 9:
+        hash_index_string = "linear_hash_table";
+        hash_table = new dbindex::linear_hash_table<>(*hash);
+        break;
+    case 10:
+        hash_index_string = "partitioned_array_hash_table_hashed";
+        partitioned_hashed = new dbindex::partitioned_array_hash_table<prefix_bits, directory_size, dbindex::partition_routing::hash, true>(*hash);
+        hash_table = partitioned_hashed;
+        break;
+    case 11:
+        hash_index_string = "partitioned_array_hash_table_delegated";
+        hash_table = new dbindex::partitioned_array_hash_table<prefix_bits, directory_size, dbindex::partition_routing::hash, false, dbindex::partition_execution::delegated>(*hash);
+        break;
+    case 12:
+        // Ordered, the hash function is not used
+        hash_index_string = "bplustreeindex";
+        hash_table = new dbindex::bplustree::bplustreeindex();
+        break;
+    case 13:
+        hash_index_string = "blinktreeindex";
+        hash_table = new dbindex::blinktree::blinktreeindex();
+        break;
+    case 14:
+        hash_index_string = "bwtreeindex";
+        hash_table = new dbindex::bwtree::bwtreeindex();
         break;
     default:
         std::cout << "Unknown hash_index_num: \"" << hash_index_num << "\"." << std::endl;
@@ -139,6 +232,10 @@ void test_workload_a(std::uint8_t thread_count, std::string workload_string, std
     ycsb::client client(*hash_table, workload, thread_count);
     client.run_build_records(1);
     std::cout << "Records built" << std::endl;
+    if (partitioned)
+        partitioned->reset_access_counts();
+    if (partitioned_hashed)
+        partitioned_hashed->reset_access_counts();
     // Calculating the hashing
     std::uint32_t iterations = 25;
 
@@ -185,6 +282,10 @@ void test_workload_a(std::uint8_t thread_count, std::string workload_string, std
         out_file << t << "\t" << mean << "\t" << var << "\n";
         std::cout << "Data written" << std::endl;
     }
+    if (partitioned)
+        report_partitions(*partitioned);
+    if (partitioned_hashed)
+        report_partitions(*partitioned_hashed);
     out_file.flush();
     if (out_file.fail())
       std::cout << "Something failed" << std::endl;
@@ -207,7 +308,10 @@ int main(int argc, char *argv[]) {
         hash_func_num = (std::uint8_t)(argv[2][0]-'0');
 
     if (argc > 3)
-        hash_index_num = (std::uint8_t)(argv[3][0]-'0');
+        hash_index_num = (std::uint8_t)std::stoi(argv[3]);
+
+    if (argc > 4)
+        thread_count = (std::uint8_t)std::stoi(argv[4]);
 
 
     test_workload_a(thread_count, workload_string, hash_func_num, hash_index_num);
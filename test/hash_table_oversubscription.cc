@@ -0,0 +1,113 @@
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "../src/hash_functions/murmur_hash_32.h"
+#include "../src/hash_index/array_hash_table.h"
+#include "../src/hash_index/extendible_hash_table.h"
+#include "../src/hash_index/cuckoo_hash_table.h"
+#include "../src/hash_index/split_ordered_hash_table.h"
+
+typedef std::uint32_t hash_value_t;
+
+/*
+ * Throughput and latency with more threads than cores. Every thread runs
+ * 90% gets and 10% updates on uniformly chosen keys. A thread descheduled
+ * while holding a lock stalls every other thread on that lock, which shows
+ * in the tail latency.
+ * Writes "<threads>\t<ops per second>\t<p99>\t<p99.9>\t<max>" per index to results/.
+ */
+void run_threads(dbindex::abstract_index& hash_table, std::uint32_t thread_count, std::uint32_t key_count,
+                 std::uint32_t ops_per_thread, std::ofstream& out_file) {
+    using namespace std::chrono;
+
+    std::vector<std::vector<std::uint64_t>> latencies(thread_count, std::vector<std::uint64_t>(ops_per_thread));
+    std::vector<std::thread> threads;
+    high_resolution_clock::time_point run_start = high_resolution_clock::now();
+    for (std::uint32_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 generator(t);
+            std::uniform_int_distribution<std::uint32_t> key_distribution(0, key_count-1);
+            std::uniform_int_distribution<std::uint32_t> op_distribution(0, 9);
+            std::string value;
+            for (std::uint32_t i = 0; i < ops_per_thread; i++) {
+                std::string key = std::to_string(key_distribution(generator));
+                bool is_update = op_distribution(generator) == 0;
+                high_resolution_clock::time_point start = high_resolution_clock::now();
+                if (is_update) {
+                    hash_table.update(key, key);
+                } else {
+                    hash_table.get(key, value);
+                }
+                latencies[t][i] = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = duration_cast<duration<double>>(high_resolution_clock::now() - run_start).count();
+
+    std::vector<std::uint64_t> all;
+    for (auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all[std::min<std::uint64_t>(all.size() - 1, (std::uint64_t)(p / 100 * all.size()))];
+    };
+    double throughput = all.size() / seconds;
+    std::cout << "  " << thread_count << " threads: " << (std::uint64_t)throughput << " ops/s, p99 " << percentile(99)
+              << " ns, p99.9 " << percentile(99.9) << " ns, max " << all.back() << " ns" << std::endl;
+    out_file << thread_count << "\t" << throughput << "\t" << percentile(99) << "\t" << percentile(99.9) << "\t" << all.back() << "\n";
+}
+
+void measure_oversubscription(dbindex::abstract_index& hash_table, std::uint32_t key_count, std::uint32_t ops_per_thread) {
+    for (std::uint32_t i = 0; i < key_count; i++) {
+        std::string key = std::to_string(i);
+        hash_table.insert(key, key);
+    }
+
+    std::ofstream out_file;
+    out_file.open("results/oversubscription_" + hash_table.to_string() + ".txt");
+    std::uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << hash_table.to_string() << ", " << cores << " cores" << std::endl;
+    for (std::uint32_t factor : {1, 2, 4, 8}) {
+        run_threads(hash_table, factor * cores, key_count, ops_per_thread, out_file);
+    }
+    out_file.close();
+}
+
+int main(int argc, char *argv[]) {
+    std::uint32_t key_count = 100000;
+    std::uint32_t ops_per_thread = 200000;
+    if (argc > 1)
+        ops_per_thread = std::stoul(argv[1]);
+
+    dbindex::murmur_hash_32<hash_value_t> hash;
+    {
+        dbindex::array_hash_table<> hash_table(hash, 1<<14);
+        measure_oversubscription(hash_table, key_count, ops_per_thread);
+    }
+    {
+        dbindex::extendible_hash_table<2, false> hash_table(hash);
+        measure_oversubscription(hash_table, key_count, ops_per_thread);
+    }
+    {
+        dbindex::extendible_hash_table<2> hash_table(hash);
+        measure_oversubscription(hash_table, key_count, ops_per_thread);
+    }
+    {
+        dbindex::cuckoo_hash_table<> hash_table(hash);
+        measure_oversubscription(hash_table, key_count, ops_per_thread);
+    }
+    {
+        dbindex::split_ordered_hash_table<> hash_table(hash);
+        measure_oversubscription(hash_table, key_count, ops_per_thread);
+    }
+}
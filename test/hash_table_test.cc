@@ -1,6 +1,16 @@
 #include "extendible_hash_table_test.h"
 #include "array_hash_table_test.h"
 #include "partitioned_array_hash_table_test.h"
+#include "swiss_hash_table_test.h"
+#include "cuckoo_hash_table_test.h"
+#include "split_ordered_hash_table_test.h"
+#include "robin_hood_hash_table_test.h"
+#include "hopscotch_hash_table_test.h"
+#include "linear_hash_table_test.h"
+#include "bplustreeindex_test.h"
+#include "blinktreeindex_test.h"
+#include "bwtreeindex_test.h"
+#include "epoch_manager_test.h"
 #include <cppunit/TestCase.h>
 #include <cppunit/TestFixture.h>
 #include <cppunit/ui/text/TestRunner.h>
@@ -18,6 +28,16 @@ int main(int argc, char *argv[]) {
 	runner.addTest( dbindex::extendible_hash_table_test::suite() );
 	runner.addTest( dbindex::array_hash_table_test::suite() );
 	runner.addTest( dbindex::partitioned_array_hash_table_test::suite() );
+	runner.addTest( dbindex::swiss_hash_table_test::suite() );
+	runner.addTest( dbindex::cuckoo_hash_table_test::suite() );
+	runner.addTest( dbindex::split_ordered_hash_table_test::suite() );
+	runner.addTest( dbindex::robin_hood_hash_table_test::suite() );
+	runner.addTest( dbindex::hopscotch_hash_table_test::suite() );
+	runner.addTest( dbindex::linear_hash_table_test::suite() );
+	runner.addTest( dbindex::bplustreeindex_test::suite() );
+	runner.addTest( dbindex::blinktreeindex_test::suite() );
+	runner.addTest( dbindex::bwtreeindex_test::suite() );
+	runner.addTest( dbindex::epoch_manager_test::suite() );
 
 	runner.run();
 	std::cout << "end" << std::endl;
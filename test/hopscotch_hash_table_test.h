@@ -0,0 +1,150 @@
+#ifndef TEST_HOPSCOTCH_HASH_TABLE_TEST_H
+#define TEST_HOPSCOTCH_HASH_TABLE_TEST_H
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include "../src/abstract_index.h"
+#include "../test/common_hash_table_test.h"
+#include "../src/hash_index/hopscotch_hash_table.h"
+#include "../src/hash_functions/mod_hash.h"
+#include "../src/push_ops.h"
+#include <thread>
+
+namespace dbindex {
+	constexpr std::uint32_t hopscotch_segment_capacity = 64;
+	constexpr std::uint32_t hopscotch_segment_count    = 4;
+
+	class hopscotch_hash_table_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, hopscotch_hash_table<hopscotch_segment_capacity, hopscotch_segment_count>> {
+	private:
+		mod_hash<hash_value_t, (1<<31)> hash{};
+		hopscotch_hash_table<hopscotch_segment_capacity, hopscotch_segment_count> hash_table{hash};
+		concat_push_op concat_push{};
+
+	public:
+		hopscotch_hash_table_test() : common_hash_table_test(hash, hash_table){}
+
+		void test_grow() {
+			std::cout << "TEST_GROW" << std::endl;
+			const std::uint32_t capacity = hopscotch_segment_capacity*hopscotch_segment_count;
+			CPPUNIT_ASSERT(hash_table.capacity() == capacity);
+
+			// Consecutive keys have consecutive home slots and fill every segment without growing
+			for (std::uint32_t i = 0; i < capacity; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.capacity() == capacity);
+
+			for (std::uint32_t i = capacity; i < 64*capacity; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.size() == 64*capacity);
+			CPPUNIT_ASSERT(hash_table.capacity() >= 64*capacity);
+			CPPUNIT_ASSERT(hash_table.overflow_entries() == 0);
+
+			std::string value;
+			for (std::uint32_t i = 0; i < 64*capacity; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value));
+				CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+			CPPUNIT_ASSERT(!hash_table.get(std::to_string(64*capacity), value));
+		}
+
+		void test_hop() {
+			std::cout << "TEST_HOP" << std::endl;
+			// Keys of the first segment with home slots 1 to 40, one each
+			std::vector<std::string> keys;
+			for (std::uint32_t i = 1; i <= 40; i++)
+				keys.push_back(std::to_string(i * hopscotch_segment_count));
+			for (auto& key : keys)
+				hash_table.insert(key, key);
+
+			// Another key of home slot 1. The first free slot is 41, too far,
+			// so the entry of slot 10 hops there and frees a slot in reach.
+			keys.push_back(std::to_string(hopscotch_segment_count * (1 + hopscotch_segment_capacity)));
+			hash_table.insert(keys.back(), keys.back());
+			CPPUNIT_ASSERT(hash_table.capacity() == hopscotch_segment_capacity*hopscotch_segment_count);
+			CPPUNIT_ASSERT(hash_table.overflow_entries() == 0);
+
+			std::string value;
+			for (auto& key : keys) {
+				CPPUNIT_ASSERT(hash_table.get(key, value));
+				CPPUNIT_ASSERT(value == key);
+			}
+			for (auto& key : keys)
+				hash_table.remove(key);
+			CPPUNIT_ASSERT(hash_table.size() == 0);
+		}
+
+		void test_colliding_keys() {
+			std::cout << "TEST_COLLIDING_KEYS" << std::endl;
+			// Keys of one segment and one home slot at any capacity. A
+			// neighborhood holds 32 of them, the segment grows once and the
+			// rest go to the overflow list.
+			std::vector<std::string> keys;
+			for (std::uint32_t i = 1; i <= 40; i++)
+				keys.push_back(std::to_string(i << 20));
+			for (auto& key : keys)
+				hash_table.insert(key, key);
+			CPPUNIT_ASSERT(hash_table.size() == 40);
+			CPPUNIT_ASSERT(hash_table.overflow_entries() == 8);
+			CPPUNIT_ASSERT(hash_table.capacity() == hopscotch_segment_capacity*(hopscotch_segment_count+1));
+
+			std::string value;
+			for (auto& key : keys) {
+				hash_table.update(key, key + "u");
+				CPPUNIT_ASSERT(hash_table.get(key, value));
+				CPPUNIT_ASSERT(value == key + "u");
+			}
+			for (auto& key : keys)
+				hash_table.remove(key);
+			CPPUNIT_ASSERT(hash_table.size() == 0);
+			CPPUNIT_ASSERT(hash_table.overflow_entries() == 0);
+			CPPUNIT_ASSERT(!hash_table.get(keys[0], value));
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "hopscotch_hash_table_suite" );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+            	           "test_insert",
+            	           	&hopscotch_hash_table_test::test_insert ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                	       "test_delete",
+                    	   &hopscotch_hash_table_test::test_delete ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                	       "test_update",
+                    	   &hopscotch_hash_table_test::test_update ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                	       "test_scan",
+                    	   &hopscotch_hash_table_test::test_scan ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                       		"test_insert_delete_many",
+                       		&hopscotch_hash_table_test::test_insert_delete_many ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                       		"test_grow",
+                       		&hopscotch_hash_table_test::test_grow ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                       		"test_hop",
+                       		&hopscotch_hash_table_test::test_hop ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                       		"test_colliding_keys",
+                       		&hopscotch_hash_table_test::test_colliding_keys ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                       		"test_concurrent_different",
+                       		&hopscotch_hash_table_test::test_concurrent_different ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                       		"test_concurrent_all",
+                       		&hopscotch_hash_table_test::test_concurrent_all ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                       		"test_concurrent_updates_known",
+                       		&hopscotch_hash_table_test::test_concurrent_updates_known ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<hopscotch_hash_table_test>(
+                       		"test_concurrent_scans",
+                       		&hopscotch_hash_table_test::test_concurrent_scans ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_HOPSCOTCH_HASH_TABLE_TEST_H */
@@ -0,0 +1,121 @@
+#ifndef TEST_LINEAR_HASH_TABLE_TEST_H
+#define TEST_LINEAR_HASH_TABLE_TEST_H
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include "../src/abstract_index.h"
+#include "../test/common_hash_table_test.h"
+#include "../src/hash_index/linear_hash_table.h"
+#include "../src/hash_functions/mod_hash.h"
+#include "../src/push_ops.h"
+#include <thread>
+
+namespace dbindex {
+	constexpr std::uint32_t linear_initial_bucket_count = 4;
+
+	class linear_hash_table_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, linear_hash_table<linear_initial_bucket_count>> {
+	private:
+		mod_hash<hash_value_t, (1<<31)> hash{};
+		linear_hash_table<linear_initial_bucket_count> hash_table{hash};
+		concat_push_op concat_push{};
+
+	public:
+		linear_hash_table_test() : common_hash_table_test(hash, hash_table){}
+
+		void test_split_order() {
+			std::cout << "TEST_SPLIT_ORDER" << std::endl;
+			CPPUNIT_ASSERT(hash_table.get_bucket_count() == linear_initial_bucket_count);
+
+			// The first split comes with the first entry past split_load_factor per bucket
+			std::uint32_t key = 0;
+			for (; key < 3*linear_initial_bucket_count; key++)
+				hash_table.insert(std::to_string(key), std::to_string(key));
+			CPPUNIT_ASSERT(hash_table.get_bucket_count() == linear_initial_bucket_count);
+
+			// One bucket per three entries, in round robin order, the level increasing every doubling
+			for (std::uint32_t split = 1; split <= 4*linear_initial_bucket_count; split++) {
+				for (std::uint32_t i = 0; i < 3; i++, key++)
+					hash_table.insert(std::to_string(key), std::to_string(key));
+				CPPUNIT_ASSERT(hash_table.get_bucket_count() == linear_initial_bucket_count + split);
+			}
+			CPPUNIT_ASSERT(hash_table.get_level() == 2);
+			CPPUNIT_ASSERT(hash_table.get_split_pointer() == linear_initial_bucket_count);
+
+			std::string value;
+			for (std::uint32_t i = 0; i < key; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value));
+				CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+			CPPUNIT_ASSERT(!hash_table.get(std::to_string(key), value));
+		}
+
+		void test_overflow_pages() {
+			std::cout << "TEST_OVERFLOW_PAGES" << std::endl;
+			// Keys of one bucket at any level, chained in overflow pages
+			std::vector<std::string> keys;
+			for (std::uint32_t i = 1; i <= 40; i++)
+				keys.push_back(std::to_string(i << 20));
+			for (auto& key : keys)
+				hash_table.insert(key, key);
+			CPPUNIT_ASSERT(hash_table.size() == 40);
+
+			std::string value;
+			for (auto& key : keys) {
+				hash_table.update(key, key + "u");
+				CPPUNIT_ASSERT(hash_table.get(key, value));
+				CPPUNIT_ASSERT(value == key + "u");
+			}
+			for (std::uint32_t i = 0; i < keys.size(); i++) {
+				hash_table.remove(keys[i]);
+				CPPUNIT_ASSERT(!hash_table.get(keys[i], value));
+				for (std::uint32_t j = i+1; j < keys.size(); j++)
+					CPPUNIT_ASSERT(hash_table.get(keys[j], value));
+			}
+			CPPUNIT_ASSERT(hash_table.size() == 0);
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "linear_hash_table_suite" );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+            	           "test_insert",
+            	           	&linear_hash_table_test::test_insert ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                	       "test_delete",
+                    	   &linear_hash_table_test::test_delete ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                	       "test_update",
+                    	   &linear_hash_table_test::test_update ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                	       "test_scan",
+                    	   &linear_hash_table_test::test_scan ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                       		"test_insert_delete_many",
+                       		&linear_hash_table_test::test_insert_delete_many ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                       		"test_split_order",
+                       		&linear_hash_table_test::test_split_order ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                       		"test_overflow_pages",
+                       		&linear_hash_table_test::test_overflow_pages ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                       		"test_concurrent_different",
+                       		&linear_hash_table_test::test_concurrent_different ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                       		"test_concurrent_all",
+                       		&linear_hash_table_test::test_concurrent_all ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                       		"test_concurrent_updates_known",
+                       		&linear_hash_table_test::test_concurrent_updates_known ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<linear_hash_table_test>(
+                       		"test_concurrent_scans",
+                       		&linear_hash_table_test::test_concurrent_scans ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_LINEAR_HASH_TABLE_TEST_H */
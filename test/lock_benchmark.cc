@@ -0,0 +1,91 @@
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <boost/thread.hpp>
+
+#include "../src/util/distributed_rw_lock.h"
+#include "../src/util/rw_spinlock.h"
+
+/*
+ * Cost of acquiring and releasing a single reader-writer lock against the
+ * number of threads, all taking it shared, and with every writes_per_1000th
+ * acquire exclusive. The critical section is empty, so the numbers are the
+ * lock itself: the cache line traffic of readers writing a shared counter
+ * and the wait for writers.
+ * Writes "<threads>\t<ns per acquire, reads only>\t<ns per acquire, with writes>" per lock to results/.
+ */
+template<typename lock_type>
+double run_threads(std::uint32_t thread_count, std::uint32_t ops_per_thread, std::uint32_t writes_per_1000) {
+    using namespace std::chrono;
+
+    lock_type lock;
+    std::atomic<std::uint32_t> ready{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (std::uint32_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 generator(t);
+            std::uniform_int_distribution<std::uint32_t> op_distribution(0, 999);
+            std::vector<bool> is_write(ops_per_thread);
+            for (std::uint32_t i = 0; i < ops_per_thread; i++) {
+                is_write[i] = op_distribution(generator) < writes_per_1000;
+            }
+            ready++;
+            while (!start) {
+                std::this_thread::yield();
+            }
+            for (std::uint32_t i = 0; i < ops_per_thread; i++) {
+                if (is_write[i]) {
+                    boost::unique_lock<lock_type> exclusive_lock(lock);
+                } else {
+                    boost::shared_lock<lock_type> shared_lock(lock);
+                }
+            }
+        });
+    }
+    while (ready < thread_count) {
+        std::this_thread::yield();
+    }
+    high_resolution_clock::time_point run_start = high_resolution_clock::now();
+    start = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double nanoseconds = duration_cast<duration<double, std::nano>>(high_resolution_clock::now() - run_start).count();
+    // Wall time per acquire of one thread, what an operation pays for the lock
+    return nanoseconds / ops_per_thread;
+}
+
+template<typename lock_type>
+void measure_lock(std::string lock_string, std::uint32_t ops_per_thread) {
+    const std::uint32_t writes_per_1000 = 10;
+
+    std::ofstream out_file;
+    out_file.open("results/locks_" + lock_string + ".txt");
+    std::uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << lock_string << ", " << sizeof(lock_type) << " bytes, " << cores << " cores" << std::endl;
+    for (std::uint32_t thread_count = 1; thread_count <= 2 * cores; thread_count *= 2) {
+        double reads_only  = run_threads<lock_type>(thread_count, ops_per_thread, 0);
+        double with_writes = run_threads<lock_type>(thread_count, ops_per_thread, writes_per_1000);
+        std::cout << "  " << thread_count << " threads: " << reads_only << " ns, with "
+                  << writes_per_1000 / 10.0 << "% writes " << with_writes << " ns" << std::endl;
+        out_file << thread_count << "\t" << reads_only << "\t" << with_writes << "\n";
+    }
+    out_file.close();
+}
+
+int main(int argc, char *argv[]) {
+    std::uint32_t ops_per_thread = 1000000;
+    if (argc > 1)
+        ops_per_thread = std::stoul(argv[1]);
+
+    measure_lock<boost::shared_mutex>("boost_shared_mutex", ops_per_thread);
+    measure_lock<utils::rw_spinlock>("rw_spinlock", ops_per_thread);
+    measure_lock<utils::distributed_rw_lock>("distributed_rw_lock", ops_per_thread);
+}
@@ -12,6 +12,9 @@
 #include "../src/util/thread_util.h"
 #include <boost/thread.hpp>
 #include <boost/thread/shared_mutex.hpp>
+#include <algorithm>
+#include <memory>
+#include <set>
 #include <thread>
 
 namespace dbindex {
@@ -24,6 +27,35 @@ namespace dbindex {
 		partitioned_array_hash_table<prefix_bits, directory_size> hash_table{hash};
 		concat_push_op concat_push{};
 
+		// Keeps the keys it is pushed, up to limit
+		struct key_push_op : public abstract_push_op {
+			std::vector<std::string> keys;
+			size_t limit;
+			key_push_op(size_t _limit) : limit(_limit) {}
+			bool invoke(const char *keyp, size_t keylen, const std::string &value) {
+				keys.emplace_back(keyp, keylen);
+				return keys.size() < limit;
+			}
+		};
+
+		template<typename table_type>
+		void check_scans(table_type& table, std::vector<std::string> keys) {
+			std::sort(keys.begin(), keys.end());
+			for (size_t limit : {(size_t)10, keys.size()}) {
+				key_push_op po{limit};
+				table.range_scan("", NULL, po);
+				CPPUNIT_ASSERT(po.keys == std::vector<std::string>(keys.begin(), keys.begin() + limit));
+
+				key_push_op reverse_po{limit};
+				table.reverse_range_scan("", NULL, reverse_po);
+				CPPUNIT_ASSERT(reverse_po.keys == std::vector<std::string>(keys.rbegin(), keys.rbegin() + limit));
+			}
+			std::string end_key = keys[keys.size()/2];
+			key_push_op po{keys.size()};
+			table.range_scan(keys[keys.size()/4], &end_key, po);
+			CPPUNIT_ASSERT(po.keys == std::vector<std::string>(keys.begin() + keys.size()/4, keys.begin() + keys.size()/2 + 1));
+		}
+
 	public:
 		partitioned_array_hash_table_test() : common_hash_table_test(hash, hash_table){}
 
@@ -65,6 +97,166 @@ namespace dbindex {
 			CPPUNIT_ASSERT(hash_table.size() == 0);
 		}
 
+		void test_node_accesses() {
+			std::cout << "TEST_NODE_ACCESSES" << std::endl;
+			const utils::numa_topology& topology = utils::numa_topology::instance();
+			CPPUNIT_ASSERT(utils::numa_topology::parse_cpu_list("0-2,5,8-9\n") == std::vector<int>({0, 1, 2, 5, 8, 9}));
+			CPPUNIT_ASSERT(topology.node_count() >= 1 && !topology.cpu_nodes().empty());
+			CPPUNIT_ASSERT(utils::stick_thread_to_node(pthread_self(), topology.node_count()) == EINVAL);
+
+			partitioned_array_hash_table<prefix_bits, directory_size, partition_routing::key_prefix, true> counted_table{hash};
+			std::uint32_t previous_node = 0;
+			for (std::uint32_t i = 0; i < (1<<prefix_bits); i++) {
+				CPPUNIT_ASSERT(counted_table.partition_node(i) >= previous_node);
+				CPPUNIT_ASSERT(counted_table.partition_node(i) < topology.node_count());
+				CPPUNIT_ASSERT(!topology.cores_of_node(counted_table.partition_node(i)).empty());
+				previous_node = counted_table.partition_node(i);
+			}
+
+			// Counted by the node the calling threads run on, every call from the home node on a single node
+			std::uint32_t amount = 1000;
+			int pinned = -1;
+			std::thread local_thread([&]() {
+				pinned = utils::stick_thread_to_node(pthread_self(), counted_table.partition_node(0));
+				for (std::uint32_t i = 0; i < amount; i++)
+					counted_table.insert(std::to_string(i+(1<<8)), "11");
+			});
+			local_thread.join();
+			CPPUNIT_ASSERT(pinned == 0);
+			std::string value;
+			for (std::uint32_t i = 0; i < amount; i++)
+				CPPUNIT_ASSERT(counted_table.get(std::to_string(i+(1<<8)), value));
+
+			CPPUNIT_ASSERT(counted_table.calls_from_home_node() + counted_table.calls_from_other_nodes() == 2*amount);
+			if (topology.node_count() == 1)
+				CPPUNIT_ASSERT(counted_table.calls_from_home_node() == 2*amount);
+			counted_table.reset_access_counts();
+			CPPUNIT_ASSERT(counted_table.calls_from_home_node() == 0 && counted_table.calls_from_other_nodes() == 0);
+		}
+
+		void test_hash_routing() {
+			std::cout << "TEST_HASH_ROUTING" << std::endl;
+			partitioned_array_hash_table<prefix_bits, directory_size, partition_routing::hash> hashed_table{hash};
+			std::uint32_t amount = 1<<12;
+			for (std::uint32_t i = 0; i < amount; i++)
+				hashed_table.insert(std::to_string(i+(1<<8)), std::to_string(i+(1<<8)));
+
+			// Decimal keys all share their first four bits, the hash spreads them
+			std::vector<size_t> sizes = hashed_table.partition_sizes();
+			CPPUNIT_ASSERT(sizes.size() == (1<<prefix_bits));
+			for (size_t partition_size : sizes)
+				CPPUNIT_ASSERT(partition_size > amount / (1<<prefix_bits) / 2 && partition_size < amount / (1<<prefix_bits) * 2);
+
+			// Scans merge all partitions back into key order, the values are the keys
+			vector_push_op po{};
+			std::string end_key = "999";
+			hashed_table.range_scan("300", &end_key, po);
+			std::vector<std::string> keys = po.get();
+			CPPUNIT_ASSERT(!keys.empty());
+			for (size_t i = 0; i < keys.size(); i++) {
+				CPPUNIT_ASSERT(keys[i] >= "300" && keys[i] <= end_key);
+				if (i > 0)
+					CPPUNIT_ASSERT(keys[i-1] < keys[i]);
+			}
+
+			std::string value;
+			for (std::uint32_t i = 0; i < amount; i += 2) {
+				hashed_table.update(std::to_string(i+(1<<8)), "updated");
+				hashed_table.remove(std::to_string(i+1+(1<<8)));
+			}
+			CPPUNIT_ASSERT(hashed_table.size() == amount/2);
+			CPPUNIT_ASSERT(hashed_table.get(std::to_string(2+(1<<8)), value) && value == "updated");
+			CPPUNIT_ASSERT(!hashed_table.get(std::to_string(3+(1<<8)), value));
+		}
+
+		void test_scan_merge() {
+			std::cout << "TEST_SCAN_MERGE" << std::endl;
+			partitioned_array_hash_table<prefix_bits, directory_size, partition_routing::key_prefix> helped_table{hash, 3};
+			partitioned_array_hash_table<prefix_bits, directory_size, partition_routing::hash> hashed_table{hash, 3};
+			std::vector<std::string> keys;
+			// Keys over all 16 prefixes, for the key_prefix partitions
+			for (std::uint32_t i = 0; i < 1<<11; i++)
+				keys.push_back(std::string(1, (char)(i % 256)) + "key" + std::to_string(i));
+			for (const std::string& key : keys) {
+				hash_table.insert(key, "v");
+				helped_table.insert(key, "v");
+				hashed_table.insert(key, "v");
+			}
+			check_scans(hash_table, keys);
+			check_scans(helped_table, keys);
+			check_scans(hashed_table, keys);
+		}
+
+		template<partition_routing routing>
+		void check_delegated() {
+			typedef partitioned_array_hash_table<prefix_bits, directory_size, routing, false, partition_execution::delegated> delegated_table_type;
+			delegated_table_type delegated_table{hash, 0, 4};
+			std::uint32_t num_threads = 4;
+			std::uint32_t amount = 1<<10;
+			std::vector<std::string> keys;
+			for (std::uint32_t i = 0; i < amount*num_threads; i++)
+				keys.push_back(std::string(1, (char)(i % 256)) + "key" + std::to_string(i));
+
+			std::vector<std::thread> threads;
+			for (std::uint32_t t = 0; t < num_threads; t++) {
+				threads.emplace_back([&, t]() {
+					for (std::uint32_t i = t*amount; i < (t+1)*amount; i++)
+						delegated_table.insert(keys[i], keys[i]);
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+			CPPUNIT_ASSERT(delegated_table.size() == keys.size());
+			check_scans(delegated_table, keys);
+
+			// Batches of operations on a session, collected by ticket
+			typename delegated_table_type::delegation_session session{delegated_table.delegation_owners()};
+			std::vector<std::string> values(keys.size());
+			std::vector<std::uint64_t> tickets;
+			for (std::uint32_t i = 0; i < keys.size(); i++)
+				tickets.push_back(delegated_table.get(session, keys[i], values[i]));
+			std::string updated = "updated";
+			std::uint64_t update_ticket = delegated_table.update(session, keys[0], updated);
+			std::uint64_t remove_ticket = delegated_table.remove(session, keys[1]);
+			std::vector<delegated_completion> completed;
+			session.drain(completed);
+			CPPUNIT_ASSERT(completed.size() == keys.size() + 2);
+			std::set<std::uint64_t> completed_tickets;
+			for (const delegated_completion& completion : completed) {
+				CPPUNIT_ASSERT(completion.found);
+				completed_tickets.insert(completion.ticket);
+			}
+			CPPUNIT_ASSERT(completed_tickets.count(update_ticket) && completed_tickets.count(remove_ticket));
+			for (std::uint32_t i = 0; i < keys.size(); i++) {
+				CPPUNIT_ASSERT(completed_tickets.count(tickets[i]));
+				CPPUNIT_ASSERT(values[i] == keys[i]);
+			}
+
+			// More sessions open at once than the first chunk of slots holds
+			std::vector<std::unique_ptr<typename delegated_table_type::delegation_session>> sessions;
+			for (std::uint32_t i = 0; i < 2*partition_owners::slots_per_chunk + 1; i++)
+				sessions.emplace_back(new typename delegated_table_type::delegation_session(delegated_table.delegation_owners()));
+			for (auto& open_session : sessions) {
+				std::string result;
+				completed.clear();
+				delegated_table.get(*open_session, keys[2], result);
+				open_session->drain(completed);
+				CPPUNIT_ASSERT(completed.size() == 1 && completed[0].found && result == keys[2]);
+			}
+			sessions.clear();
+
+			std::string value;
+			CPPUNIT_ASSERT(delegated_table.get(keys[0], value) && value == updated);
+			CPPUNIT_ASSERT(!delegated_table.get(keys[1], value));
+			CPPUNIT_ASSERT(delegated_table.size() == keys.size() - 1);
+		}
+
+		void test_delegated_execution() {
+			std::cout << "TEST_DELEGATED_EXECUTION" << std::endl;
+			check_delegated<partition_routing::key_prefix>();
+			check_delegated<partition_routing::hash>();
+		}
+
 		static CppUnit::Test* suite()
 		{
 			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "partitioned_array_hash_table_suite" );
@@ -85,6 +277,22 @@ namespace dbindex {
                        		"test_insert_delete_skew",
                        		&partitioned_array_hash_table_test::test_insert_delete_skew ) );
 
+			suite_of_tests->addTest( new CppUnit::TestCaller<partitioned_array_hash_table_test>(
+                       		"test_node_accesses",
+                       		&partitioned_array_hash_table_test::test_node_accesses ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<partitioned_array_hash_table_test>(
+                       		"test_hash_routing",
+                       		&partitioned_array_hash_table_test::test_hash_routing ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<partitioned_array_hash_table_test>(
+                       		"test_scan_merge",
+                       		&partitioned_array_hash_table_test::test_scan_merge ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<partitioned_array_hash_table_test>(
+                       		"test_delegated_execution",
+                       		&partitioned_array_hash_table_test::test_delegated_execution ) );
+
 			suite_of_tests->addTest( new CppUnit::TestCaller<partitioned_array_hash_table_test>(
                 	       "test_scan",
                     	   &partitioned_array_hash_table_test::test_scan ) );
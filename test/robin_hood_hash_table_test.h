@@ -0,0 +1,120 @@
+#ifndef TEST_ROBIN_HOOD_HASH_TABLE_TEST_H
+#define TEST_ROBIN_HOOD_HASH_TABLE_TEST_H
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include "../src/abstract_index.h"
+#include "../test/common_hash_table_test.h"
+#include "../src/hash_index/robin_hood_hash_table.h"
+#include "../src/hash_functions/mod_hash.h"
+#include "../src/push_ops.h"
+#include <thread>
+
+namespace dbindex {
+	constexpr std::uint32_t robin_hood_shard_capacity = 16;
+	constexpr std::uint32_t robin_hood_shard_count    = 4;
+
+	class robin_hood_hash_table_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, robin_hood_hash_table<robin_hood_shard_capacity, robin_hood_shard_count>> {
+	private:
+		mod_hash<hash_value_t, (1<<31)> hash{};
+		robin_hood_hash_table<robin_hood_shard_capacity, robin_hood_shard_count> hash_table{hash};
+		concat_push_op concat_push{};
+
+	public:
+		robin_hood_hash_table_test() : common_hash_table_test(hash, hash_table){}
+
+		void test_grow() {
+			std::cout << "TEST_GROW" << std::endl;
+			const std::uint32_t capacity = robin_hood_shard_capacity*robin_hood_shard_count;
+			CPPUNIT_ASSERT(hash_table.capacity() == capacity);
+
+			// Every shard filled to 90% without growing
+			std::uint32_t amount = robin_hood_shard_count * (robin_hood_shard_capacity * 9 / 10);
+			for (std::uint32_t i = 0; i < amount; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.capacity() == capacity);
+
+			for (std::uint32_t i = amount; i < 64*capacity; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.size() == 64*capacity);
+			CPPUNIT_ASSERT(hash_table.capacity() * 9 >= 64*capacity * 10);
+
+			std::string value;
+			for (std::uint32_t i = 0; i < 64*capacity; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value));
+				CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+			CPPUNIT_ASSERT(!hash_table.get(std::to_string(64*capacity), value));
+		}
+
+		void test_backward_shift() {
+			std::cout << "TEST_BACKWARD_SHIFT" << std::endl;
+			// Keys of one shard and one home slot, at distances 0 to 7
+			std::vector<std::string> keys;
+			for (std::uint32_t i = 1; i <= 8; i++)
+				keys.push_back(std::to_string(i * robin_hood_shard_capacity * robin_hood_shard_count));
+			for (auto& key : keys)
+				hash_table.insert(key, key);
+			CPPUNIT_ASSERT(hash_table.max_probe_length() == 7);
+
+			// Removing the first one shifts the others back, leaving no tombstone
+			hash_table.remove(keys[0]);
+			CPPUNIT_ASSERT(hash_table.max_probe_length() == 6);
+			std::string value;
+			CPPUNIT_ASSERT(!hash_table.get(keys[0], value));
+			for (std::uint32_t i = 1; i < keys.size(); i++) {
+				CPPUNIT_ASSERT(hash_table.get(keys[i], value));
+				CPPUNIT_ASSERT(value == keys[i]);
+			}
+
+			for (std::uint32_t i = 1; i < keys.size(); i++)
+				hash_table.remove(keys[i]);
+			CPPUNIT_ASSERT(hash_table.size() == 0);
+			CPPUNIT_ASSERT(hash_table.max_probe_length() == 0);
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "robin_hood_hash_table_suite" );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+            	           "test_insert",
+            	           	&robin_hood_hash_table_test::test_insert ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                	       "test_delete",
+                    	   &robin_hood_hash_table_test::test_delete ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                	       "test_update",
+                    	   &robin_hood_hash_table_test::test_update ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                	       "test_scan",
+                    	   &robin_hood_hash_table_test::test_scan ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                       		"test_insert_delete_many",
+                       		&robin_hood_hash_table_test::test_insert_delete_many ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                       		"test_grow",
+                       		&robin_hood_hash_table_test::test_grow ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                       		"test_backward_shift",
+                       		&robin_hood_hash_table_test::test_backward_shift ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                       		"test_concurrent_different",
+                       		&robin_hood_hash_table_test::test_concurrent_different ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                       		"test_concurrent_all",
+                       		&robin_hood_hash_table_test::test_concurrent_all ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                       		"test_concurrent_updates_known",
+                       		&robin_hood_hash_table_test::test_concurrent_updates_known ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<robin_hood_hash_table_test>(
+                       		"test_concurrent_scans",
+                       		&robin_hood_hash_table_test::test_concurrent_scans ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_ROBIN_HOOD_HASH_TABLE_TEST_H */
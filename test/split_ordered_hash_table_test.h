@@ -0,0 +1,139 @@
+#ifndef TEST_SPLIT_ORDERED_HASH_TABLE_TEST_H
+#define TEST_SPLIT_ORDERED_HASH_TABLE_TEST_H
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include "../src/abstract_index.h"
+#include "../test/common_hash_table_test.h"
+#include "../src/hash_index/split_ordered_hash_table.h"
+#include "../src/hash_functions/mod_hash.h"
+#include "../src/push_ops.h"
+#include <thread>
+
+namespace dbindex {
+	constexpr std::uint32_t split_ordered_bucket_count = 4;
+
+	class split_ordered_hash_table_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, split_ordered_hash_table<split_ordered_bucket_count>> {
+	private:
+		mod_hash<hash_value_t, (1<<31)> hash{};
+		split_ordered_hash_table<split_ordered_bucket_count> hash_table{hash};
+		concat_push_op concat_push{};
+
+	public:
+		split_ordered_hash_table_test() : common_hash_table_test(hash, hash_table){}
+
+		void test_grow() {
+			std::cout << "TEST_GROW" << std::endl;
+			CPPUNIT_ASSERT(hash_table.get_bucket_count() == split_ordered_bucket_count);
+
+			std::uint32_t amount = 1<<12;
+			for (std::uint32_t i = 0; i < amount; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.size() == amount);
+			CPPUNIT_ASSERT(hash_table.get_bucket_count() >= amount/2);
+
+			std::string value;
+			for (std::uint32_t i = 0; i < amount; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value));
+				CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+			CPPUNIT_ASSERT(!hash_table.get(std::to_string(amount), value));
+		}
+
+		void test_colliding_keys() {
+			std::cout << "TEST_COLLIDING_KEYS" << std::endl;
+			// Non numeric keys of the same length share their hash value and
+			// are ordered by key within it
+			std::vector<std::string> keys;
+			for (char c = 'a'; c < 'a' + 20; c++)
+				keys.push_back(std::string("k") + c);
+
+			for (auto it = keys.rbegin(); it != keys.rend(); ++it)
+				hash_table.insert(*it, *it);
+			CPPUNIT_ASSERT(hash_table.size() == keys.size());
+
+			std::string value;
+			for (std::uint32_t i = 0; i < keys.size(); i += 2)
+				hash_table.remove(keys[i]);
+			for (std::uint32_t i = 0; i < keys.size(); i++) {
+				hash_table.update(keys[i], keys[i] + "'");
+				CPPUNIT_ASSERT(hash_table.get(keys[i], value) == (i % 2 == 1));
+				if (i % 2 == 1)
+					CPPUNIT_ASSERT(value == keys[i] + "'");
+			}
+			CPPUNIT_ASSERT(hash_table.size() == keys.size()/2);
+		}
+
+		void test_concurrent_insert_remove() {
+			std::cout << "TEST_CONCURRENT_INSERT_REMOVE" << std::endl;
+			constexpr std::uint32_t thread_count = 4;
+			constexpr std::uint32_t amount = 1<<12;
+
+			// Every thread inserts its keys and removes every other one, while
+			// the bucket count grows underneath
+			std::vector<std::thread> threads;
+			for (std::uint32_t t = 0; t < thread_count; t++) {
+				threads.emplace_back([this, t]() {
+					for (std::uint32_t i = t*amount; i < (t+1)*amount; i++)
+						hash_table.insert(std::to_string(i), std::to_string(i));
+					for (std::uint32_t i = t*amount; i < (t+1)*amount; i += 2)
+						hash_table.remove(std::to_string(i));
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+
+			CPPUNIT_ASSERT(hash_table.size() == thread_count*amount/2);
+			std::string value;
+			for (std::uint32_t i = 0; i < thread_count*amount; i++)
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value) == (i % 2 == 1));
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "split_ordered_hash_table_suite" );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+            	           "test_insert",
+            	           	&split_ordered_hash_table_test::test_insert ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                	       "test_delete",
+                    	   &split_ordered_hash_table_test::test_delete ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                	       "test_update",
+                    	   &split_ordered_hash_table_test::test_update ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                	       "test_scan",
+                    	   &split_ordered_hash_table_test::test_scan ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                       		"test_insert_delete_many",
+                       		&split_ordered_hash_table_test::test_insert_delete_many ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                       		"test_grow",
+                       		&split_ordered_hash_table_test::test_grow ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                       		"test_colliding_keys",
+                       		&split_ordered_hash_table_test::test_colliding_keys ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                       		"test_concurrent_different",
+                       		&split_ordered_hash_table_test::test_concurrent_different ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                       		"test_concurrent_all",
+                       		&split_ordered_hash_table_test::test_concurrent_all ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                       		"test_concurrent_updates_known",
+                       		&split_ordered_hash_table_test::test_concurrent_updates_known ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                       		"test_concurrent_scans",
+                       		&split_ordered_hash_table_test::test_concurrent_scans ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<split_ordered_hash_table_test>(
+                       		"test_concurrent_insert_remove",
+                       		&split_ordered_hash_table_test::test_concurrent_insert_remove ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_SPLIT_ORDERED_HASH_TABLE_TEST_H */
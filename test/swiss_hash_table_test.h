@@ -0,0 +1,111 @@
+#ifndef TEST_SWISS_HASH_TABLE_TEST_H
+#define TEST_SWISS_HASH_TABLE_TEST_H
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include "../src/abstract_index.h"
+#include "../test/common_hash_table_test.h"
+#include "../src/hash_index/swiss_hash_table.h"
+#include "../src/hash_functions/mod_hash.h"
+#include "../src/push_ops.h"
+#include <thread>
+
+namespace dbindex {
+	constexpr std::uint32_t swiss_shard_capacity = 16;
+	constexpr std::uint32_t swiss_shard_count    = 4;
+
+	class swiss_hash_table_test : public common_hash_table_test<mod_hash<hash_value_t, (1<<31)>, swiss_hash_table<swiss_shard_capacity, swiss_shard_count>> {
+	private:
+		mod_hash<hash_value_t, (1<<31)> hash{};
+		swiss_hash_table<swiss_shard_capacity, swiss_shard_count> hash_table{hash};
+		concat_push_op concat_push{};
+
+	public:
+		swiss_hash_table_test() : common_hash_table_test(hash, hash_table){}
+
+		void test_grow() {
+			std::cout << "TEST_GROW" << std::endl;
+			CPPUNIT_ASSERT(hash_table.capacity() == swiss_shard_capacity*swiss_shard_count);
+
+			std::uint32_t amount = 1<<12;
+			for (std::uint32_t i = 0; i < amount; i++)
+				hash_table.insert(std::to_string(i), std::to_string(i));
+			CPPUNIT_ASSERT(hash_table.size() == amount);
+			CPPUNIT_ASSERT(hash_table.capacity() * 7 >= amount * 8);
+
+			std::string value;
+			for (std::uint32_t i = 0; i < amount; i++) {
+				CPPUNIT_ASSERT(hash_table.get(std::to_string(i), value));
+				CPPUNIT_ASSERT(value == std::to_string(i));
+			}
+			CPPUNIT_ASSERT(!hash_table.get(std::to_string(amount), value));
+		}
+
+		void test_reuse_deleted() {
+			std::cout << "TEST_REUSE_DELETED" << std::endl;
+			// Keys of one shard and one tag, so that they share a probe sequence
+			std::vector<std::string> keys;
+			for (std::uint32_t i = 0; i < swiss_shard_capacity/2; i++)
+				keys.push_back(std::to_string(i << 9));
+
+			for (std::uint32_t round = 0; round < 64; round++) {
+				for (auto& key : keys)
+					hash_table.insert(key, std::to_string(round));
+				std::string value;
+				for (auto& key : keys) {
+					CPPUNIT_ASSERT(hash_table.get(key, value));
+					CPPUNIT_ASSERT(value == std::to_string(round));
+				}
+				for (auto& key : keys)
+					hash_table.remove(key);
+				CPPUNIT_ASSERT(hash_table.size() == 0);
+			}
+			// Deleted slots were reused instead of growing the table
+			CPPUNIT_ASSERT(hash_table.capacity() == swiss_shard_capacity*swiss_shard_count);
+		}
+
+		static CppUnit::Test* suite()
+		{
+			CppUnit::TestSuite* suite_of_tests = new CppUnit::TestSuite( "swiss_hash_table_suite" );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+            	           "test_insert",
+            	           	&swiss_hash_table_test::test_insert ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                	       "test_delete",
+                    	   &swiss_hash_table_test::test_delete ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                	       "test_update",
+                    	   &swiss_hash_table_test::test_update ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                	       "test_scan",
+                    	   &swiss_hash_table_test::test_scan ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                       		"test_insert_delete_many",
+                       		&swiss_hash_table_test::test_insert_delete_many ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                       		"test_grow",
+                       		&swiss_hash_table_test::test_grow ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                       		"test_reuse_deleted",
+                       		&swiss_hash_table_test::test_reuse_deleted ) );
+
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                       		"test_concurrent_different",
+                       		&swiss_hash_table_test::test_concurrent_different ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                       		"test_concurrent_all",
+                       		&swiss_hash_table_test::test_concurrent_all ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                       		"test_concurrent_updates_known",
+                       		&swiss_hash_table_test::test_concurrent_updates_known ) );
+			suite_of_tests->addTest( new CppUnit::TestCaller<swiss_hash_table_test>(
+                       		"test_concurrent_scans",
+                       		&swiss_hash_table_test::test_concurrent_scans ) );
+			return suite_of_tests;
+		};
+	};
+}
+#endif /* TEST_SWISS_HASH_TABLE_TEST_H */
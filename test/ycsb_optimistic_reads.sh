@@ -0,0 +1,16 @@
+# Optimistic (1) against locked (3) reads in the extendible hash table, 1 to 32 threads
+for wl in workload_b workload_c workload_a;
+do
+	for hf in 1;
+	do
+		for hi in 1 3;
+		do
+			./bin/test/extendible_hash_table_ycsb $wl $hf $hi 32;
+		done;
+	done;
+done
+
+for wl in workload_b workload_c workload_a;
+do
+	gnuplot -e "workload='$wl'" -e "hash_func='murmur'" gnuplot/gnuplot_ycsb_optimistic_reads;
+done
@@ -0,0 +1,16 @@
+# The ordered indexes, B+tree (12) against B-link tree (13) and Bw-tree (14), on inserts, latest reads, updates and scans, 1 to 32 threads
+for wl in workload_insert workload_d workload_a workload_e;
+do
+	for hf in 1;
+	do
+		for hi in 12 13 14;
+		do
+			./bin/test/extendible_hash_table_ycsb $wl $hf $hi 32;
+		done;
+	done;
+done
+
+for wl in workload_insert workload_d workload_a workload_e;
+do
+	gnuplot -e "workload='$wl'" -e "hash_func='murmur'" gnuplot/gnuplot_ycsb_ordered;
+done
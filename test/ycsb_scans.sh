@@ -0,0 +1,19 @@
+# Range scans of the B+tree (12) against the full scans of the array (0) and partitioned (2, 10) hash tables, 1 to 16 threads
+for wl in workload_scan;
+do
+	for hf in 1;
+	do
+		for hi in 12 0 2 10;
+		do
+			./bin/test/extendible_hash_table_ycsb $wl $hf $hi 16;
+		done;
+	done;
+done
+
+# A run of workload_e takes hours with full scans, so only the tree runs it
+./bin/test/extendible_hash_table_ycsb workload_e 1 12 16;
+
+for wl in workload_scan;
+do
+	gnuplot -e "workload='$wl'" -e "hash_func='murmur'" gnuplot/gnuplot_ycsb_scans;
+done